@@ -0,0 +1,128 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Compares the construction of a tree inserting the links one by one in
+ * K2TreeBuilder with K2TreeBuilder::BuildFromEdges and with
+ * ExternalK2TreeBuilder limited to a buffer of 16 MB, on random graphs with
+ * a power law out degree. Each construction runs in a child process and its
+ * memory is reported as the growth of the peak resident set of the child.
+ *
+ * Usage: bench_build_from_edges [links per node]
+ */
+
+#include <k2tree.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+using libk2tree::K2TreeBuilder;
+using libk2tree::ExternalK2TreeBuilder;
+
+typedef unsigned int uint;
+
+/* Returns the peak resident set in megabytes, as reported by Linux */
+double PeakMB() {
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while (std::getline(status, line))
+    if (line.compare(0, 6, "VmHWM:") == 0)
+      return atof(line.c_str() + 6)/1024;
+  return 0;
+}
+
+/*
+ * Runs fun in a child process and stores the time in seconds it took and
+ * the growth in megabytes of the peak resident set.
+ */
+template<class Function>
+void Measure(Function fun, double *time, double *mb) {
+  int fd[2];
+  if (pipe(fd) != 0) {
+    std::cerr << "[bench_build_from_edges] Error: pipe" << std::endl;
+    exit(1);
+  }
+  double res[2];
+  if (fork() == 0) {
+    // Resets the peak to the current resident set.
+    std::ofstream("/proc/self/clear_refs") << "5";
+    double base = PeakMB();
+    auto start = std::chrono::steady_clock::now();
+    fun();
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    res[0] = elapsed.count();
+    res[1] = PeakMB() - base;
+    if (write(fd[1], res, sizeof(res)) != sizeof(res))
+      _exit(1);
+    _exit(0);
+  }
+  if (read(fd[0], res, sizeof(res)) != sizeof(res)) {
+    std::cerr << "[bench_build_from_edges] Error: child failed" << std::endl;
+    exit(1);
+  }
+  wait(NULL);
+  close(fd[0]);
+  close(fd[1]);
+  *time = res[0];
+  *mb = res[1];
+}
+
+int main(int argc, char *argv[]) {
+  double degree = argc > 1 ? atof(argv[1]) : 8;
+
+  srand(42);
+  printf("%12s %12s %12s %12s %12s %12s %12s %12s\n", "nodes", "links",
+         "insert (s)", "insert (MB)", "sorted (s)", "sorted (MB)",
+         "external (s)", "external (MB)");
+  for (size_t n = 1 << 14; n <= (1 << 20); n <<= 2) {
+    std::vector<std::pair<size_t, size_t>> edges;
+    for (size_t p = 0; p < n; ++p) {
+      double u = (rand() + 1.0)/(RAND_MAX + 2.0);
+      size_t d = (size_t) (degree/2/std::sqrt(u));
+      for (size_t i = 0; i < d; ++i)
+        edges.emplace_back(p, (size_t) rand()%n);
+    }
+
+    auto sorted = [&] {
+      return K2TreeBuilder::BuildFromEdges(n, 4, 2, 8, 5, edges.data(),
+                                           edges.data() + edges.size());
+    };
+    auto inserted = [&] {
+      K2TreeBuilder tb(n, 4, 2, 8, 5);
+      for (const std::pair<size_t, size_t> &e : edges)
+        tb.AddLink(e.first, e.second);
+      return tb.Build();
+    };
+    auto external = [&] {
+      ExternalK2TreeBuilder tb(n, 4, 2, 8, 5, ".", 1 << 24);
+      for (const std::pair<size_t, size_t> &e : edges)
+        tb.AddLink(e.first, e.second);
+      std::ofstream out("bench_external_tree", std::ofstream::binary);
+      tb.Build(&out);
+    };
+    double insert_time, insert_mb, sorted_time, sorted_mb;
+    double external_time, external_mb;
+    Measure(inserted, &insert_time, &insert_mb);
+    Measure(sorted, &sorted_time, &sorted_mb);
+    Measure(external, &external_time, &external_mb);
+    remove("bench_external_tree");
+    printf("%12zu %12zu %12.2f %12.1f %12.2f %12.1f %12.2f %12.1f\n", n,
+           edges.size(), insert_time, insert_mb, sorted_time, sorted_mb,
+           external_time, external_mb);
+  }
+  return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Compares breadth-first and depth-first range queries on square windows of
+ * several sizes over a random graph.
+ *
+ * Usage: bench_range_traversal [nodes] [edges] [queries]
+ */
+
+#include <k2tree.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using libk2tree::K2TreeBuilder;
+using libk2tree::HybridK2Tree;
+using libk2tree::CompressedHybrid;
+using libk2tree::QueryContext;
+using libk2tree::Traversal;
+using libk2tree::cnt_size;
+using std::shared_ptr;
+using std::vector;
+
+typedef unsigned int uint;
+
+struct Window {
+  cnt_size p1, p2, q1, q2;
+};
+
+/* Returns the time in microseconds per query */
+template<class K2Tree>
+double Time(const K2Tree &tree, const vector<Window> &windows,
+            Traversal traversal, size_t *links) {
+  QueryContext ctx;
+  size_t cnt = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const Window &w : windows) {
+    tree.RangeQuery(w.p1, w.p2, w.q1, w.q2, [&] (cnt_size, cnt_size) {
+      ++cnt;
+    }, &ctx, traversal);
+  }
+  auto end = std::chrono::steady_clock::now();
+  *links = cnt;
+  std::chrono::duration<double, std::micro> elapsed = end - start;
+  return elapsed.count()/(double) windows.size();
+}
+
+template<class K2Tree>
+void Run(const char *name, const K2Tree &tree, cnt_size n, uint queries) {
+  for (cnt_size side = 16; side <= n; side *= 16) {
+    vector<Window> windows(queries);
+    for (Window &w : windows) {
+      w.p1 = (cnt_size) rand() % (n - side + 1);
+      w.q1 = (cnt_size) rand() % (n - side + 1);
+      w.p2 = w.p1 + side - 1;
+      w.q2 = w.q1 + side - 1;
+    }
+    size_t bfs_links, dfs_links;
+    double bfs = Time(tree, windows, libk2tree::kBreadthFirst, &bfs_links);
+    double dfs = Time(tree, windows, libk2tree::kDepthFirst, &dfs_links);
+    if (bfs_links != dfs_links) {
+      std::cerr << "[bench_range_traversal] Error: traversals differ"
+                << std::endl;
+      exit(1);
+    }
+    printf("%-16s %10zu %12.2f %12.2f %14.2f\n", name, (size_t) side, bfs, dfs,
+           (double) bfs_links/queries);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  cnt_size n = argc > 1 ? (cnt_size) atol(argv[1]) : 1 << 18;
+  size_t e = argc > 2 ? (size_t) atol(argv[2]) : 4*(size_t) n;
+  uint queries = argc > 3 ? (uint) atoi(argv[3]) : 1000;
+
+  srand(42);
+  K2TreeBuilder builder(n, 4, 2, 8, 5);
+  for (size_t i = 0; i < e; ++i)
+    builder.AddLink((cnt_size) rand() % n, (cnt_size) rand() % n);
+  shared_ptr<HybridK2Tree> tree = builder.Build();
+  shared_ptr<CompressedHybrid> compressed = tree->CompressLeaves();
+
+  printf("%-16s %10s %12s %12s %14s\n", "tree", "window", "bfs (us)",
+         "dfs (us)", "links/query");
+  Run("HybridK2Tree", *tree, n, queries);
+  Run("CompressedHybrid", *compressed, n, queries);
+  return 0;
+}
@@ -0,0 +1,80 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Compares the latency of the access + rank step used to descend one level
+ * of the tree, on the libcds2 BitSequenceOneLevelRank and on RankBitArray.
+ * Each position depends on the result of the previous step, as when
+ * following a path from the root, so the cache misses are not overlapped.
+ *
+ * Usage: bench_rank_bitarray [steps]
+ */
+
+#include <utils/bitarray.h>
+#include <utils/rank_bitarray.h>
+#include <libcds2/immutable/bitsequence.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+using libk2tree::utils::BitArray;
+using libk2tree::utils::RankBitArray;
+using cds::immutable::BitSequence;
+using cds::immutable::BitSequenceOneLevelRank;
+
+typedef unsigned int uint;
+
+/* Returns the time in nanoseconds per step */
+template<class Step>
+double Time(size_t n, size_t steps, Step step, size_t *checksum) {
+  size_t z = 0, sum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < steps; ++i) {
+    size_t rank = step(z);
+    sum += rank;
+    z = (z + rank*2654435761u + 1) % n;
+  }
+  auto end = std::chrono::steady_clock::now();
+  *checksum = sum;
+  std::chrono::duration<double, std::nano> elapsed = end - start;
+  return elapsed.count()/(double) steps;
+}
+
+int main(int argc, char *argv[]) {
+  size_t steps = argc > 1 ? (size_t) atol(argv[1]) : 1 << 22;
+
+  srand(42);
+  printf("%14s %14s %14s\n", "bits", "libcds2 (ns)", "rank (ns)");
+  for (size_t n = 1 << 12; n <= (1 << 27); n <<= 3) {
+    BitArray<uint> bits(n);
+    for (size_t i = 0; i < n; ++i)
+      if (rand()%2)
+        bits.SetBit(i);
+
+    std::unique_ptr<BitSequence> cds(
+        new BitSequenceOneLevelRank(bits.GetCDSArray(), 20));
+    RankBitArray rank(bits);
+
+    size_t cds_sum, rank_sum;
+    double cds_time = Time(n, steps, [&] (size_t z) -> size_t {
+      return cds->Access(z) ? cds->Rank1(z) : 0;
+    }, &cds_sum);
+    double rank_time = Time(n, steps, [&] (size_t z) -> size_t {
+      size_t r;
+      return rank.AccessRank(z, &r) ? r + 1 : 0;
+    }, &rank_sum);
+
+    if (cds_sum != rank_sum) {
+      std::cerr << "[bench_rank_bitarray] Error: ranks differ" << std::endl;
+      exit(1);
+    }
+    printf("%14zu %14.2f %14.2f\n", n, cds_time, rank_time);
+  }
+  return 0;
+}
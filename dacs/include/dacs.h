@@ -1,47 +1,78 @@
-/*
- * ----------------------------------------------------------------------------
- * "THE BEER-WARE LICENSE" (Revision 42):
- * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
- * can do whatever you want with this stuff. If we meet some day, and you think
- * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
- * ----------------------------------------------------------------------------
- *
- * This file contain declaration of function implementing DAC to use inside C++.
- * It also contains implementations of the LoadFT and SaveFT functions using
- * file streams.
- */
-
-#ifndef INCLUDE_DACS_H_
-#define INCLUDE_DACS_H_
-
-extern "C" {
-typedef unsigned int uint;
-
-struct sFTRep;
-typedef struct sFTRep FTRep;
-
-FTRep* createFT(uint *list, uint listLength);
-uint accessFT(FTRep * listRep, uint param);
-uint * decompressFT(FTRep * listRep, uint n);
-void destroyFT(FTRep * listRep);
-}
-#include <fstream>
-
-
-/**
- * Saves DAC to file
- *
- * @param out Output stream.
- * @param rep DAC representation.
- */
-void SaveFT(std::ofstream *out, FTRep *rep);
-/**
- * Loads DAC from file
- *
- * @param in Input stream.
- * @return Pointer to representation. The caller must take the responsibility
- * to free the memory with destroyFT.
- */
-FTRep *LoadFT(std::ifstream *in);
-bool equalsFT(FTRep *lhs, FTRep *rhs);
-#endif  // INCLUDE_DACS_H_
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * This file contain declaration of function implementing DAC to use inside C++.
+ * It also contains implementations of the LoadFT and SaveFT functions using
+ * file streams.
+ */
+
+#ifndef INCLUDE_DACS_H_
+#define INCLUDE_DACS_H_
+
+#include <cstddef>
+
+extern "C" {
+typedef unsigned int uint;
+
+struct sFTRep;
+typedef struct sFTRep FTRep;
+
+/*
+ * Lengths and positions are size_t, so a list can have more than 2^32
+ * values. The values must be smaller than UINT_MAX.
+ */
+FTRep* createFT(uint *list, size_t listLength);
+uint accessFT(FTRep * listRep, size_t param);
+uint * decompressFT(FTRep * listRep, size_t n);
+void destroyFT(FTRep * listRep);
+}
+#include <fstream>
+
+
+/**
+ * Saves DAC to file
+ *
+ * @param out Output stream.
+ * @param rep DAC representation.
+ */
+void SaveFT(std::ofstream *out, FTRep *rep);
+/**
+ * Loads DAC from file
+ *
+ * @param in Input stream.
+ * @return Pointer to representation. The caller must take the responsibility
+ * to free the memory with destroyFT.
+ */
+FTRep *LoadFT(std::ifstream *in);
+/**
+ * Loads a DAC saved by the versions of libk2tree before the file header,
+ * which stored lengths and positions with 32 bits and no padding.
+ *
+ * @param in Input stream.
+ * @return Pointer to representation, to be freed with destroyFT.
+ */
+FTRep *LoadLegacyFT(std::ifstream *in);
+/**
+ * Creates a DAC from a file mapped in memory, saved with SaveFT. The large
+ * arrays are used in place, so the file must remain mapped until the DAC is
+ * freed with UnmapFT.
+ *
+ * @param data Pointer to the first byte of the mapped file.
+ * @param pos Position of the DAC in the file. It is updated with the
+ * position past the DAC.
+ * @return Pointer to representation.
+ */
+FTRep *MapFT(const char *data, size_t *pos);
+/**
+ * Frees a DAC created with MapFT.
+ *
+ * @param rep DAC representation.
+ */
+void UnmapFT(FTRep *rep);
+bool equalsFT(FTRep *lhs, FTRep *rhs);
+#endif  // INCLUDE_DACS_H_
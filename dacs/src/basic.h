@@ -81,9 +81,9 @@
 #define enteros(e,n) ((e)*(n))/W+(((e)*(n))%W > 0)
 /* bits needed to represent a number between 0 and n */
 uint bits (uint n);
-uint bitread (uint *e, uint p, uint len);
+uint bitread (uint *e, size_t p, uint len);
         // writes e[p..p+len-1] = s, assuming len <= W
-void bitwrite (uint *e, uint p, uint len, uint s);
+void bitwrite (uint *e, size_t p, uint len, uint s);
     // writes e[p..p+len-1] = 0, no assumption on len
 
 
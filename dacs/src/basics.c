@@ -84,7 +84,7 @@ uint bits (uint n)
 
         // returns e[p..p+len-1], assuming len <= W
 
-uint bitread (uint *e, uint p, uint len)
+uint bitread (uint *e, size_t p, uint len)
 
    { uint answ;
      e += p/W; p %= W;
@@ -101,7 +101,7 @@ uint bitread (uint *e, uint p, uint len)
 
   	// writes e[p..p+len-1] = s, len <= W
 
-void bitwrite (register uint *e, register uint p, 
+void bitwrite (register uint *e, register size_t p, 
 	       register uint len, register uint s) { 
     e += p/W; p %= W;
     if (len == W) { 
@@ -65,9 +65,9 @@
 	// bits needed to represent a number between 0 and n
 uint bits (uint n);
         // returns e[p..p+len-1], assuming len <= W
-uint bitread (uint *e, uint p, uint len);
+uint bitread (uint *e, size_t p, uint len);
         // writes e[p..p+len-1] = s, assuming len <= W
-void bitwrite (uint *e, uint p, uint len, uint s);
+void bitwrite (uint *e, size_t p, uint len, uint s);
     // writes e[p..p+len-1] = 0, no assumption on len
         
     /**/ //FARI. WITH ASSUMPTION ON LEN, OR IT CRASHES 
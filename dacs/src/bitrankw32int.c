@@ -12,12 +12,15 @@
 //factor=4 => overhead 25%
 //factor=20=> overhead 5%
 
-bitRankW32Int * createBitRankW32Int( uint *bitarray, uint _n, char owner, uint _factor) {
+bitRankW32Int * createBitRankW32Int( uint *bitarray, size_t _n, char owner, uint _factor) {
   bitRankW32Int * br =(bitRankW32Int *) malloc(sizeof(struct sbitRankW32Int));
   br->data=bitarray;
   br->owner = owner;
   br->n=_n;
-  uint lgn=bits(br->n-1);
+  uint lgn=0;
+  size_t aux;
+  for (aux=br->n-1;aux;aux>>=1)
+    lgn++;
   br->factor=_factor;
   if (_factor==0) br->factor=lgn;
   else br->factor=_factor;
@@ -38,22 +41,22 @@ void destroyBitRankW32Int(bitRankW32Int *br) {
 
 //Metodo que realiza la busqueda d
 void buildRank(bitRankW32Int * br) {
-	uint i;
-  uint num_sblock = br->n/br->s;
-  br->Rs = (uint *) malloc(sizeof(uint)*(num_sblock+1));   // +1 pues sumo la pos cero
+	size_t i;
+  size_t num_sblock = br->n/br->s;
+  br->Rs = (size_t *) malloc(sizeof(size_t)*(num_sblock+1));   // +1 pues sumo la pos cero
   for(i=0;i<num_sblock+1;i++)
     br->Rs[i]=0;
-  uint j;
+  size_t j;
   br->Rs[0]=0;
   for (j=1;j<=num_sblock;j++) {
     br->Rs[j]=br->Rs[j-1];
-    br->Rs[j]+=buildRankSub(br, (uint)(j-1)*(br->factor),br->factor);
+    br->Rs[j]+=buildRankSub(br, (j-1)*(br->factor),br->factor);
   }
 }
 
 
-uint buildRankSub(bitRankW32Int * br, uint ini,uint bloques) {
-  uint i;
+uint buildRankSub(bitRankW32Int * br, size_t ini,uint bloques) {
+  size_t i;
   uint rank=0,aux;
   for(i=ini;i<ini+bloques;i++) {
     if (i <= br->integers) {
@@ -66,12 +69,12 @@ uint buildRankSub(bitRankW32Int * br, uint ini,uint bloques) {
 }
 
 
-uint rank(bitRankW32Int * br, uint i) {
-  uint a;
+size_t rank(bitRankW32Int * br, size_t i) {
+  size_t a;
   if(i+1==0) return 0;
   ++i;
-  uint resp=br->Rs[i/br->s];
-  uint aux=(i/br->s)*(br->factor);
+  size_t resp=br->Rs[i/br->s];
+  size_t aux=(i/br->s)*(br->factor);
   for (a=aux;a<i/W;a++)
     resp+=popcount(br->data[a]);
   resp+=popcount(br->data[i/W]  & ((1<<(i & mask31))-1));
@@ -79,34 +82,34 @@ uint rank(bitRankW32Int * br, uint i) {
 }
 
 
-uint isBitSet(bitRankW32Int * br, uint i) 
+uint isBitSet(bitRankW32Int * br, size_t i) 
 {
   return (1u << (i % W)) & br->data[i/W];
 }
 
 
 int save(bitRankW32Int * br, FILE *f) {
-	uint s,n;
+	size_t s,n;
 	s=br->s;
 	n=br->n;
   if (f == NULL) return 20;
-  if (fwrite (&(n),sizeof(uint),1,f) != 1) return 21;
+  if (fwrite (&(n),sizeof(size_t),1,f) != 1) return 21;
   if (fwrite (&(br->factor),sizeof(uint),1,f) != 1) return 21;
   if (fwrite (br->data,sizeof(uint),n/W+1,f) != n/W+1) return 21;
-  if (fwrite (br->Rs,sizeof(uint),n/s+1,f) != n/s+1) return 21;
+  if (fwrite (br->Rs,sizeof(size_t),n/s+1,f) != n/s+1) return 21;
   return 0;
 }
 
 
 int load(bitRankW32Int * br, FILE *f) {
   if (f == NULL) return 23;
-  if (fread (&(br->n),sizeof(uint),1,f) != 1) return 25;
+  if (fread (&(br->n),sizeof(size_t),1,f) != 1) return 25;
   br->b=32;    
   uint b=br->b;                      // b is a word
   if (fread (&(br->factor),sizeof(uint),1,f) != 1) return 25;
   br->s=b*br->factor;
-  uint s=br->s;
-  uint n= br->n;
+  size_t s=br->s;
+  size_t n= br->n;
   //uint aux=(n+1)%W;
   //if (aux != 0)
   //  integers = (n+1)/W+1;
@@ -117,9 +120,9 @@ int load(bitRankW32Int * br, FILE *f) {
   if (!br->data) return 1;
   if (fread (br->data,sizeof(uint),br->n/W+1,f) != n/W+1) return 25;
   br->owner = 1;
-  br->Rs=(uint*)malloc(sizeof(uint)*(n/s+1));
+  br->Rs=(size_t*)malloc(sizeof(size_t)*(n/s+1));
   if (!br->Rs) return 1;
-  if (fread (br->Rs,sizeof(uint),n/s+1,f) != n/s+1) return 25;
+  if (fread (br->Rs,sizeof(size_t),n/s+1,f) != n/s+1) return 25;
   return 0;
 }
 
@@ -131,19 +134,19 @@ bitRankW32Int * createBitRankW32IntFile(FILE *f, int *error) {
 }
 
 
-uint spaceRequirementInBits(bitRankW32Int * br) {
-  return (br->owner?br->n:0)+(br->n/br->s)*sizeof(uint)*8 +sizeof(struct sbitRankW32Int)*8;
+size_t spaceRequirementInBits(bitRankW32Int * br) {
+  return (br->owner?br->n:0)+(br->n/br->s)*sizeof(size_t)*8 +sizeof(struct sbitRankW32Int)*8;
 }
 
-uint lenght_in_bits(bitRankW32Int * br) { return br->n; };
+size_t lenght_in_bits(bitRankW32Int * br) { return br->n; };
 
-uint prev(bitRankW32Int * br,uint start) {
+size_t prev(bitRankW32Int * br,size_t start) {
   // returns the position of the previous 1 bit before and including start.
   // tuned to 32 bit machine
 
-  uint i = start >> 5;
+  size_t i = start >> 5;
   int offset = (start % W);
-  uint answer = start;
+  size_t answer = start;
   uint val = br->data[i] << (Wminusone-offset);
 
   if (!val) { val = br->data[--i]; answer -= 1+offset; }
@@ -158,12 +161,12 @@ uint prev(bitRankW32Int * br,uint start) {
 }
 
 
-uint select1(bitRankW32Int * br,uint x) {
+size_t select1(bitRankW32Int * br,size_t x) {
   return bselect(br,x);
 }
 
 
-uint bselect(bitRankW32Int * br,uint x) {
+size_t bselect(bitRankW32Int * br,size_t x) {
   if(x==0) return 0;
   // returns i such that x=rank(i) && rank(i-1)<x or n if that i not exist
   // first binary search over first level rank structure
@@ -172,14 +175,14 @@ uint bselect(bitRankW32Int * br,uint x) {
   // then sequential search bit a bit
 
   //binary search over first level rank structure
-  uint n= br->n;
-  uint s= br->s;
+  size_t n= br->n;
+  size_t s= br->s;
   uint b=br->b;
-  uint l=0, r=n/s;
-  uint integers = br->integers;
-  uint factor = br->factor;
-  uint mid=(l+r)/2;
-  uint rankmid = br->Rs[mid];
+  size_t l=0, r=n/s;
+  size_t integers = br->integers;
+  size_t factor = br->factor;
+  size_t mid=(l+r)/2;
+  size_t rankmid = br->Rs[mid];
   while (l<=r) {
     if (rankmid<x)
       l = mid+1;
@@ -189,7 +192,7 @@ uint bselect(bitRankW32Int * br,uint x) {
     rankmid = br->Rs[mid];
   }
   //sequential search using popcount over a int
-  uint left;
+  size_t left;
   left=mid*factor;
   x-=rankmid;
   uint j=br->data[left];
@@ -231,7 +234,7 @@ uint bselect(bitRankW32Int * br,uint x) {
 }
 
 
-uint select0(bitRankW32Int * br,uint x) {
+size_t select0(bitRankW32Int * br,size_t x) {
   // returns i such that x=rank_0(i) && rank_0(i-1)<x or n if that i not exist
   // first binary search over first level rank structure
   // then sequential search using popcount over a int
@@ -239,14 +242,14 @@ uint select0(bitRankW32Int * br,uint x) {
   // then sequential search bit a bit
 
   //binary search over first level rank structure
-    uint n= br->n;
-  uint s= br->s;
-  uint factor = br->factor;
-  uint integers = br->integers;
+    size_t n= br->n;
+  size_t s= br->s;
+  size_t factor = br->factor;
+  size_t integers = br->integers;
   uint b= br->b;
-  uint l=0, r=n/s;
-  uint mid=(l+r)/2;
-  uint rankmid = mid*factor*W-(br->Rs)[mid];
+  size_t l=0, r=n/s;
+  size_t mid=(l+r)/2;
+  size_t rankmid = mid*factor*W-(br->Rs)[mid];
   while (l<=r) {
     if (rankmid<x)
       l = mid+1;
@@ -256,7 +259,7 @@ uint select0(bitRankW32Int * br,uint x) {
     rankmid = mid*factor*W-(br->Rs)[mid];
   }
   //sequential search using popcount over a int
-  uint left;
+  size_t left;
   left=mid*factor;
   x-=rankmid;
   uint j=br->data[left];
@@ -35,28 +35,30 @@
 //factor=4 => overhead 25%
 //factor=20=> overhead 5%
 
+//Positions and the superblock array use size_t, so the bitmap can be
+//longer than 2^32 bits.
 typedef struct sbitRankW32Int{
     uint *data;
     char owner;
-    uint integers;
+    size_t integers;
     uint factor,b,s;
-    uint *Rs;  					//superblock array
-    uint n;                  
+    size_t *Rs;  					//superblock array
+    size_t n;                  
 } bitRankW32Int;
                                  //uso interno para contruir el indice rank
-    uint buildRankSub(bitRankW32Int * br,uint ini,uint fin);
+    uint buildRankSub(bitRankW32Int * br,size_t ini,uint fin);
     void buildRank(bitRankW32Int * br);            //crea indice para rank
 
-    bitRankW32Int * createBitRankW32Int(uint *bitarray, uint n, char owner, uint factor);
+    bitRankW32Int * createBitRankW32Int(uint *bitarray, size_t n, char owner, uint factor);
     void destroyBitRankW32Int(bitRankW32Int * br);            //destructor
-    uint isBitSet(bitRankW32Int * br, uint i);
-    uint rank(bitRankW32Int * br, uint i);           //Nivel 1 bin, nivel 2 sec-pop y nivel 3 sec-bit
-    uint lenght_in_bits(bitRankW32Int * br);
-    uint prev(bitRankW32Int * br, uint start);       // gives the largest index i<=start such that IsBitSet(i)=true
-    uint bselect(bitRankW32Int * br, uint x);         // gives the position of the x:th 1.
-    uint select0(bitRankW32Int * br, uint x);        // gives the position of the x:th 0.
-    uint select1(bitRankW32Int * br, uint x);        // gives the position of the x:th 1.
-    uint spaceRequirementInBits(bitRankW32Int * br);
+    uint isBitSet(bitRankW32Int * br, size_t i);
+    size_t rank(bitRankW32Int * br, size_t i);           //Nivel 1 bin, nivel 2 sec-pop y nivel 3 sec-bit
+    size_t lenght_in_bits(bitRankW32Int * br);
+    size_t prev(bitRankW32Int * br, size_t start);       // gives the largest index i<=start such that IsBitSet(i)=true
+    size_t bselect(bitRankW32Int * br, size_t x);         // gives the position of the x:th 1.
+    size_t select0(bitRankW32Int * br, size_t x);        // gives the position of the x:th 0.
+    size_t select1(bitRankW32Int * br, size_t x);        // gives the position of the x:th 1.
+    size_t spaceRequirementInBits(bitRankW32Int * br);
     /*load-save functions*/
     int save(bitRankW32Int * br, FILE *f);
     int load(bitRankW32Int * br, FILE *f);
@@ -1,180 +1,332 @@
-/*
- * ----------------------------------------------------------------------------
- * "THE BEER-WARE LICENSE" (Revision 42):
- * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
- * can do whatever you want with this stuff. If we meet some day, and you think
- * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
- * ----------------------------------------------------------------------------
- */
-
-/**
- * C++ wrapper over library
- */
-
-extern "C" {
-  #include "directcodes.h"
-}
-#include <fstream>
-
-/* 
- * Saves a value into an ofstream.
- */
-template <typename T>
-void SaveValue(std::ofstream *out, T val) {
-  out->write(reinterpret_cast<char *>(&val), sizeof(T));
-}
-
-/* 
- * Loads a value from an istream.
- */
-template <typename T>
-T LoadValue(std::ifstream *in) {
-  T ret;
-  in->read(reinterpret_cast<char *>(&ret), sizeof(T));
-  return ret;
-}
-
-/* 
- * Saves len values into an ofstream.
- */
-template <typename T>
-void SaveValue(std::ofstream *out, T *val, size_t length) {
-  out->write(reinterpret_cast<char *>(val), length * sizeof(T));
-}
-
-/* 
- * Loads len values from an istream.
- */
-template <typename T>
-T *LoadValue(std::ifstream *in, size_t length) {
-  T *ret = new T[length];
-  in->read(reinterpret_cast<char *>(ret), length * sizeof(T));
-  return ret;
-}
-
-
-
-void save_bitrank(bitRankW32Int * br, std::ofstream *out) {
-	uint s,n;
-	s=br->s;
-	n=br->n;
-  SaveValue(out, n);
-  SaveValue(out, br->factor);
-  SaveValue(out, br->data, n/W+1);
-  SaveValue(out, br->Rs, n/s+1);
-}
-
-void load_bitrank(bitRankW32Int * br, std::ifstream *in) {
-  br->n = LoadValue<uint>(in);
-  br->b=32;    
-  uint b=br->b;                      // b is a word
-  br->factor = LoadValue<uint>(in);
-  br->s=b*br->factor;
-  uint s=br->s;
-  uint n= br->n;
-  br->integers = n/W;
-  br->data= (uint *) malloc(sizeof( uint) *(n/W+1));
-
-  in->read(reinterpret_cast<char *>(br->data),sizeof(uint)*(br->n/W+1));
-  br->owner = 1;
-  br->Rs=(uint*)malloc(sizeof(uint)*(n/s+1));
-  in->read(reinterpret_cast<char *>(br->Rs),sizeof(uint)*(n/s+1));
-}
-
-bool equalsRank(bitRankW32Int *lhs, bitRankW32Int *rhs) {
-  if (lhs->owner != rhs->owner || lhs->integers != rhs->integers ||
-      lhs->factor != rhs->factor || lhs->b != rhs->b ||
-      lhs->s != rhs->s || lhs->n != rhs->n)
-    return false;
-
-  for (uint i = 0; i < lhs->n/W + 1; ++i)
-    if (lhs->data[i] != rhs->data[i])
-      return false;
-
-  for (uint i = 0; i < lhs->n/lhs->s + 1; ++i)
-    if (lhs->data[i] != rhs->data[i])
-      return false;
-
-  return true;
-}
-bool equalsFT(FTRep *lhs, FTRep *rhs) {
-  if (lhs->listLength != rhs->listLength || lhs->nLevels != rhs->nLevels ||
-      lhs->tamCode != rhs->tamCode || lhs->tamtablebase != rhs->tamtablebase)
-    return false;
-
-  for (uint i = 0; i < lhs->nLevels; ++i) {
-    if (lhs->base_bits[i] != rhs->base_bits[i] ||
-        lhs->base[i] != rhs->base[i] ||
-        lhs->iniLevel[i] != rhs->iniLevel[i] ||
-        lhs->rankLevels[i] != rhs->rankLevels[i] ||
-        lhs->levelsIndex[i] != rhs->levelsIndex[i])
-      return false;
-  }
-
-  if (lhs->levelsIndex[lhs->nLevels] != rhs->levelsIndex[lhs->nLevels])
-    return false;
-
-  for (uint i = 0; i< lhs->tamtablebase; ++i)
-    if (lhs->tablebase[i] != rhs->tablebase[i])
-      return false;
-
-  for (uint i = 0; i < lhs->tamCode/W + 1; ++i)
-    if (lhs->levels[i] != rhs->levels[i])
-      return false;
-  return equalsRank(lhs->bS, rhs->bS);
-}
-
-void SaveFT(std::ofstream *out, FTRep *rep) {
-	SaveValue(out, rep->listLength);
-	SaveValue(out, rep->nLevels);
-	SaveValue(out, rep->tamCode);
-	SaveValue(out, rep->tamtablebase);
-	SaveValue(out, rep->tablebase, rep->tamtablebase);	
-	SaveValue(out, rep->base_bits, rep->nLevels);
-	SaveValue(out, rep->base, rep->nLevels);
-	SaveValue(out, rep->levelsIndex, rep->nLevels+1);
-	SaveValue(out, rep->iniLevel, rep->nLevels);
-	SaveValue(out, rep->rankLevels, rep->nLevels);
-
-	SaveValue(out, rep->levels, rep->tamCode/W+1);
-
-	save_bitrank(rep->bS, out);
-}
-
-FTRep* LoadFT(std::ifstream *in) {
-	FTRep * rep = (FTRep *) malloc(sizeof(struct sFTRep));
-	rep->listLength = LoadValue<uint>(in);
-	rep->nLevels = LoadValue<byte>(in);
-	rep->tamCode = LoadValue<uint>(in);
-	
-	rep->tamtablebase = LoadValue<uint>(in);
-	rep->tablebase = (uint *) malloc(sizeof(uint)*rep->tamtablebase);
-	in->read(reinterpret_cast<char *>(rep->tablebase), sizeof(uint)*rep->tamtablebase);	
-	
-	rep->base_bits = (ushort *) malloc(sizeof(ushort)*rep->nLevels);
-	in->read(reinterpret_cast<char *>(rep->base_bits),sizeof(ushort)*rep->nLevels);
-	
-	
-	rep->base = (uint *) malloc(sizeof(uint)*rep->nLevels);
-	in->read(reinterpret_cast<char *>(rep->base),sizeof(uint)*rep->nLevels);
-	
-	
-	rep->levelsIndex = (uint *) malloc(sizeof(uint)*(rep->nLevels+1));
-	in->read(reinterpret_cast<char *>(rep->levelsIndex),sizeof(uint)*(rep->nLevels+1));
-	
-	rep->iniLevel = (uint *) malloc(sizeof(uint)*rep->nLevels);
-	in->read(reinterpret_cast<char *>(rep->iniLevel),sizeof(uint)*rep->nLevels);
-
-	rep->rankLevels = (uint *) malloc(sizeof(uint)*(rep->nLevels));
-	in->read(reinterpret_cast<char *>(rep->rankLevels),sizeof(uint)*rep->nLevels);
-	
-	rep->levels = (uint *) malloc(sizeof(uint)*(rep->tamCode/W+1));	
-	in->read(reinterpret_cast<char *>(rep->levels),sizeof(uint)*(rep->tamCode/W+1));
-		
-	
-	rep->bS = (bitRankW32Int *) malloc(sizeof(struct sbitRankW32Int));
-	load_bitrank(rep->bS, in);	
-	
-	
-	return rep;
-}
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+/**
+ * C++ wrapper over library
+ */
+
+extern "C" {
+  #include "directcodes.h"
+}
+#include <fstream>
+#include <cstring>
+
+/*
+ * Alignment of the large arrays in the file. It must match kFileAlignment
+ * in libk2tree, so they can be used in place with MapFT.
+ */
+static const size_t kAlignment = 64;
+
+/*
+ * Returns the number of padding bytes needed after pos.
+ */
+static size_t Padding(size_t pos) {
+  return (kAlignment - pos%kAlignment) % kAlignment;
+}
+
+/*
+ * Writes zeros until the position of the stream is aligned.
+ */
+static void AlignStream(std::ofstream *out) {
+  static const char zeros[kAlignment] = {0};
+  out->write(zeros, (std::streamsize) Padding((size_t) out->tellp()));
+}
+
+/*
+ * Skips the padding written by AlignStream.
+ */
+static void AlignStream(std::ifstream *in) {
+  in->seekg((std::streamoff) Padding((size_t) in->tellg()),
+            std::ios_base::cur);
+}
+
+/*
+ * Reads a value from a mapped file at *pos and advances past it.
+ */
+template <typename T>
+T MapValue(const char *data, size_t *pos) {
+  T ret;
+  memcpy(&ret, data + *pos, sizeof(T));
+  *pos += sizeof(T);
+  return ret;
+}
+
+/*
+ * Copies len values from a mapped file at *pos into a new array.
+ */
+template <typename T>
+T *MapCopy(const char *data, size_t *pos, size_t length) {
+  T *ret = (T *) malloc(sizeof(T)*length);
+  memcpy(ret, data + *pos, sizeof(T)*length);
+  *pos += sizeof(T)*length;
+  return ret;
+}
+
+/*
+ * Returns a pointer to an aligned array of len values in a mapped file.
+ */
+template <typename T>
+T *MapArray(const char *data, size_t *pos, size_t length) {
+  *pos += Padding(*pos);
+  T *ret = (T *) (data + *pos);
+  *pos += sizeof(T)*length;
+  return ret;
+}
+
+/* 
+ * Saves a value into an ofstream.
+ */
+template <typename T>
+void SaveValue(std::ofstream *out, T val) {
+  out->write(reinterpret_cast<char *>(&val), sizeof(T));
+}
+
+/* 
+ * Loads a value from an istream.
+ */
+template <typename T>
+T LoadValue(std::ifstream *in) {
+  T ret;
+  in->read(reinterpret_cast<char *>(&ret), sizeof(T));
+  return ret;
+}
+
+/* 
+ * Saves len values into an ofstream.
+ */
+template <typename T>
+void SaveValue(std::ofstream *out, T *val, size_t length) {
+  out->write(reinterpret_cast<char *>(val),
+             (std::streamsize) (length * sizeof(T)));
+}
+
+/* 
+ * Loads len values from an istream.
+ */
+template <typename T>
+T *LoadValue(std::ifstream *in, size_t length) {
+  T *ret = new T[length];
+  in->read(reinterpret_cast<char *>(ret), length * sizeof(T));
+  return ret;
+}
+
+
+
+/*
+ * Files saved by the versions of libk2tree before the file header, called
+ * legacy here, store lengths and positions with 32 bits and no padding.
+ */
+
+/*
+ * Loads a length or position.
+ */
+static size_t LoadLength(std::ifstream *in, bool legacy) {
+  if (legacy)
+    return LoadValue<uint>(in);
+  return LoadValue<size_t>(in);
+}
+
+/*
+ * Loads len lengths or positions into a new array.
+ */
+static size_t *LoadLengths(std::ifstream *in, size_t length, bool legacy) {
+  size_t *ret = (size_t *) malloc(sizeof(size_t)*length);
+  if (legacy) {
+    for (size_t i = 0; i < length; ++i)
+      ret[i] = LoadValue<uint>(in);
+  } else {
+    in->read(reinterpret_cast<char *>(ret),
+             (std::streamsize) (sizeof(size_t)*length));
+  }
+  return ret;
+}
+
+/*
+ * Skips the padding before an array, legacy files have none.
+ */
+static void SkipPadding(std::ifstream *in, bool legacy) {
+  if (!legacy)
+    AlignStream(in);
+}
+
+void save_bitrank(bitRankW32Int * br, std::ofstream *out) {
+	size_t s,n;
+	s=br->s;
+	n=br->n;
+  SaveValue(out, n);
+  SaveValue(out, br->factor);
+  AlignStream(out);
+  SaveValue(out, br->data, n/W+1);
+  AlignStream(out);
+  SaveValue(out, br->Rs, n/s+1);
+}
+
+void load_bitrank(bitRankW32Int * br, std::ifstream *in, bool legacy) {
+  br->n = LoadLength(in, legacy);
+  br->b=32;    
+  uint b=br->b;                      // b is a word
+  br->factor = LoadValue<uint>(in);
+  br->s=b*br->factor;
+  size_t s=br->s;
+  size_t n= br->n;
+  br->integers = n/W;
+  br->data= (uint *) malloc(sizeof( uint) *(n/W+1));
+  SkipPadding(in, legacy);
+
+  in->read(reinterpret_cast<char *>(br->data),
+           (std::streamsize) (sizeof(uint)*(br->n/W+1)));
+  br->owner = 1;
+  SkipPadding(in, legacy);
+  br->Rs = LoadLengths(in, n/s+1, legacy);
+}
+
+bool equalsRank(bitRankW32Int *lhs, bitRankW32Int *rhs) {
+  if (lhs->integers != rhs->integers ||
+      lhs->factor != rhs->factor || lhs->b != rhs->b ||
+      lhs->s != rhs->s || lhs->n != rhs->n)
+    return false;
+
+  for (size_t i = 0; i < lhs->n/W + 1; ++i)
+    if (lhs->data[i] != rhs->data[i])
+      return false;
+
+  for (size_t i = 0; i < lhs->n/lhs->s + 1; ++i)
+    if (lhs->Rs[i] != rhs->Rs[i])
+      return false;
+
+  return true;
+}
+bool equalsFT(FTRep *lhs, FTRep *rhs) {
+  if (lhs->listLength != rhs->listLength || lhs->nLevels != rhs->nLevels ||
+      lhs->tamCode != rhs->tamCode || lhs->tamtablebase != rhs->tamtablebase)
+    return false;
+
+  for (uint i = 0; i < lhs->nLevels; ++i) {
+    if (lhs->base_bits[i] != rhs->base_bits[i] ||
+        lhs->base[i] != rhs->base[i] ||
+        lhs->iniLevel[i] != rhs->iniLevel[i] ||
+        lhs->rankLevels[i] != rhs->rankLevels[i] ||
+        lhs->levelsIndex[i] != rhs->levelsIndex[i])
+      return false;
+  }
+
+  if (lhs->levelsIndex[lhs->nLevels] != rhs->levelsIndex[lhs->nLevels])
+    return false;
+
+  for (uint i = 0; i< lhs->tamtablebase; ++i)
+    if (lhs->tablebase[i] != rhs->tablebase[i])
+      return false;
+
+  for (size_t i = 0; i < lhs->tamCode/W + 1; ++i)
+    if (lhs->levels[i] != rhs->levels[i])
+      return false;
+  return equalsRank(lhs->bS, rhs->bS);
+}
+
+void SaveFT(std::ofstream *out, FTRep *rep) {
+	SaveValue(out, rep->listLength);
+	SaveValue(out, rep->nLevels);
+	SaveValue(out, rep->tamCode);
+	SaveValue(out, rep->tamtablebase);
+	AlignStream(out);
+	SaveValue(out, rep->tablebase, rep->tamtablebase);	
+	SaveValue(out, rep->base_bits, rep->nLevels);
+	SaveValue(out, rep->base, rep->nLevels);
+	SaveValue(out, rep->levelsIndex, rep->nLevels+1);
+	SaveValue(out, rep->iniLevel, rep->nLevels);
+	SaveValue(out, rep->rankLevels, rep->nLevels);
+
+	AlignStream(out);
+	SaveValue(out, rep->levels, rep->tamCode/W+1);
+
+	save_bitrank(rep->bS, out);
+}
+
+/*
+ * Loads a DAC saved in the current or the legacy layout.
+ */
+static FTRep *ReadFT(std::ifstream *in, bool legacy) {
+	FTRep * rep = (FTRep *) malloc(sizeof(struct sFTRep));
+	rep->listLength = LoadLength(in, legacy);
+	rep->nLevels = LoadValue<byte>(in);
+	rep->tamCode = LoadLength(in, legacy);
+	
+	rep->tamtablebase = LoadValue<uint>(in);
+	rep->tablebase = (uint *) malloc(sizeof(uint)*rep->tamtablebase);
+	SkipPadding(in, legacy);
+	in->read(reinterpret_cast<char *>(rep->tablebase), sizeof(uint)*rep->tamtablebase);	
+	
+	rep->base_bits = (ushort *) malloc(sizeof(ushort)*rep->nLevels);
+	in->read(reinterpret_cast<char *>(rep->base_bits),sizeof(ushort)*rep->nLevels);
+	
+	
+	rep->base = (uint *) malloc(sizeof(uint)*rep->nLevels);
+	in->read(reinterpret_cast<char *>(rep->base),sizeof(uint)*rep->nLevels);
+	
+	rep->levelsIndex = LoadLengths(in, rep->nLevels+1, legacy);
+	rep->iniLevel = LoadLengths(in, rep->nLevels, legacy);
+	rep->rankLevels = LoadLengths(in, rep->nLevels, legacy);
+	
+	rep->levels = (uint *) malloc(sizeof(uint)*(rep->tamCode/W+1));	
+	SkipPadding(in, legacy);
+	in->read(reinterpret_cast<char *>(rep->levels),
+	         (std::streamsize) (sizeof(uint)*(rep->tamCode/W+1)));
+		
+	
+	rep->bS = (bitRankW32Int *) malloc(sizeof(struct sbitRankW32Int));
+	load_bitrank(rep->bS, in, legacy);	
+	
+	
+	return rep;
+}
+
+FTRep *LoadFT(std::ifstream *in) {
+  return ReadFT(in, false);
+}
+
+FTRep *LoadLegacyFT(std::ifstream *in) {
+  return ReadFT(in, true);
+}
+
+FTRep *MapFT(const char *data, size_t *pos) {
+  FTRep *rep = (FTRep *) malloc(sizeof(struct sFTRep));
+  rep->listLength = MapValue<size_t>(data, pos);
+  rep->nLevels = MapValue<byte>(data, pos);
+  rep->tamCode = MapValue<size_t>(data, pos);
+  rep->tamtablebase = MapValue<uint>(data, pos);
+  rep->tablebase = MapArray<uint>(data, pos, rep->tamtablebase);
+  rep->base_bits = MapCopy<ushort>(data, pos, rep->nLevels);
+  rep->base = MapCopy<uint>(data, pos, rep->nLevels);
+  rep->levelsIndex = MapCopy<size_t>(data, pos, rep->nLevels+1);
+  rep->iniLevel = MapCopy<size_t>(data, pos, rep->nLevels);
+  rep->rankLevels = MapCopy<size_t>(data, pos, rep->nLevels);
+  rep->levels = MapArray<uint>(data, pos, rep->tamCode/W+1);
+
+  bitRankW32Int *br = (bitRankW32Int *) malloc(sizeof(struct sbitRankW32Int));
+  br->n = MapValue<size_t>(data, pos);
+  br->b = 32;
+  br->factor = MapValue<uint>(data, pos);
+  br->s = br->b*br->factor;
+  br->integers = br->n/W;
+  br->data = MapArray<uint>(data, pos, br->n/W+1);
+  br->owner = 0;
+  br->Rs = MapArray<size_t>(data, pos, br->n/br->s+1);
+  rep->bS = br;
+  return rep;
+}
+
+void UnmapFT(FTRep *rep) {
+  free(rep->base_bits);
+  free(rep->base);
+  free(rep->levelsIndex);
+  free(rep->iniLevel);
+  free(rep->rankLevels);
+  free(rep->bS);
+  free(rep);
+}
@@ -104,8 +104,8 @@ uint mypow(uint base, uint exponente) {
 
 
 
-ushort * optimizationk(uint * acumFreqs,int maxInt, uint * nkvalues) {
-  int sizeVoc = maxInt;
+ushort * optimizationk(size_t * acumFreqs,uint maxInt, uint * nkvalues) {
+  uint sizeVoc = maxInt;
 
   //uint listLength = acumFreqs[sizeVoc];	
   uint nBits = bits(sizeVoc);
@@ -122,7 +122,7 @@ ushort * optimizationk(uint * acumFreqs,int maxInt, uint * nkvalues) {
 
   int j;
   ulong maxSize = 0, maxPos = 0;
-  int posVocInf, posVocSup;
+  size_t posVocInf, posVocSup;
   ulong currentSize;
   //Para la optimizacion, hay que mirar el máximo de todas las opciones anteriores anhadiendo
   //hasta el bit actual
@@ -142,8 +142,8 @@ ushort * optimizationk(uint * acumFreqs,int maxInt, uint * nkvalues) {
       if(i==nBits)
         posVocInf=0;
       else
-        posVocInf=1<<(nBits-i);
-      posVocSup=(1<<(nBits-j));
+        posVocInf=(size_t)1<<(nBits-i);
+      posVocSup=((size_t)1<<(nBits-j));
       if(posVocSup>=sizeVoc)
         posVocSup=sizeVoc;
       if(j==0)
@@ -177,8 +177,8 @@ ushort * optimizationk(uint * acumFreqs,int maxInt, uint * nkvalues) {
     if(bitCountInf==0)
       posVocInf=0;
     else
-      posVocInf=1<<bitCountInf;
-    posVocSup=(1<<bitCountSup);
+      posVocInf=(size_t)1<<bitCountInf;
+    posVocSup=((size_t)1<<bitCountSup);
     if(posVocSup>=sizeVoc)
       posVocSup=sizeVoc;
     if(j==tableNLevels[nBits])
@@ -220,21 +220,21 @@ ushort * optimizationk(uint * acumFreqs,int maxInt, uint * nkvalues) {
 
 
 
-FTRep* createFT(uint *list,uint listLength){
+FTRep* createFT(uint *list,size_t listLength){
   FTRep * rep = (FTRep *) malloc(sizeof(struct sFTRep));
-  uint *levelSizeAux;
-  uint *cont;	
-  uint *contB;
+  size_t *levelSizeAux;
+  size_t *cont;	
+  size_t *contB;
 
   ushort* kvalues;
   uint nkvalues;
 
   rep->listLength = listLength;
-  register uint i;
+  register size_t i;
   int j, k;
   uint l;
   uint value, newvalue;
-  uint bits_BS_len = 0;
+  size_t bits_BS_len = 0;
 
   //ushort kvalues[4] = {0,2,4,8};
   //uint nkvalues=4;
@@ -249,7 +249,7 @@ FTRep* createFT(uint *list,uint listLength){
 
   maxInt++;
 
-  uint * weight = (uint *) malloc(sizeof(uint)*maxInt);
+  size_t * weight = (size_t *) malloc(sizeof(size_t)*maxInt);
 
 
   for(l=0; l<maxInt; l++)
@@ -259,7 +259,7 @@ FTRep* createFT(uint *list,uint listLength){
     weight[list[i]]++;
 
 
-  uint * acumFreq = (uint *) malloc(sizeof(uint)*(maxInt+1));
+  size_t * acumFreq = (size_t *) malloc(sizeof(size_t)*(maxInt+1));
 
   acumFreq[0]=0;	
   for(i=0;i<maxInt;i++)
@@ -296,9 +296,9 @@ FTRep* createFT(uint *list,uint listLength){
 
   rep->tamtablebase = i;
   rep->tablebase = (uint *) malloc(sizeof(uint)*rep->tamtablebase);
-  levelSizeAux = (uint *) malloc(sizeof(uint)*rep->tamtablebase);
-  cont = (uint *) malloc(sizeof(uint)*rep->tamtablebase);
-  contB = (uint *) malloc(sizeof(uint)*rep->tamtablebase);
+  levelSizeAux = (size_t *) malloc(sizeof(size_t)*rep->tamtablebase);
+  cont = (size_t *) malloc(sizeof(size_t)*rep->tamtablebase);
+  contB = (size_t *) malloc(sizeof(size_t)*rep->tamtablebase);
 
   oldval =0;
   newval =0;
@@ -335,7 +335,7 @@ FTRep* createFT(uint *list,uint listLength){
     j++;
   }
   rep->nLevels = j;
-  rep->levelsIndex = (uint *) malloc(sizeof(uint)*(rep->nLevels+1));
+  rep->levelsIndex = (size_t *) malloc(sizeof(size_t)*(rep->nLevels+1));
   bits_BS_len =0;
 
   rep->base = (uint *)malloc(sizeof(uint)*rep->nLevels);
@@ -352,7 +352,7 @@ FTRep* createFT(uint *list,uint listLength){
     }
   }
 
-  uint tamLevels =0;
+  size_t tamLevels =0;
 
 
 
@@ -360,9 +360,9 @@ FTRep* createFT(uint *list,uint listLength){
   for(i=0;i<rep->nLevels;i++)
     tamLevels+=rep->base_bits[i]*levelSizeAux[i];
 
-  rep->iniLevel = (uint *)malloc(sizeof(uint)*rep->nLevels);		
+  rep->iniLevel = (size_t *)malloc(sizeof(size_t)*rep->nLevels);		
   rep->tamCode=tamLevels;
-  uint indexLevel=0;
+  size_t indexLevel=0;
   rep->levelsIndex[0]=0;
   for(j=0;j<rep->nLevels;j++){
     rep->levelsIndex[j+1]=rep->levelsIndex[j] + levelSizeAux[j];
@@ -427,7 +427,7 @@ FTRep* createFT(uint *list,uint listLength){
 
 
 
-  rep->rankLevels = (uint *) malloc(sizeof(uint)*rep->nLevels);
+  rep->rankLevels = (size_t *) malloc(sizeof(size_t)*rep->nLevels);
   for(j=0;j<rep->nLevels;j++)
     rep->rankLevels[j]= rank(rep->bS, rep->levelsIndex[j]-1);
 
@@ -444,7 +444,7 @@ FTRep* createFT(uint *list,uint listLength){
 
   ---------------------------------------------------------------- */
 
-uint accessFT(FTRep * listRep,uint param){
+uint accessFT(FTRep * listRep,size_t param){
   uint mult=0;
   //register uint i;
   register uint j;
@@ -453,14 +453,14 @@ uint accessFT(FTRep * listRep,uint param){
   //uint n , partialSum=0, sumAux=0;
   uint partialSum=0;
   //uint ini = param-1;
-  uint ini = param;
+  size_t ini = param;
   //bitRankW32Int * bS = listRep->bS;
   //uint * bsData = listRep->bS->data;
   uint nLevels=listRep->nLevels;
   //uint levelIndex;
   uint * level;
   uint readByte;
-  uint cont,pos, rankini;
+  size_t cont,pos, rankini;
 
 
   //	fprintf(stderr,"Queriendo leer la posicion: %d\n",ini);
@@ -537,9 +537,9 @@ uint accessFT(FTRep * listRep,uint param){
 
   ---------------------------------------------------------------- */
 
-uint * decompressFT(FTRep * listRep, uint n){
+uint * decompressFT(FTRep * listRep, size_t n){
   uint mult=0;
-  register uint i;
+  register size_t i;
   register uint j;
   //uint partialSum=0, sumAux=0;
   uint partialSum=0;
@@ -551,8 +551,8 @@ uint * decompressFT(FTRep * listRep, uint n){
   uint * level=listRep->levels;
   byte readByte;
   uint * list = (uint *) malloc(sizeof(uint)*n);
-  uint * cont = (uint *) malloc(sizeof(byte*)*listRep->nLevels);
-  uint * pos = (uint *) malloc(sizeof(uint)*listRep->nLevels);
+  size_t * cont = (size_t *) malloc(sizeof(size_t)*listRep->nLevels);
+  size_t * pos = (size_t *) malloc(sizeof(size_t)*listRep->nLevels);
 
   for(j=0;j<nLevels;j++){
     cont[j]=listRep->iniLevel[j];
@@ -651,16 +651,16 @@ void destroyFT(FTRep * rep){
 void saveFT(FTRep * rep, FILE * flist){
   //int i;
 
-  fwrite(&(rep->listLength),sizeof(uint),1,flist);
+  fwrite(&(rep->listLength),sizeof(size_t),1,flist);
   fwrite(&(rep->nLevels),sizeof(byte),1,flist);
-  fwrite(&(rep->tamCode),sizeof(uint),1,flist);
+  fwrite(&(rep->tamCode),sizeof(size_t),1,flist);
   fwrite(&(rep->tamtablebase),sizeof(uint),1,flist);
   fwrite(rep->tablebase,sizeof(uint),rep->tamtablebase,flist);	
   fwrite(rep->base_bits,sizeof(ushort),rep->nLevels,flist);
   fwrite(rep->base,sizeof(uint),rep->nLevels,flist);
-  fwrite(rep->levelsIndex,sizeof(uint),rep->nLevels+1,flist);
-  fwrite(rep->iniLevel,sizeof(uint),rep->nLevels,flist);
-  fwrite(rep->rankLevels,sizeof(uint),rep->nLevels,flist);
+  fwrite(rep->levelsIndex,sizeof(size_t),rep->nLevels+1,flist);
+  fwrite(rep->iniLevel,sizeof(size_t),rep->nLevels,flist);
+  fwrite(rep->rankLevels,sizeof(size_t),rep->nLevels,flist);
   //for(i=0;i<rep->nLevels;i++)
   //	fprintf(stderr,"i:%d ranklevel: %d\n",i,rep->rankLevels[i]);
   fwrite(rep->levels,sizeof(uint),(rep->tamCode/W+1),flist);
@@ -699,9 +699,9 @@ FTRep* loadFT(FILE * flist){
   //int i;
   FTRep * rep = (FTRep *) malloc(sizeof(struct sFTRep));
   //flist = fopen(filename,"r");
-  fread(&(rep->listLength),sizeof(uint),1,flist);
+  fread(&(rep->listLength),sizeof(size_t),1,flist);
   fread(&(rep->nLevels),sizeof(byte),1,flist);
-  fread(&(rep->tamCode),sizeof(uint),1,flist);
+  fread(&(rep->tamCode),sizeof(size_t),1,flist);
 
   fread(&(rep->tamtablebase),sizeof(uint),1,flist);
   rep->tablebase = (uint *) malloc(sizeof(uint)*rep->tamtablebase);
@@ -718,14 +718,14 @@ FTRep* loadFT(FILE * flist){
   //for(i=0;i<rep->nLevels;i++)
   //	fprintf(stderr,"base[%d]=%d\n",i,rep->base[i]);
 
-  rep->levelsIndex = (uint *) malloc(sizeof(uint)*(rep->nLevels+1));
-  fread(rep->levelsIndex,sizeof(uint),rep->nLevels+1,flist);
+  rep->levelsIndex = (size_t *) malloc(sizeof(size_t)*(rep->nLevels+1));
+  fread(rep->levelsIndex,sizeof(size_t),rep->nLevels+1,flist);
 
-  rep->iniLevel = (uint *) malloc(sizeof(uint)*rep->nLevels);
-  fread(rep->iniLevel,sizeof(uint),rep->nLevels,flist);
+  rep->iniLevel = (size_t *) malloc(sizeof(size_t)*rep->nLevels);
+  fread(rep->iniLevel,sizeof(size_t),rep->nLevels,flist);
 
-  rep->rankLevels = (uint *) malloc(sizeof(uint)*(rep->nLevels));
-  fread(rep->rankLevels,sizeof(uint),rep->nLevels,flist);
+  rep->rankLevels = (size_t *) malloc(sizeof(size_t)*(rep->nLevels));
+  fread(rep->rankLevels,sizeof(size_t),rep->nLevels,flist);
   //for(i=0;i<rep->nLevels;i++)
   //	fprintf(stderr,"i:%d ranklevel: %d\n",i,rep->rankLevels[i]);
   rep->levels = (uint *) malloc(sizeof(uint)*(rep->tamCode/W+1));	
@@ -764,13 +764,13 @@ FTRep* loadFT(FILE * flist){
 }
 
 
-uint memoryUsage(FTRep* rep) {
+size_t memoryUsage(FTRep* rep) {
   return sizeof(uint)*rep->tamtablebase 
     + sizeof(ushort)*rep->nLevels
     + sizeof(ushort)*rep->nLevels
-    + sizeof(uint)*(rep->nLevels+1)
-    + sizeof(uint)*(rep->nLevels)
-    + sizeof(uint)*(rep->nLevels)
+    + sizeof(size_t)*(rep->nLevels+1)
+    + sizeof(size_t)*(rep->nLevels)
+    + sizeof(size_t)*(rep->nLevels)
     + sizeof(uint)*(rep->tamCode/W+1)
     + spaceRequirementInBits(rep->bS)/8
     + sizeof(struct sFTRep);
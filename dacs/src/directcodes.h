@@ -8,14 +8,16 @@
 #include "basic.h"
 #include "bitrankw32int.h"
 
+//Lengths and positions use size_t, so the list can have more than 2^32
+//elements. The values stored remain 32-bit.
 typedef struct sFTRep {
-	  uint listLength;
+	  size_t listLength;
 	  byte nLevels;
-	  uint tamCode;
+	  size_t tamCode;
 	  uint * levels;
-	  uint * levelsIndex;
-	  uint * iniLevel;
-	  uint * rankLevels;
+	  size_t * levelsIndex;
+	  size_t * iniLevel;
+	  size_t * rankLevels;
 	  bitRankW32Int * bS;	
 	  //uint * bits_bitmap;
 	  uint * base;
@@ -29,9 +31,9 @@ typedef struct sFTRep {
 
 
 // public:
-	FTRep* createFT(uint *list,uint listLength);
-	uint accessFT(FTRep * listRep,uint param);
+	FTRep* createFT(uint *list,size_t listLength);
+	uint accessFT(FTRep * listRep,size_t param);
 	void saveFT(FTRep * listRep, FILE * flist);
-	uint * decompressFT(FTRep * listRep, uint n);
+	uint * decompressFT(FTRep * listRep, size_t n);
 	FTRep* loadFT(FILE * flist);
 	void destroyFT(FTRep * listRep);
@@ -12,27 +12,31 @@
 
 #include <libk2tree_basic.h>
 #include <utils/bitarray.h>
+#include <utils/bits.h>
 #include <utils/utils.h>
+#include <utils/rank_bitarray.h>
+#include <utils/mapped_file.h>
+#include <utils/file_format.h>
 #include <utils/array_queue.h>
 #include <utils/libremainder.h>
-#include <libcds2/immutable/bitsequence.h>
-#include <libcds2/array.h>
-#include <libcds2/libcds.h>
 #include <cstdlib>
 #include <queue>
 #include <memory>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 
 namespace libk2tree {
-using cds::immutable::BitSequence;
-using cds::immutable::BitSequenceOneLevelRank;
-using cds::basic::ArrayTpl;
+using utils::RankBitArray;
 using utils::BitArray;
 using std::ifstream;
 using std::ofstream;
 using utils::Ceil;
 using utils::LoadValue;
 using utils::SaveValue;
+using utils::MappedFile;
+using utils::MappedReader;
 using utils::ArrayQueue;
 using libremainder::Divider;
 
@@ -47,10 +51,66 @@ struct RangeFrame {
   size_t z;
 };
 
+/**
+ * Node in the stack of a depth-first range query.
+ */
+struct StackFrame {
+  RangeFrame f;
+  uint level;
+};
+
+/**
+ * Order in which a range query traverses the tree.
+ */
+enum Traversal {
+  /**
+   * Level by level. The working set is the frontier of each level, which
+   * grows with the size of the submatrix.
+   */
+  kBreadthFirst,
+  /**
+   * Path by path, using a stack of at most height*k<sup>2</sup> frames.
+   * Links are reported in Z-order.
+   */
+  kDepthFirst
+};
+
+/**
+ * Node visited by a group of objects in a multi-object traversal.
+ * The group is given by the positions [lo, hi) in the sorted input, base is
+ * the first object covered by the node and other its first position in the
+ * other dimension.
+ */
+struct MultiFrame {
+  size_t lo, hi;
+  cnt_size base, other;
+  size_t z;
+};
+
+/**
+ * Mutable state needed to traverse a hybrid <em>k<sup>2</sup></em>tree.
+ * Queries that don't receive a context use a fresh one, so they can run
+ * concurrently from several threads or re-entrantly from inside a callback.
+ * A context can be owned and reused by the caller to avoid setting up the
+ * traversal on every query, but it must not be used by two queries at the
+ * same time.
+ */
+struct QueryContext {
+  /** Queue to traverse the tree in a range query */
+  ArrayQueue<RangeFrame> range_queue;
+  /** Queue to traverse the tree */
+  ArrayQueue<Frame> neighbors_queue;
+  /** Queue to traverse the tree for several objects at once */
+  ArrayQueue<MultiFrame> multi_queue;
+  /** Stack to traverse the tree depth first in a range query */
+  std::vector<StackFrame> range_stack;
+};
 
 
 struct DirectImpl;
 struct InverseImpl;
+template<class Hybrid, class Impl> class LinksCursor;
+template<class Hybrid> class RangeCursor;
 
 /**
  * Base implementation for <em>k<sup>2</sup></em>tree with a hybrid approach.
@@ -61,6 +121,8 @@ struct InverseImpl;
  */
 template<class Hybrid>
 class base_hybrid {
+  template<class H, class I> friend class LinksCursor;
+  template<class H> friend class RangeCursor;
  public:
   /**
    * Destructor
@@ -102,13 +164,11 @@ class base_hybrid {
     uint k;
     z = 0;
     for (uint level = 0; level < height_ - 1; ++level) {
-      if (level > 0 && !T_->Access(z))
-        return false;
-
       k = GetK(level);
       div_level = div_level_[level];
 
-      z = Child(z, level, k);
+      if (level > 0 && !AccessChild(z, level, k, &z))
+        return false;
       z += p/div_level*k + q/div_level;
 
       p %= div_level, q %= div_level;
@@ -121,17 +181,57 @@ class base_hybrid {
     return CheckLeafChild(z, child);
   }
 
+  /**
+   * Checks a batch of pairs at once. Instead of walking from the root to the
+   * leaves one pair at a time, all pairs are advanced one level before moving
+   * to the next one, so the memory accesses of independent pairs overlap and
+   * the arity and divider of each level are loaded once per batch.
+   *
+   * @param begin Pointer to the first pair (p, q).
+   * @param end Pointer past the last pair.
+   * @param out Array with room for end - begin values. After return out[i]
+   * is true if exists a link between the objects of the i-th pair.
+   */
+  void CheckLinks(const std::pair<cnt_size, cnt_size> *begin,
+                  const std::pair<cnt_size, cnt_size> *end,
+                  bool *out) const {
+    while (begin < end) {
+      size_t cnt = (size_t) (end - begin);
+      if (cnt > kCheckBatch)
+        cnt = kCheckBatch;
+      CheckBatch(begin, cnt, out);
+      begin += cnt;
+      out += cnt;
+    }
+  }
+
   /**
    * Iterates over all links in the given row.
    *
    * @param p Row in the matrix.
    * @param fun Pointer to function, functor or lambda to be called for each
    * object q such that p is related to q.
-   * The function expects a unique parameter of type cnt_size.
+   * The function expects a unique parameter of type cnt_size. If it returns
+   * false the traversal stops.
    */
   template<class Function>
   void DirectLinks(cnt_size p, Function fun) const {
-    Links<Function, DirectImpl>(p, fun);
+    QueryContext ctx;
+    Links<Function, DirectImpl>(p, fun, &ctx);
+  }
+
+  /**
+   * Iterates over all links in the given row using the specified context to
+   * store the traversal state.
+   *
+   * @param p Row in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * object q such that p is related to q.
+   * @param ctx Context not used by any other running query.
+   */
+  template<class Function>
+  void DirectLinks(cnt_size p, Function fun, QueryContext *ctx) const {
+    Links<Function, DirectImpl>(p, fun, ctx);
   }
 
   /**
@@ -140,11 +240,97 @@ class base_hybrid {
    * @param q Column in the matrix.
    * @param fun Pointer to function, functor or lambda to be called for each 
    * object p such that p is related to q.
-   * The function expects a unique parameter of type cnt_size.
+   * The function expects a unique parameter of type cnt_size. If it returns
+   * false the traversal stops.
    */
   template<class Function>
   void InverseLinks(cnt_size q, Function fun) const {
-    Links<Function, InverseImpl>(q, fun);
+    QueryContext ctx;
+    Links<Function, InverseImpl>(q, fun, &ctx);
+  }
+
+  /**
+   * Iterates over all links in the given column using the specified context
+   * to store the traversal state.
+   *
+   * @param q Column in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * object p such that p is related to q.
+   * @param ctx Context not used by any other running query.
+   */
+  template<class Function>
+  void InverseLinks(cnt_size q, Function fun, QueryContext *ctx) const {
+    Links<Function, InverseImpl>(q, fun, ctx);
+  }
+
+  /**
+   * Iterates over all links in the given rows. The nodes shared by several
+   * rows are traversed only once.
+   *
+   * @param begin Pointer to the first row. Rows must be sorted.
+   * @param end Pointer past the last row.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * pair of objects (p,q) such that p is one of the rows and p is related
+   * to q. The function expects two parameters of type cnt_size. If it
+   * returns false the traversal stops.
+   */
+  template<class Function>
+  void DirectLinks(const cnt_size *begin, const cnt_size *end,
+                   Function fun) const {
+    QueryContext ctx;
+    MultiLinks<Function, DirectImpl>(begin, end, fun, &ctx);
+  }
+
+  /**
+   * Iterates over all links in the given rows using the specified context to
+   * store the traversal state.
+   *
+   * @param begin Pointer to the first row. Rows must be sorted.
+   * @param end Pointer past the last row.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * pair of objects (p,q) such that p is one of the rows and p is related
+   * to q.
+   * @param ctx Context not used by any other running query.
+   */
+  template<class Function>
+  void DirectLinks(const cnt_size *begin, const cnt_size *end,
+                   Function fun, QueryContext *ctx) const {
+    MultiLinks<Function, DirectImpl>(begin, end, fun, ctx);
+  }
+
+  /**
+   * Iterates over all links in the given columns. The nodes shared by
+   * several columns are traversed only once.
+   *
+   * @param begin Pointer to the first column. Columns must be sorted.
+   * @param end Pointer past the last column.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * pair of objects (p,q) such that q is one of the columns and p is related
+   * to q. The function expects two parameters of type cnt_size. If it
+   * returns false the traversal stops.
+   */
+  template<class Function>
+  void InverseLinks(const cnt_size *begin, const cnt_size *end,
+                    Function fun) const {
+    QueryContext ctx;
+    MultiLinks<Function, InverseImpl>(begin, end, fun, &ctx);
+  }
+
+  /**
+   * Iterates over all links in the given columns using the specified context
+   * to store the traversal state.
+   *
+   * @param begin Pointer to the first column. Columns must be sorted.
+   * @param end Pointer past the last column.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * pair of objects (p,q) such that q is one of the columns and p is related
+   * to q.
+   * @param ctx Context not used by any other running query.
+   */
+  template<class Function>
+  void InverseLinks(const cnt_size *begin, const cnt_size *end,
+                    Function fun, QueryContext *ctx) const {
+    MultiLinks<Function, InverseImpl>(begin, end, fun, ctx);
   }
 
   /**
@@ -157,61 +343,266 @@ class base_hybrid {
    * @param fun Pointer to function, functor or lambda to be called for each 
    * pair of objects (p,q) such that p is related to q and (p,q) lies inside
    * the specified submatrix. The function expects two parameters of type
-   * cnt_size.
+   * cnt_size. If it returns false the traversal stops.
    */
   template<class Function>
   void RangeQuery(cnt_size p1, cnt_size p2,
                   cnt_size q1, cnt_size q2,
                   Function fun) const {
-    assert(p1 <= p2 && q1 <= q2);
+    QueryContext ctx;
+    RangeQuery(p1, p2, q1, q2, fun, &ctx);
+  }
 
-    Divider<cnt_size> div_level;
-    cnt_size div_p1, rem_p1, div_p2, rem_p2;
-    cnt_size div_q1, rem_q1, div_q2, rem_q2;
-    cnt_size dp, dq;
-    // queue<RangeFrame> range_queue;
-    range_queue.clear();
+  /**
+   * Iterates over all links in the specified submatrix traversing the tree
+   * in the given order.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * pair of objects (p,q) such that p is related to q and (p,q) lies inside
+   * the specified submatrix.
+   * @param traversal Order in which the tree is traversed.
+   */
+  template<class Function>
+  void RangeQuery(cnt_size p1, cnt_size p2,
+                  cnt_size q1, cnt_size q2,
+                  Function fun, Traversal traversal) const {
+    QueryContext ctx;
+    RangeQuery(p1, p2, q1, q2, fun, &ctx, traversal);
+  }
 
-    range_queue.push({p1, p2, q1, q2, 0, 0, 0});
-    uint level;
-    for (level = 0; level < height_-1; ++level) {
-      uint k = GetK(level);
-      div_level = div_level_[level];
+  /**
+   * Iterates over all links in the specified submatrix using the specified
+   * context to store the traversal state.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * pair of objects (p,q) such that p is related to q and (p,q) lies inside
+   * the specified submatrix.
+   * @param ctx Context not used by any other running query.
+   * @param traversal Order in which the tree is traversed.
+   */
+  template<class Function>
+  void RangeQuery(cnt_size p1, cnt_size p2,
+                  cnt_size q1, cnt_size q2,
+                  Function fun, QueryContext *ctx,
+                  Traversal traversal = kBreadthFirst) const {
+    assert(p1 <= p2 && q1 <= q2);
+    if (traversal == kDepthFirst) {
+      RangeDepthFirst(p1, p2, q1, q2, fun, ctx);
+      return;
+    }
+    RangeFrontier(p1, p2, q1, q2, ctx);
 
-      uint cnt_level = (uint) range_queue.size();
-      for (uint q = 0; q < cnt_level; ++q) {
-        const RangeFrame &f = range_queue.front();
-        size_t first = Child(f.z, level, k);
+    ArrayQueue<RangeFrame> &range_queue = ctx->range_queue;
+    Divider<cnt_size> div_level = div_level_[height_ - 1];
+    bool stop = false;
+    auto visit = [&] (cnt_size p, cnt_size q) {
+      if (!stop)
+        stop = !utils::Visit(fun, p, q);
+    };
+    uint cnt_level = (uint) range_queue.size();
+    for (uint q = 0; q < cnt_level && !stop; ++q) {
+      const RangeFrame &f = range_queue.front();
+      RangeLeafBits(f, div_level, visit);
+      range_queue.pop();
+    }
+  }
 
-        div_p1 = f.p1/div_level, rem_p1= f.p1%div_level;
-        div_p2 = f.p2/div_level, rem_p2 = f.p2%div_level;
-        for (cnt_size i = div_p1; i <= div_p2; ++i) {
-          size_t z = first + k*i;
-          dp = f.dp + (cnt_size) div_level*i;
-          p1 = i == div_p1 ? rem_p1 : 0;
-          p2 = i == div_p2 ? rem_p2 : (cnt_size) div_level - 1;
+  /**
+   * Counts the links in the specified submatrix. Leaves are not enumerated,
+   * the ones of each leaf in the submatrix are counted with a popcount.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   *
+   * @return Number of pairs (p,q) inside the submatrix that are related.
+   */
+  size_t RangeCount(cnt_size p1, cnt_size p2,
+                    cnt_size q1, cnt_size q2) const {
+    QueryContext ctx;
+    return RangeCount(p1, p2, q1, q2, &ctx);
+  }
 
-          div_q1 = f.q1/div_level, rem_q1 = f.q1%div_level;
-          div_q2 = f.q2/div_level, rem_q2 = f.q2%div_level;
-          for (cnt_size j = div_q1; j <= div_q2; ++j) {
-            dq = f.dq + (cnt_size) div_level*j;
-            q1 = j == div_q1 ? rem_q1 : 0;
-            q2 = j == div_q2 ? rem_q2 : (cnt_size) div_level-1;
-            if (T_->Access(z+j))
-              range_queue.push({p1, p2, q1, q2, dp, dq, z + j});
-          }
-        }
-        range_queue.pop();
-      }
-    }
+  /**
+   * Counts the links in the specified submatrix using the specified context
+   * to store the traversal state.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param ctx Context not used by any other running query.
+   *
+   * @return Number of pairs (p,q) inside the submatrix that are related.
+   */
+  size_t RangeCount(cnt_size p1, cnt_size p2,
+                    cnt_size q1, cnt_size q2, QueryContext *ctx) const {
+    assert(p1 <= p2 && q1 <= q2);
+    if (p1 == 0 && q1 == 0 && p2 >= cnt_ - 1 && q2 >= cnt_ - 1)
+      return links_;
+    RangeFrontier(p1, p2, q1, q2, ctx);
 
-    div_level = div_level_[height_ - 1];
+    ArrayQueue<RangeFrame> &range_queue = ctx->range_queue;
+    Divider<cnt_size> div_level = div_level_[height_ - 1];
+    size_t cnt = 0;
     uint cnt_level = (uint) range_queue.size();
     for (uint q = 0; q < cnt_level; ++q) {
-      const RangeFrame &f = range_queue.front();
-      RangeLeafBits(f, div_level, fun);
+      cnt += CountLeafBits(range_queue.front(), div_level);
       range_queue.pop();
     }
+    return cnt;
+  }
+
+  /**
+   * Returns the number of objects related to p, ie, the number of ones in
+   * the row p.
+   *
+   * @param p Row in the matrix.
+   * @return Out-degree of p.
+   */
+  size_t OutDegree(cnt_size p) const {
+    QueryContext ctx;
+    return RangeCount(p, p, 0, size_ - 1, &ctx);
+  }
+
+  /**
+   * Returns the number of objects related to p using the specified context
+   * to store the traversal state.
+   *
+   * @param p Row in the matrix.
+   * @param ctx Context not used by any other running query.
+   * @return Out-degree of p.
+   */
+  size_t OutDegree(cnt_size p, QueryContext *ctx) const {
+    return RangeCount(p, p, 0, size_ - 1, ctx);
+  }
+
+  /**
+   * Returns the number of objects related to q, ie, the number of ones in
+   * the column q.
+   *
+   * @param q Column in the matrix.
+   * @return In-degree of q.
+   */
+  size_t InDegree(cnt_size q) const {
+    QueryContext ctx;
+    return RangeCount(0, size_ - 1, q, q, &ctx);
+  }
+
+  /**
+   * Returns the number of objects related to q using the specified context
+   * to store the traversal state.
+   *
+   * @param q Column in the matrix.
+   * @param ctx Context not used by any other running query.
+   * @return In-degree of q.
+   */
+  size_t InDegree(cnt_size q, QueryContext *ctx) const {
+    return RangeCount(0, size_ - 1, q, q, ctx);
+  }
+
+  /**
+   * Checks if there is at least one link in the specified submatrix. The
+   * tree is traversed depth first and the traversal stops at the first link
+   * found, so the cost depends on the height of the tree and not on the
+   * number of links in the submatrix.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   *
+   * @return True if some pair (p,q) inside the submatrix is related.
+   */
+  bool RangeExists(cnt_size p1, cnt_size p2, cnt_size q1, cnt_size q2) const {
+    QueryContext ctx;
+    return RangeExists(p1, p2, q1, q2, &ctx);
+  }
+
+  /**
+   * Checks if there is at least one link in the specified submatrix using
+   * the specified context to store the traversal state.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param ctx Context not used by any other running query.
+   *
+   * @return True if some pair (p,q) inside the submatrix is related.
+   */
+  bool RangeExists(cnt_size p1, cnt_size p2, cnt_size q1, cnt_size q2,
+                   QueryContext *ctx) const {
+    assert(p1 <= p2 && q1 <= q2);
+    bool found = false;
+    auto visit = [&] (cnt_size, cnt_size) {
+      found = true;
+      return false;
+    };
+    RangeDepthFirst(p1, p2, q1, q2, visit, ctx);
+    return found;
+  }
+
+  /**
+   * Iterates over the first links in the specified submatrix. The tree is
+   * traversed depth first, so links are reported in the order of the leaves
+   * of the tree (Z-order) and the traversal stops after the k-th link.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param k Maximum number of links to report.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * of the reported links. The function expects two parameters of type
+   * cnt_size.
+   *
+   * @return Number of links reported.
+   */
+  template<class Function>
+  size_t RangeFirstK(cnt_size p1, cnt_size p2, cnt_size q1, cnt_size q2,
+                     size_t k, Function fun) const {
+    QueryContext ctx;
+    return RangeFirstK(p1, p2, q1, q2, k, fun, &ctx);
+  }
+
+  /**
+   * Iterates over the first links in the specified submatrix using the
+   * specified context to store the traversal state.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param k Maximum number of links to report.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * of the reported links.
+   * @param ctx Context not used by any other running query.
+   *
+   * @return Number of links reported.
+   */
+  template<class Function>
+  size_t RangeFirstK(cnt_size p1, cnt_size p2, cnt_size q1, cnt_size q2,
+                     size_t k, Function fun, QueryContext *ctx) const {
+    assert(p1 <= p2 && q1 <= q2);
+    size_t cnt = 0;
+    if (k == 0)
+      return cnt;
+    auto visit = [&] (cnt_size p, cnt_size q) {
+      fun(p, q);
+      return ++cnt < k;
+    };
+    RangeDepthFirst(p1, p2, q1, q2, visit, ctx);
+    return cnt;
   }
 
   /**
@@ -232,6 +623,27 @@ class base_hybrid {
     return z + offset_[level+1] + i;
   }
 
+  /**
+   * Checks if the specified node is 1 and, in that case, returns the
+   * position of its first child. It is equivalent to an access followed by
+   * Child, but reads T only once.
+   *
+   * @param z Position in T of the node.
+   * @param level Level of the node between 1 and height_ - 1.
+   * @param k Level arity.
+   * @param child Pointer to store the position of the first child.
+   *
+   * @return True if the node is 1, false otherwise.
+   */
+  inline bool AccessChild(size_t z, uint level, uint k, size_t *child) const {
+    assert(level > 0 && level < height_);
+    size_t rank;
+    if (!T_->AccessRank(z, &rank))
+      return false;
+    *child = (rank - acum_rank_[level-1])*k*k + offset_[level+1];
+    return true;
+  }
+
   /**
    * Gets the value of k in the given level.
    *
@@ -257,7 +669,7 @@ class base_hybrid {
     size += sizeof(size_t);
     size += sizeof(size_t*) + height_*sizeof(size_t);
     size += sizeof(size_t*) + (height_+1)*sizeof(size_t);
-    size += T_->GetSize() + sizeof(std::shared_ptr<BitSequence>);
+    size += T_->GetSize() + sizeof(std::shared_ptr<RankBitArray>);
     return size;
   }
 
@@ -286,14 +698,12 @@ class base_hybrid {
   /** Starting position in T of each level. */
   size_t *offset_;
   /** Bit array with rank capability containing internal nodes. */
-  std::shared_ptr<BitSequence> T_;
-
-
-
-  /** Queue to traverse the tree in a range query */
-  static ArrayQueue<RangeFrame> range_queue;
-  /** Queue to traverse the tree */
-  static ArrayQueue<Frame> neighbors_queue;
+  std::shared_ptr<RankBitArray> T_;
+  /**
+   * Mapped file holding the arrays of the leaves when the tree was loaded
+   * from one, so it remains mapped while the tree exists.
+   */
+  std::shared_ptr<MappedFile> file_;
 
   /** 
    * Builds an empty tree
@@ -315,7 +725,7 @@ class base_hybrid {
    * @param cnt Number of object in the original matrix.
    * @param size Size of the expanded matrix.
    */
-  base_hybrid(std::shared_ptr<BitSequence> T,
+  base_hybrid(std::shared_ptr<RankBitArray> T,
               uint k1, uint k2, uint kL, uint max_level_k1, uint height,
               cnt_size cnt, cnt_size size, size_t links)
       : k1_(k1),
@@ -355,9 +765,18 @@ class base_hybrid {
               uint k1, uint k2, uint kl, uint max_level_k1, uint height,
               cnt_size cnt, cnt_size size, size_t links)
       : base_hybrid(
-            std::shared_ptr<BitSequence>(
-                new BitSequenceOneLevelRank(T.GetCDSArray(), 20)
-            ),
+            std::shared_ptr<RankBitArray>(new RankBitArray(T)),
+            k1, k2, kl, max_level_k1, height, cnt, size, links) {}
+
+  /*
+   * Releases T as soon as it is copied into the rank structure.
+   */
+  base_hybrid(BitArray<uint> &&T,
+              uint k1, uint k2, uint kl, uint max_level_k1, uint height,
+              cnt_size cnt, cnt_size size, size_t links)
+      : base_hybrid(
+            std::shared_ptr<RankBitArray>(
+                new RankBitArray(BitArray<uint>(std::move(T)))),
             k1, k2, kl, max_level_k1, height, cnt, size, links) {}
 
   explicit base_hybrid(ifstream *in)
@@ -372,7 +791,36 @@ class base_hybrid {
         div_level_(LoadValue<Divider<cnt_size>>(in, height_)),
         acum_rank_(LoadValue<size_t>(in, height_-1)),
         offset_(LoadValue<size_t>(in, height_+1)),
-        T_(BitSequence::Load(*in)) {}
+        T_(new RankBitArray(in)) {}
+
+  base_hybrid(ifstream *in, utils::LegacyFormat legacy)
+      : k1_(LoadValue<uint>(in)),
+        k2_(LoadValue<uint>(in)),
+        kL_(LoadValue<uint>(in)),
+        max_level_k1_(LoadValue<uint>(in)),
+        height_(LoadValue<uint>(in)),
+        cnt_(LoadValue<cnt_size>(in)),
+        size_(LoadValue<cnt_size>(in)),
+        links_(LoadValue<size_t>(in)),
+        div_level_(LoadValue<Divider<cnt_size>>(in, height_)),
+        acum_rank_(LoadValue<size_t>(in, height_-1)),
+        offset_(LoadValue<size_t>(in, height_+1)),
+        T_(new RankBitArray(in, legacy)) {}
+
+  explicit base_hybrid(MappedReader *in)
+      : k1_(LoadValue<uint>(in)),
+        k2_(LoadValue<uint>(in)),
+        kL_(LoadValue<uint>(in)),
+        max_level_k1_(LoadValue<uint>(in)),
+        height_(LoadValue<uint>(in)),
+        cnt_(LoadValue<cnt_size>(in)),
+        size_(LoadValue<cnt_size>(in)),
+        links_(LoadValue<size_t>(in)),
+        div_level_(LoadValue<Divider<cnt_size>>(in, height_)),
+        acum_rank_(LoadValue<size_t>(in, height_-1)),
+        offset_(LoadValue<size_t>(in, height_+1)),
+        T_(new RankBitArray(in)),
+        file_(in->file()) {}
 
   /**
    * Save the information into a file.
@@ -390,7 +838,7 @@ class base_hybrid {
     SaveValue(out, div_level_, height_);
     SaveValue(out, acum_rank_, height_-1);
     SaveValue(out, offset_, height_+1);
-    T_->Save(*out);
+    T_->Save(out);
   }
 
 
@@ -408,6 +856,27 @@ class base_hybrid {
   }
 
 
+  /**
+   * Reports the children that are 1 in the row (or column) of the given frame
+   * for a leaf stored in a single word. The line is extracted from the word
+   * and its bits are iterated with ctz. Concrete hybrid k2trees use it when
+   * kL is at most utils::kMaxWordArity.
+   *
+   * @param word Children of the leaf row by row, the first in the lowest bit.
+   * @param f Frame containing the information required.
+   * @param fun Function to call for every child that is 1.
+   */
+  template<class Function, class Impl>
+  void WordLeafBits(uint64_t word, const Frame &f,
+                    Divider<cnt_size> div_level, Function &fun) const {
+    uint64_t line = Impl::Line(word, Impl::Offset(f, kL_, div_level), kL_);
+    while (line) {
+      uint j = (uint) __builtin_ctzll(line);
+      line &= line - 1;
+      fun(Impl::Output(Impl::NextFrame(f.p, f.q, 0, j, div_level)));
+    }
+  }
+
   /**
    * Checks a child of the given node in the leaf level. This functionality
    * is delegated and must be implemented by a concrete hybrid k2tree.
@@ -422,19 +891,141 @@ class base_hybrid {
   }
 
 
+  /** Number of pairs advanced together by CheckLinks. */
+  static const size_t kCheckBatch = 256;
+
+  /**
+   * Checks up to kCheckBatch pairs level by level. Pairs are dropped from
+   * the batch as soon as they reach a node that is 0.
+   *
+   * @param pairs Pointer to the first pair.
+   * @param cnt Number of pairs.
+   * @param out Array to store the result of each pair.
+   */
+  void CheckBatch(const std::pair<cnt_size, cnt_size> *pairs, size_t cnt,
+                  bool *out) const {
+    size_t z[kCheckBatch];
+    cnt_size p[kCheckBatch], q[kCheckBatch];
+    // Position in the batch of the pairs still being checked.
+    uint alive[kCheckBatch];
+    size_t cnt_alive = cnt;
+
+    for (size_t i = 0; i < cnt; ++i) {
+      p[i] = pairs[i].first;
+      q[i] = pairs[i].second;
+      z[i] = 0;
+      alive[i] = (uint) i;
+      out[i] = false;
+    }
+
+    for (uint level = 0; level < height_ - 1; ++level) {
+      uint k = GetK(level);
+      Divider<cnt_size> div_level = div_level_[level];
+      // The first child of the root is at position 0, which is the initial
+      // value of z.
+      if (level > 0)
+        cnt_alive = Descend(z, alive, cnt_alive, level, k);
+
+      for (size_t a = 0; a < cnt_alive; ++a) {
+        uint i = alive[a];
+        z[i] += p[i]/div_level*k + q[i]/div_level;
+        p[i] %= div_level, q[i] %= div_level;
+      }
+    }
+    cnt_alive = FilterAlive(z, alive, cnt_alive);
+
+    Divider<cnt_size> div_level = div_level_[height_ - 1];
+    for (size_t a = 0; a < cnt_alive; ++a) {
+      uint i = alive[a];
+      uint child = (uint) (p[i]/div_level*kL_ + q[i]/div_level);
+      out[i] = CheckLeafChild(z[i], child);
+    }
+  }
+
+  /**
+   * Removes from alive the pairs whose current node is 0.
+   *
+   * @param z Current node of each pair in the batch.
+   * @param alive Positions of the pairs being checked.
+   * @param cnt_alive Number of positions in alive.
+   * @return Number of positions remaining in alive.
+   */
+  size_t FilterAlive(const size_t *z, uint *alive, size_t cnt_alive) const {
+    for (size_t a = 0; a < cnt_alive; ++a)
+      T_->Prefetch(z[alive[a]]);
+
+    size_t remaining = 0;
+    for (size_t a = 0; a < cnt_alive; ++a) {
+      if (T_->Access(z[alive[a]]))
+        alive[remaining++] = alive[a];
+    }
+    return remaining;
+  }
+
+  /**
+   * Moves every pair in alive to the first child of its current node and
+   * removes the pairs whose current node is 0. The lines of T holding the
+   * nodes are requested up front, so their misses overlap instead of being
+   * paid one after the other.
+   *
+   * @param z Current node of each pair in the batch, replaced by its first
+   * child.
+   * @param alive Positions of the pairs being checked.
+   * @param cnt_alive Number of positions in alive.
+   * @param level Level of the current nodes.
+   * @param k Arity of the level.
+   * @return Number of positions remaining in alive.
+   */
+  size_t Descend(size_t *z, uint *alive, size_t cnt_alive,
+                 uint level, uint k) const {
+    for (size_t a = 0; a < cnt_alive; ++a)
+      T_->Prefetch(z[alive[a]]);
+
+    size_t remaining = 0;
+    for (size_t a = 0; a < cnt_alive; ++a) {
+      uint i = alive[a];
+      if (AccessChild(z[i], level, k, &z[i]))
+        alive[remaining++] = i;
+    }
+    return remaining;
+  }
+
+  /**
+   * Returns the number of frames a traversal queue should be able to hold
+   * before starting a query. The frontier of a level grows by a factor of at
+   * most k (k<sup>2</sup> in a range query) per level, so a queue of this
+   * size accommodates the first levels without growing. Deeper frontiers
+   * are bounded by the number of nodes actually reached and the queue grows
+   * on demand.
+   *
+   * @param range Whether the traversal is for a range query.
+   * @return Suggested capacity.
+   */
+  size_t FrontierHint(bool range) const {
+    const size_t kMaxHint = 4096;
+    size_t hint = 1;
+    for (uint level = 0; level < height_ - 1 && hint < kMaxHint; ++level) {
+      uint k = GetK(level);
+      hint *= range ? k*k : k;
+    }
+    return std::min(hint, kMaxHint);
+  }
+
   /**
    * Template implementation for DirectLinks and InverseLinks
    *
    * @param object
    * @param fun 
+   * @param ctx Context to store the traversal state.
    */
   template<class Function, class Impl>
-  void Links(cnt_size object, Function fun) const {
+  void Links(cnt_size object, Function fun, QueryContext *ctx) const {
     Divider<cnt_size> div_level;
     uint cnt_level;
     uint k, level;
-    // queue<Frame> neighbors_queue;
+    ArrayQueue<Frame> &neighbors_queue = ctx->neighbors_queue;
     neighbors_queue.clear();
+    neighbors_queue.reserve(FrontierHint(false));
 
     neighbors_queue.push(Impl::FirstFrame(object));
     for (level = 0; level < height_ - 1; ++level) {
@@ -443,7 +1034,8 @@ class base_hybrid {
 
       cnt_level = (uint) neighbors_queue.size();
       for (uint i = 0; i < cnt_level; ++i) {
-        const Frame &f = neighbors_queue.front();
+        // Copy the frame, pushing may move the elements of the queue.
+        const Frame f = neighbors_queue.front();
         size_t z = Child(f.z, level, k) + Impl::Offset(f, k, div_level);
         for (uint j = 0; j < k; ++j) {
           if (T_->Access(z))
@@ -455,13 +1047,235 @@ class base_hybrid {
     }
 
     div_level = div_level_[height_ - 1];
+    bool stop = false;
+    auto visit = [&] (cnt_size other) {
+      if (!stop)
+        stop = !utils::Visit(fun, other);
+    };
     cnt_level = (uint) neighbors_queue.size();
-    for (uint i = 0; i < cnt_level; ++i) {
+    for (uint i = 0; i < cnt_level && !stop; ++i) {
       Frame &f = neighbors_queue.front();
-      LeafBits<Function, Impl>(f, div_level, fun);
+      LeafBits<decltype(visit), Impl>(f, div_level, visit);
       neighbors_queue.pop();
     }
   }
+
+  /**
+   * Template implementation for DirectLinks and InverseLinks over several
+   * objects. Each frame holds the group of objects crossing the node, so
+   * the nodes shared by several objects are visited once.
+   *
+   * @param begin Pointer to the first object. Objects must be sorted.
+   * @param end Pointer past the last object.
+   * @param fun Function receiving each pair (p, q).
+   * @param ctx Context to store the traversal state.
+   */
+  template<class Function, class Impl>
+  void MultiLinks(const cnt_size *begin, const cnt_size *end,
+                  Function fun, QueryContext *ctx) const {
+    assert(std::is_sorted(begin, end));
+    if (begin == end)
+      return;
+
+    Divider<cnt_size> div_level;
+    uint cnt_level;
+    uint k, level;
+    ArrayQueue<MultiFrame> &multi_queue = ctx->multi_queue;
+    multi_queue.clear();
+    multi_queue.reserve(FrontierHint(false));
+
+    multi_queue.push({0, (size_t) (end - begin), 0, 0, 0});
+    for (level = 0; level < height_ - 1; ++level) {
+      k = GetK(level);
+      div_level = div_level_[level];
+
+      cnt_level = (uint) multi_queue.size();
+      for (uint i = 0; i < cnt_level; ++i) {
+        // Copy the frame, pushing may move the elements of the queue.
+        const MultiFrame f = multi_queue.front();
+        size_t first = Child(f.z, level, k);
+
+        // Objects are sorted, so the objects crossing each child are
+        // contiguous.
+        size_t lo = f.lo;
+        while (lo < f.hi) {
+          cnt_size d = (begin[lo] - f.base)/div_level;
+          size_t hi = lo + 1;
+          while (hi < f.hi && (begin[hi] - f.base)/div_level == d)
+            ++hi;
+
+          cnt_size base = f.base + (cnt_size) div_level*d;
+          size_t z = first + Impl::ChildOffset(d, k);
+          for (uint j = 0; j < k; ++j) {
+            if (T_->Access(z))
+              multi_queue.push({lo, hi, base,
+                                f.other + (cnt_size) div_level*j, z});
+            z = Impl::NextChild(z, k);
+          }
+          lo = hi;
+        }
+        multi_queue.pop();
+      }
+    }
+
+    div_level = div_level_[height_ - 1];
+    bool stop = false;
+    cnt_level = (uint) multi_queue.size();
+    for (uint i = 0; i < cnt_level && !stop; ++i) {
+      const MultiFrame &f = multi_queue.front();
+      for (size_t o = f.lo; o < f.hi && !stop; ++o) {
+        cnt_size object = begin[o];
+        Frame leaf = Impl::MakeFrame(object - f.base, f.other, f.z);
+        auto report = [&] (cnt_size other) {
+          if (!stop)
+            stop = !Impl::Report(fun, object, other);
+        };
+        LeafBits<decltype(report), Impl>(leaf, div_level, report);
+      }
+      multi_queue.pop();
+    }
+  }
+
+  /**
+   * Traverses the internal levels of the tree leaving in the range queue
+   * of the context the nodes in the leaf level that intersect the given
+   * submatrix.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param ctx Context to store the traversal state.
+   */
+  void RangeFrontier(cnt_size p1, cnt_size p2,
+                     cnt_size q1, cnt_size q2, QueryContext *ctx) const {
+    Divider<cnt_size> div_level;
+    cnt_size div_p1, rem_p1, div_p2, rem_p2;
+    cnt_size div_q1, rem_q1, div_q2, rem_q2;
+    cnt_size dp, dq;
+    ArrayQueue<RangeFrame> &range_queue = ctx->range_queue;
+    range_queue.clear();
+    range_queue.reserve(FrontierHint(true));
+
+    range_queue.push({p1, p2, q1, q2, 0, 0, 0});
+    for (uint level = 0; level < height_-1; ++level) {
+      uint k = GetK(level);
+      div_level = div_level_[level];
+
+      uint cnt_level = (uint) range_queue.size();
+      for (uint q = 0; q < cnt_level; ++q) {
+        // Copy the frame, pushing may move the elements of the queue.
+        const RangeFrame f = range_queue.front();
+        size_t first = Child(f.z, level, k);
+
+        div_p1 = f.p1/div_level, rem_p1= f.p1%div_level;
+        div_p2 = f.p2/div_level, rem_p2 = f.p2%div_level;
+        for (cnt_size i = div_p1; i <= div_p2; ++i) {
+          size_t z = first + k*i;
+          dp = f.dp + (cnt_size) div_level*i;
+          p1 = i == div_p1 ? rem_p1 : 0;
+          p2 = i == div_p2 ? rem_p2 : (cnt_size) div_level - 1;
+
+          div_q1 = f.q1/div_level, rem_q1 = f.q1%div_level;
+          div_q2 = f.q2/div_level, rem_q2 = f.q2%div_level;
+          for (cnt_size j = div_q1; j <= div_q2; ++j) {
+            dq = f.dq + (cnt_size) div_level*j;
+            q1 = j == div_q1 ? rem_q1 : 0;
+            q2 = j == div_q2 ? rem_q2 : (cnt_size) div_level-1;
+            if (T_->Access(z+j))
+              range_queue.push({p1, p2, q1, q2, dp, dq, z + j});
+          }
+        }
+        range_queue.pop();
+      }
+    }
+  }
+
+  /**
+   * Counts the ones in the leaf lying in the range of the given frame. This
+   * functionality is delegated and must be implemented by a concrete hybrid
+   * k2tree.
+   */
+  size_t CountLeafBits(const RangeFrame &f,
+                       Divider<cnt_size> div_level) const {
+    return static_cast<const Hybrid&>(*this).CountLeafBits(f, div_level);
+  }
+
+  /**
+   * Returns the maximum number of frames in the stack of a depth-first
+   * traversal. When a node is popped its children are pushed, so the stack
+   * holds at most the pending children of one node per level.
+   */
+  size_t StackBound() const {
+    size_t bound = 1;
+    for (uint level = 0; level < height_ - 1; ++level)
+      bound += GetK(level)*GetK(level);
+    return bound;
+  }
+
+  /**
+   * Reports the links in the specified submatrix traversing the tree depth
+   * first with an explicit stack. Children are visited in Z-order.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param fun Function receiving each pair (p, q).
+   * @param ctx Context to store the traversal state.
+   * @return False if fun requested to stop, true otherwise.
+   */
+  template<class Function>
+  bool RangeDepthFirst(cnt_size p1, cnt_size p2, cnt_size q1, cnt_size q2,
+                       Function &fun, QueryContext *ctx) const {
+    std::vector<StackFrame> &stack = ctx->range_stack;
+    stack.clear();
+    stack.reserve(StackBound());
+
+    bool stop = false;
+    auto visit = [&] (cnt_size p, cnt_size q) {
+      if (!stop)
+        stop = !utils::Visit(fun, p, q);
+    };
+
+    stack.push_back({{p1, p2, q1, q2, 0, 0, 0}, 0});
+    while (!stack.empty()) {
+      const StackFrame top = stack.back();
+      stack.pop_back();
+      const RangeFrame &f = top.f;
+      uint level = top.level;
+      Divider<cnt_size> div_level = div_level_[level];
+      if (level == height_ - 1) {
+        RangeLeafBits(f, div_level, visit);
+        if (stop)
+          return false;
+        continue;
+      }
+
+      uint k = GetK(level);
+      size_t first = Child(f.z, level, k);
+      cnt_size div_p1 = f.p1/div_level, rem_p1 = f.p1%div_level;
+      cnt_size div_p2 = f.p2/div_level, rem_p2 = f.p2%div_level;
+      cnt_size div_q1 = f.q1/div_level, rem_q1 = f.q1%div_level;
+      cnt_size div_q2 = f.q2/div_level, rem_q2 = f.q2%div_level;
+      // Children are pushed backwards to be popped in Z-order.
+      for (cnt_size i = div_p2 + 1; i-- > div_p1;) {
+        size_t z = first + k*i;
+        cnt_size dp = f.dp + (cnt_size) div_level*i;
+        p1 = i == div_p1 ? rem_p1 : 0;
+        p2 = i == div_p2 ? rem_p2 : (cnt_size) div_level - 1;
+        for (cnt_size j = div_q2 + 1; j-- > div_q1;) {
+          if (!T_->Access(z + j))
+            continue;
+          cnt_size dq = f.dq + (cnt_size) div_level*j;
+          q1 = j == div_q1 ? rem_q1 : 0;
+          q2 = j == div_q2 ? rem_q2 : (cnt_size) div_level - 1;
+          stack.push_back({{p1, p2, q1, q2, dp, dq, z + j}, level + 1});
+        }
+      }
+    }
+    return true;
+  }
 };
 
 
@@ -480,10 +1294,24 @@ struct DirectImpl {
                                 Divider<cnt_size> div_level) {
     return f.p/div_level*k;
   }
+  inline static cnt_size ChildOffset(cnt_size row, uint k) {
+    return row*k;
+  }
+  inline static uint64_t Line(uint64_t word, cnt_size offset, uint k) {
+    return (word >> offset) & ((1ULL << k) - 1);
+  }
 
   inline static cnt_size Output(const Frame &f) {
     return f.q;
   }
+
+  inline static Frame MakeFrame(cnt_size p, cnt_size q, size_t z) {
+    return {p, q, z};
+  }
+  template<class Function>
+  inline static bool Report(Function &fun, cnt_size p, cnt_size q) {
+    return utils::Visit(fun, p, q);
+  }
 };
 
 
@@ -502,16 +1330,24 @@ struct InverseImpl {
                                 Divider<cnt_size> div_level) {
     return f.q/div_level;
   }
+  inline static cnt_size ChildOffset(cnt_size col, uint) {
+    return col;
+  }
+  inline static uint64_t Line(uint64_t word, cnt_size offset, uint k) {
+    return utils::ExtractColumn(word, (uint) offset, k);
+  }
   inline static cnt_size Output(const Frame &f) {
     return f.p;
   }
-};
 
-template<class Hybrid>
-ArrayQueue<RangeFrame> base_hybrid<Hybrid>::range_queue;
-
-template<class Hybrid>
-ArrayQueue<Frame> base_hybrid<Hybrid>::neighbors_queue;
+  inline static Frame MakeFrame(cnt_size q, cnt_size p, size_t z) {
+    return {p, q, z};
+  }
+  template<class Function>
+  inline static bool Report(Function &fun, cnt_size q, cnt_size p) {
+    return utils::Visit(fun, p, q);
+  }
+};
 }  // namespace libk2tree
 
 #endif  // INCLUDE_BASE_BASE_HYBRID_H_
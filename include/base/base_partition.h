@@ -11,9 +11,18 @@
 #define INCLUDE_BASE_BASE_PARTITION_H_
 
 #include <libk2tree_basic.h>
+#include <base/base_hybrid.h>
 #include <utils/utils.h>
+#include <utils/file_format.h>
+#include <utils/lru_cache.h>
+#include <utils/thread_pool.h>
+#include <atomic>
 #include <fstream>
+#include <mutex>
+#include <string>
 #include <vector>
+#include <memory>
+#include <utility>
 
 namespace libk2tree {
 using utils::LoadValue;
@@ -22,9 +31,32 @@ using utils::SaveValue;
 template<class K2Tree>
 class base_partition {
  public:
+  /**
+   * Pointer to a subtree used by a query. When the subtrees are loaded
+   * lazily it keeps the subtree in memory while the pointer lives, even if
+   * it is discarded from the cache.
+   */
+  class SubtreePtr {
+   public:
+    explicit SubtreePtr(const K2Tree *tree) : tree_(tree) {}
+    explicit SubtreePtr(std::shared_ptr<const K2Tree> tree)
+        : tree_(tree.get()),
+          hold_(std::move(tree)) {}
+
+    const K2Tree &operator*() const {
+      return *tree_;
+    }
+    const K2Tree *operator->() const {
+      return tree_;
+    }
 
+   private:
+    const K2Tree *tree_;
+    std::shared_ptr<const K2Tree> hold_;
+  };
 
   /** 
+
    * Checks if exist a link from object p to q.
    *
    * This member function effectively calls member CheckLink of the
@@ -34,8 +66,55 @@ class base_partition {
    * @param q Identifier of second object.
    */
   bool CheckLink(cnt_size p, cnt_size q) const {
-    const K2Tree &t = subtrees_[p/submatrix_size_][q/submatrix_size_];
-    return t.CheckLink(p % submatrix_size_, q % submatrix_size_);
+    SubtreePtr t = GetSubtree(p/submatrix_size_, q/submatrix_size_);
+    return t->CheckLink(p % submatrix_size_, q % submatrix_size_);
+  }
+
+  /**
+   * Checks a batch of pairs at once.
+   *
+   * The pairs are grouped by subtree and each group is checked with member
+   * CheckLinks of the corresponding subtree.
+   *
+   * @param begin Pointer to the first pair (p, q).
+   * @param end Pointer past the last pair.
+   * @param out Array with room for end - begin values. After return out[i]
+   * is true if exists a link between the objects of the i-th pair.
+   */
+  void CheckLinks(const std::pair<cnt_size, cnt_size> *begin,
+                  const std::pair<cnt_size, cnt_size> *end,
+                  bool *out) const {
+    size_t cnt = (size_t) (end - begin);
+    // Counting sort of the pairs by subtree.
+    std::vector<size_t> start(k0_*k0_ + 1, 0);
+    for (size_t i = 0; i < cnt; ++i)
+      ++start[Subtree(begin[i]) + 1];
+    for (size_t t = 0; t < k0_*k0_; ++t)
+      start[t + 1] += start[t];
+
+    std::vector<size_t> order(cnt);
+    std::vector<std::pair<cnt_size, cnt_size>> pairs(cnt);
+    std::vector<size_t> pos(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < cnt; ++i) {
+      size_t j = pos[Subtree(begin[i])]++;
+      order[j] = i;
+      pairs[j] = std::make_pair(begin[i].first % submatrix_size_,
+                                begin[i].second % submatrix_size_);
+    }
+
+    std::unique_ptr<bool[]> res(new bool[cnt]);
+    for (uint row = 0; row < k0_; ++row) {
+      for (uint col = 0; col < k0_; ++col) {
+        size_t t = row*k0_ + col;
+        if (start[t] == start[t + 1])
+          continue;
+        GetSubtree(row, col)->CheckLinks(pairs.data() + start[t],
+                                       pairs.data() + start[t + 1],
+                                       res.get() + start[t]);
+      }
+    }
+    for (size_t j = 0; j < cnt; ++j)
+      out[order[j]] = res[j];
   }
 
   /**
@@ -46,7 +125,7 @@ class base_partition {
     size_t l = 0;
     for (uint i = 0; i < k0_; ++i)
       for (uint j = 0; j < k0_; ++j)
-        l += subtrees_[i][j].links();
+        l += SubtreeLinks(i, j);
     return l;
   }
 
@@ -59,20 +138,38 @@ class base_partition {
    * @param p Row in the matrix.
    * @param fun Pointer to function, functor or lambda to be called for each
    * object related to p.
-   * The function expect a parameter of type cnt_size.
+   * The function expect a parameter of type cnt_size. If it returns false
+   * the traversal stops.
    */
   template<class Function>
   void DirectLinks(cnt_size p, Function fun) const {
+    QueryContext ctx;
+    DirectLinks(p, fun, &ctx);
+  }
+
+  /**
+   * Iterates over all links in the given row using the specified context to
+   * traverse the subtrees.
+   *
+   * @param p Row in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * object related to p.
+   * @param ctx Context not used by any other running query.
+   */
+  template<class Function>
+  void DirectLinks(cnt_size p, Function fun, QueryContext *ctx) const {
     uint row = (uint) (p/submatrix_size_);
-    for (uint col = 0; col < k0_; ++col) {
-      const K2Tree &tree = subtrees_[row][col];
-      tree.DirectLinks(p % submatrix_size_, [=] (cnt_size q) {
-        fun(col*submatrix_size_ + q);
-      });
+    bool stop = false;
+    for (uint col = 0; col < k0_ && !stop; ++col) {
+      SubtreePtr tree = GetSubtree(row, col);
+      tree->DirectLinks(p % submatrix_size_, [&] (cnt_size q) {
+        stop = !utils::Visit(fun, col*submatrix_size_ + q);
+        return !stop;
+      }, ctx);
     }
   }
 
-  /*
+  /**
    * Iterates over all links in the given column.
    *
    * This member function effectively calls member InverseLinks of the
@@ -81,20 +178,157 @@ class base_partition {
    * @param q Column in the matrix.
    * @param fun Pointer to function, functor or lambda to be called for each
    * object related to q.
-   * The function expect a parameter of type cnt_size.
+   * The function expect a parameter of type cnt_size. If it returns false
+   * the traversal stops.
    */
   template<class Function>
   void InverseLinks(cnt_size q, Function fun) const {
+    QueryContext ctx;
+    InverseLinks(q, fun, &ctx);
+  }
+
+  /**
+   * Iterates over all links in the given column using the specified context
+   * to traverse the subtrees.
+   *
+   * @param q Column in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * object related to q.
+   * @param ctx Context not used by any other running query.
+   */
+  template<class Function>
+  void InverseLinks(cnt_size q, Function fun, QueryContext *ctx) const {
     uint col = (uint) (q/submatrix_size_);
-    for (uint row = 0; row < k0_; ++row) {
-      const K2Tree &tree = subtrees_[row][col];
-      tree.InverseLinks(q % submatrix_size_, [=] (cnt_size p) {
-        fun(row*submatrix_size_ + p);
-      });
+    bool stop = false;
+    for (uint row = 0; row < k0_ && !stop; ++row) {
+      SubtreePtr tree = GetSubtree(row, col);
+      tree->InverseLinks(q % submatrix_size_, [&] (cnt_size p) {
+        stop = !utils::Visit(fun, row*submatrix_size_ + p);
+        return !stop;
+      }, ctx);
     }
   }
 
-  /*
+  /**
+   * Iterates over all links in the given row querying the subtrees in
+   * parallel.
+   *
+   * @param p Row in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * object related to p. It is never called concurrently.
+   * @param pool Threads used to query the subtrees.
+   * @param ordered If true the objects are reported in the same order as the
+   * sequential version, otherwise the results of each subtree are reported
+   * as soon as it is done.
+   */
+  template<class Function>
+  void DirectLinks(cnt_size p, Function fun, utils::ThreadPool *pool,
+                   bool ordered = true) const {
+    uint row = (uint) (p/submatrix_size_);
+    Parallel(k0_, pool, ordered, [&] (size_t col, LinkBuffer *out) {
+      GetSubtree(row, col)->DirectLinks(p % submatrix_size_,
+                                        [&] (cnt_size q) {
+        return out->Add(p, col*submatrix_size_ + q);
+      }, &out->ctx);
+    }, [&] (cnt_size, cnt_size q) {
+      return utils::Visit(fun, q);
+    });
+  }
+
+  /**
+   * Iterates over all links in the given column querying the subtrees in
+   * parallel.
+   *
+   * @param q Column in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * object related to q. It is never called concurrently.
+   * @param pool Threads used to query the subtrees.
+   * @param ordered If true the objects are reported in the same order as the
+   * sequential version.
+   */
+  template<class Function>
+  void InverseLinks(cnt_size q, Function fun, utils::ThreadPool *pool,
+                    bool ordered = true) const {
+    uint col = (uint) (q/submatrix_size_);
+    Parallel(k0_, pool, ordered, [&] (size_t row, LinkBuffer *out) {
+      GetSubtree(row, col)->InverseLinks(q % submatrix_size_,
+                                         [&] (cnt_size p) {
+        return out->Add(row*submatrix_size_ + p, q);
+      }, &out->ctx);
+    }, [&] (cnt_size p, cnt_size) {
+      return utils::Visit(fun, p);
+    });
+  }
+
+  /**
+   * Iterates over all links in the given rows.
+   *
+   * This member function effectively calls member DirectLinks over several
+   * rows of the corresponding subtrees.
+   *
+   * @param begin Pointer to the first row. Rows must be sorted.
+   * @param end Pointer past the last row.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * pair of objects (p,q) such that p is one of the rows and p is related
+   * to q.
+   */
+  template<class Function>
+  void DirectLinks(const cnt_size *begin, const cnt_size *end,
+                   Function fun) const {
+    QueryContext ctx;
+    std::vector<cnt_size> objects;
+    bool stop = false;
+    while (begin < end && !stop) {
+      uint row = (uint) (*begin/submatrix_size_);
+      const cnt_size *next = RelativeObjects(begin, end, &objects);
+      for (uint col = 0; col < k0_ && !stop; ++col) {
+        SubtreePtr tree = GetSubtree(row, col);
+        tree->DirectLinks(objects.data(), objects.data() + objects.size(),
+                         [&] (cnt_size p, cnt_size q) {
+          stop = !utils::Visit(fun, row*submatrix_size_ + p,
+                               col*submatrix_size_ + q);
+          return !stop;
+        }, &ctx);
+      }
+      begin = next;
+    }
+  }
+
+  /**
+   * Iterates over all links in the given columns.
+   *
+   * This member function effectively calls member InverseLinks over several
+   * columns of the corresponding subtrees.
+   *
+   * @param begin Pointer to the first column. Columns must be sorted.
+   * @param end Pointer past the last column.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * pair of objects (p,q) such that q is one of the columns and p is related
+   * to q.
+   */
+  template<class Function>
+  void InverseLinks(const cnt_size *begin, const cnt_size *end,
+                    Function fun) const {
+    QueryContext ctx;
+    std::vector<cnt_size> objects;
+    bool stop = false;
+    while (begin < end && !stop) {
+      uint col = (uint) (*begin/submatrix_size_);
+      const cnt_size *next = RelativeObjects(begin, end, &objects);
+      for (uint row = 0; row < k0_ && !stop; ++row) {
+        SubtreePtr tree = GetSubtree(row, col);
+        tree->InverseLinks(objects.data(), objects.data() + objects.size(),
+                          [&] (cnt_size p, cnt_size q) {
+          stop = !utils::Visit(fun, row*submatrix_size_ + p,
+                               col*submatrix_size_ + q);
+          return !stop;
+        }, &ctx);
+      }
+      begin = next;
+    }
+  }
+
+  /**
    * Iterates over all links in the specified submatrix.
    *
    * This member function effectively calls member RangeQuery of the
@@ -105,30 +339,289 @@ class base_partition {
    * @param q1 Starting column in the matrix.
    * @param q2 Ending column in the matrix.
    * @param fun Pointer to function, functor or lambda to be called for each pair
-   * of objects. The function expect two parameters of type cnt_size.
+   * of objects. The function expect two parameters of type cnt_size. If it
+   * returns false the traversal stops.
    */
   template<class Function>
   void RangeQuery(cnt_size p1, cnt_size p2,
                   cnt_size q1, cnt_size q2,
                   Function fun) const {
+    QueryContext ctx;
+    RangeQuery(p1, p2, q1, q2, fun, &ctx);
+  }
+
+  /**
+   * Iterates over all links in the specified submatrix traversing the
+   * subtrees in the given order.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each pair
+   * of objects.
+   * @param traversal Order in which the subtrees are traversed.
+   */
+  template<class Function>
+  void RangeQuery(cnt_size p1, cnt_size p2,
+                  cnt_size q1, cnt_size q2,
+                  Function fun, Traversal traversal) const {
+    QueryContext ctx;
+    RangeQuery(p1, p2, q1, q2, fun, &ctx, traversal);
+  }
+
+  /**
+   * Iterates over all links in the specified submatrix using the specified
+   * context to traverse the subtrees.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each pair
+   * of objects. The function expect two parameters of type cnt_size.
+   * @param ctx Context not used by any other running query.
+   * @param traversal Order in which the subtrees are traversed.
+   */
+  template<class Function>
+  void RangeQuery(cnt_size p1, cnt_size p2,
+                  cnt_size q1, cnt_size q2,
+                  Function fun, QueryContext *ctx,
+                  Traversal traversal = kBreadthFirst) const {
+    cnt_size div_p1 = p1/submatrix_size_, rem_p1 = p1%submatrix_size_;
+    cnt_size div_p2 = p2/submatrix_size_, rem_p2 = p2%submatrix_size_;
+    cnt_size div_q1 = q1/submatrix_size_, rem_q1 = q1%submatrix_size_;
+    cnt_size div_q2 = q2/submatrix_size_, rem_q2 = q2%submatrix_size_;
+
+    bool stop = false;
+    for (cnt_size row = div_p1; row <= div_p2 && !stop; ++row) {
+      p1 = row == div_p1 ? rem_p1 : 0;
+      p2 = row == div_p2 ? rem_p2 : submatrix_size_ - 1;
+      for (cnt_size col = div_q1; col <= div_q2 && !stop; ++col) {
+        q1 = col == div_q1 ? rem_q1 : 0;
+        q2 = col == div_q2 ? rem_q2 : submatrix_size_ - 1;
+
+        SubtreePtr tree = GetSubtree(row, col);
+        tree->RangeQuery(p1, p2, q1, q2, [&] (cnt_size p, cnt_size q) {
+          stop = !utils::Visit(fun, row*submatrix_size_ + p,
+                               col*submatrix_size_ + q);
+          return !stop;
+        }, ctx, traversal);
+      }
+    }
+  }
+
+  /**
+   * Iterates over all links in the specified submatrix querying the
+   * subtrees in parallel.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param fun Pointer to function, functor or lambda to be called for each pair
+   * of objects. It is never called concurrently.
+   * @param pool Threads used to query the subtrees.
+   * @param ordered If true the links are reported in the same order as the
+   * sequential version.
+   */
+  template<class Function>
+  void RangeQuery(cnt_size p1, cnt_size p2,
+                  cnt_size q1, cnt_size q2,
+                  Function fun, utils::ThreadPool *pool,
+                  bool ordered = true) const {
+    cnt_size div_p1 = p1/submatrix_size_, rem_p1 = p1%submatrix_size_;
+    cnt_size div_p2 = p2/submatrix_size_, rem_p2 = p2%submatrix_size_;
+    cnt_size div_q1 = q1/submatrix_size_, rem_q1 = q1%submatrix_size_;
+    cnt_size div_q2 = q2/submatrix_size_, rem_q2 = q2%submatrix_size_;
+    cnt_size cols = div_q2 - div_q1 + 1;
+
+    Parallel((div_p2 - div_p1 + 1)*cols, pool, ordered,
+             [&] (size_t t, LinkBuffer *out) {
+      cnt_size row = div_p1 + t/cols, col = div_q1 + t%cols;
+      cnt_size sp1 = row == div_p1 ? rem_p1 : 0;
+      cnt_size sp2 = row == div_p2 ? rem_p2 : submatrix_size_ - 1;
+      cnt_size sq1 = col == div_q1 ? rem_q1 : 0;
+      cnt_size sq2 = col == div_q2 ? rem_q2 : submatrix_size_ - 1;
+      GetSubtree(row, col)->RangeQuery(sp1, sp2, sq1, sq2,
+                                       [&] (cnt_size p, cnt_size q) {
+        return out->Add(row*submatrix_size_ + p, col*submatrix_size_ + q);
+      }, &out->ctx);
+    }, [&] (cnt_size p, cnt_size q) {
+      return utils::Visit(fun, p, q);
+    });
+  }
+
+  /**
+   * Counts the links in the specified submatrix.
+   *
+   * This member function effectively calls member RangeCount of the
+   * corresponding subtrees.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   */
+  size_t RangeCount(cnt_size p1, cnt_size p2,
+                    cnt_size q1, cnt_size q2) const {
+    QueryContext ctx;
+    return RangeCount(p1, p2, q1, q2, &ctx);
+  }
+
+  /**
+   * Counts the links in the specified submatrix using the specified context
+   * to traverse the subtrees.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param ctx Context not used by any other running query.
+   */
+  size_t RangeCount(cnt_size p1, cnt_size p2,
+                    cnt_size q1, cnt_size q2, QueryContext *ctx) const {
     cnt_size div_p1 = p1/submatrix_size_, rem_p1 = p1%submatrix_size_;
     cnt_size div_p2 = p2/submatrix_size_, rem_p2 = p2%submatrix_size_;
     cnt_size div_q1 = q1/submatrix_size_, rem_q1 = q1%submatrix_size_;
     cnt_size div_q2 = q2/submatrix_size_, rem_q2 = q2%submatrix_size_;
 
+    size_t cnt = 0;
     for (cnt_size row = div_p1; row <= div_p2; ++row) {
       p1 = row == div_p1 ? rem_p1 : 0;
       p2 = row == div_p2 ? rem_p2 : submatrix_size_ - 1;
       for (cnt_size col = div_q1; col <= div_q2; ++col) {
         q1 = col == div_q1 ? rem_q1 : 0;
         q2 = col == div_q2 ? rem_q2 : submatrix_size_ - 1;
+        cnt += GetSubtree(row, col)->RangeCount(p1, p2, q1, q2, ctx);
+      }
+    }
+    return cnt;
+  }
+
+  /**
+   * Returns the number of objects related to p.
+   *
+   * @param p Row in the matrix.
+   */
+  size_t OutDegree(cnt_size p) const {
+    QueryContext ctx;
+    return OutDegree(p, &ctx);
+  }
+
+  /**
+   * Returns the number of objects related to p using the specified context
+   * to traverse the subtrees.
+   *
+   * @param p Row in the matrix.
+   * @param ctx Context not used by any other running query.
+   */
+  size_t OutDegree(cnt_size p, QueryContext *ctx) const {
+    uint row = (uint) (p/submatrix_size_);
+    size_t cnt = 0;
+    for (uint col = 0; col < k0_; ++col)
+      cnt += GetSubtree(row, col)->OutDegree(p % submatrix_size_, ctx);
+    return cnt;
+  }
+
+  /**
+   * Returns the number of objects related to q.
+   *
+   * @param q Column in the matrix.
+   */
+  size_t InDegree(cnt_size q) const {
+    QueryContext ctx;
+    return InDegree(q, &ctx);
+  }
+
+  /**
+   * Returns the number of objects related to q using the specified context
+   * to traverse the subtrees.
+   *
+   * @param q Column in the matrix.
+   * @param ctx Context not used by any other running query.
+   */
+  size_t InDegree(cnt_size q, QueryContext *ctx) const {
+    uint col = (uint) (q/submatrix_size_);
+    size_t cnt = 0;
+    for (uint row = 0; row < k0_; ++row)
+      cnt += GetSubtree(row, col)->InDegree(q % submatrix_size_, ctx);
+    return cnt;
+  }
 
-        const K2Tree &tree = subtrees_[row][col];
-        tree.RangeQuery(p1, p2, q1, q2, [=] (cnt_size p, cnt_size q) {
+  /**
+   * Checks if there is at least one link in the specified submatrix.
+   *
+   * This member function effectively calls member RangeExists of the
+   * corresponding subtrees until one of them returns true.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   */
+  bool RangeExists(cnt_size p1, cnt_size p2, cnt_size q1, cnt_size q2) const {
+    QueryContext ctx;
+    cnt_size div_p1 = p1/submatrix_size_, rem_p1 = p1%submatrix_size_;
+    cnt_size div_p2 = p2/submatrix_size_, rem_p2 = p2%submatrix_size_;
+    cnt_size div_q1 = q1/submatrix_size_, rem_q1 = q1%submatrix_size_;
+    cnt_size div_q2 = q2/submatrix_size_, rem_q2 = q2%submatrix_size_;
+
+    for (cnt_size row = div_p1; row <= div_p2; ++row) {
+      p1 = row == div_p1 ? rem_p1 : 0;
+      p2 = row == div_p2 ? rem_p2 : submatrix_size_ - 1;
+      for (cnt_size col = div_q1; col <= div_q2; ++col) {
+        q1 = col == div_q1 ? rem_q1 : 0;
+        q2 = col == div_q2 ? rem_q2 : submatrix_size_ - 1;
+        if (GetSubtree(row, col)->RangeExists(p1, p2, q1, q2, &ctx))
+          return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Iterates over the first links in the specified submatrix.
+   *
+   * This member function effectively calls member RangeFirstK of the
+   * corresponding subtrees, in row-major order, until k links are reported.
+   *
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   * @param k Maximum number of links to report.
+   * @param fun Pointer to function, functor or lambda to be called for each
+   * of the reported links. The function expect two parameters of type
+   * cnt_size.
+   *
+   * @return Number of links reported.
+   */
+  template<class Function>
+  size_t RangeFirstK(cnt_size p1, cnt_size p2, cnt_size q1, cnt_size q2,
+                     size_t k, Function fun) const {
+    QueryContext ctx;
+    cnt_size div_p1 = p1/submatrix_size_, rem_p1 = p1%submatrix_size_;
+    cnt_size div_p2 = p2/submatrix_size_, rem_p2 = p2%submatrix_size_;
+    cnt_size div_q1 = q1/submatrix_size_, rem_q1 = q1%submatrix_size_;
+    cnt_size div_q2 = q2/submatrix_size_, rem_q2 = q2%submatrix_size_;
+
+    size_t cnt = 0;
+    for (cnt_size row = div_p1; row <= div_p2 && cnt < k; ++row) {
+      p1 = row == div_p1 ? rem_p1 : 0;
+      p2 = row == div_p2 ? rem_p2 : submatrix_size_ - 1;
+      for (cnt_size col = div_q1; col <= div_q2 && cnt < k; ++col) {
+        q1 = col == div_q1 ? rem_q1 : 0;
+        q2 = col == div_q2 ? rem_q2 : submatrix_size_ - 1;
+
+        SubtreePtr tree = GetSubtree(row, col);
+        cnt += tree->RangeFirstK(p1, p2, q1, q2, k - cnt,
+                                [&] (cnt_size p, cnt_size q) {
           fun(row*submatrix_size_ + p, col*submatrix_size_ + q);
-        });
+        }, &ctx);
       }
     }
+    return cnt;
   }
 
   /*
@@ -140,49 +633,293 @@ class base_partition {
 
 
   /* 
-   * Get size in bytes.
+   * Get size in bytes. When the subtrees are loaded lazily only the ones in
+   * memory are counted.
    */
   size_t GetSize() const {
     size_t size = 0;
+    if (cache_) {
+      cache_->ForEachResident([&] (const K2Tree &t) {
+        size += t.GetSize();
+      });
+      return size;
+    }
     for (uint i = 0; i < k0_; ++i)
       for (uint j = 0; j < k0_; ++j)
         size += subtrees_[i][j].GetSize();
     return size;
   }
 
+  /**
+   * Returns the subtree representing a submatrix, loading it if the
+   * subtrees are loaded lazily and it is not in memory.
+   *
+   * @param row Row of the submatrix.
+   * @param col Column of the submatrix.
+   */
+  SubtreePtr GetSubtree(size_t row, size_t col) const {
+    if (cache_)
+      return SubtreePtr(cache_->Get(row*k0_ + col));
+    return SubtreePtr(&subtrees_[row][col]);
+  }
+
+  /**
+   * Returns the number of accesses to a subtree that was in memory. Always 0
+   * if the tree was loaded eagerly.
+   */
+  size_t cache_hits() const {
+    return cache_ ? cache_->hits() : 0;
+  }
+
+  /**
+   * Returns the number of accesses that had to load a subtree. Always 0 if
+   * the tree was loaded eagerly.
+   */
+  size_t cache_misses() const {
+    return cache_ ? cache_->misses() : 0;
+  }
 
-  bool operator==(const base_partition &rhs) {
+  /**
+   * Returns the number of subtrees in memory.
+   */
+  size_t resident_subtrees() const {
+    return cache_ ? cache_->resident() : k0_*k0_;
+  }
+
+
+  bool operator==(const base_partition &rhs) const {
     if (k0_ != rhs.k0_ || cnt_ != rhs.cnt_ ||
         submatrix_size_ != rhs.submatrix_size_)
       return false;
+    if (subtree_links_ != rhs.subtree_links_)
+      return false;
     for (uint i = 0; i < k0_; ++i)
       for (uint j = 0; j < k0_; ++j)
-        if (!(subtrees_[i][j] == rhs.subtrees_[i][j]))
+        if (!(*GetSubtree(i, j) == *rhs.GetSubtree(i, j)))
           return false;
     return true;
   }
 
  protected:
+  /* File read when the subtrees are loaded lazily.*/
+  std::shared_ptr<std::ifstream> stream_;
+  /* Header and sections of the file storing the tree.*/
+  utils::FileLayout layout_;
   /* Returns the number of objects in the relation or matrix.*/
   cnt_size cnt_;
   /* Size of each submatrix represented in the subtrees.*/
   cnt_size submatrix_size_;
   /* Value of k for the firt level, ie, there are k0*k0 subtree.*/
   uint k0_;
-  /* Matrix of subtrees.*/
+  /* Number of links of each subtree in row-major order.*/
+  std::vector<size_t> subtree_links_;
+  /* Matrix of subtrees, empty when they are loaded lazily.*/
   std::vector<std::vector<K2Tree>> subtrees_;
+  /* Subtrees in memory when they are loaded lazily, in row-major order.*/
+  std::shared_ptr<utils::LruCache<K2Tree>> cache_;
 
-  explicit base_partition(std::ifstream *in)
-      : cnt_(LoadValue<cnt_size>(in)),
+  /* Links found by a subtree in a parallel query.*/
+  struct LinkBuffer {
+    explicit LinkBuffer(const std::atomic<bool> *stop) : stop(stop) {}
+
+    /* Stores a link and returns false if the query was stopped.*/
+    bool Add(cnt_size p, cnt_size q) {
+      links.emplace_back(p, q);
+      return !*stop;
+    }
+
+    std::vector<std::pair<cnt_size, cnt_size>> links;
+    QueryContext ctx;
+    const std::atomic<bool> *stop;
+  };
+
+  /*
+   * Runs query(t, &buffer) for each t in [0, tasks) in the pool and reports
+   * the links stored in the buffers calling fun, which returns false to stop
+   * the traversal. If ordered the buffers are reported in order after all
+   * the queries end, otherwise each one is reported when its query ends.
+   */
+  template<class Query, class Function>
+  void Parallel(size_t tasks, utils::ThreadPool *pool, bool ordered,
+                Query query, Function fun) const {
+    std::atomic<bool> stop(false);
+    std::mutex mutex;
+    auto report = [&] (const LinkBuffer &out) {
+      for (const std::pair<cnt_size, cnt_size> &link : out.links) {
+        if (!fun(link.first, link.second)) {
+          stop = true;
+          return;
+        }
+      }
+    };
+
+    if (ordered) {
+      std::vector<LinkBuffer> buffers;
+      buffers.reserve(tasks);
+      for (size_t t = 0; t < tasks; ++t)
+        buffers.emplace_back(&stop);
+      pool->ParallelFor(tasks, [&] (size_t t) {
+        query(t, &buffers[t]);
+      });
+      for (size_t t = 0; t < tasks && !stop; ++t)
+        report(buffers[t]);
+    } else {
+      pool->ParallelFor(tasks, [&] (size_t t) {
+        if (stop)
+          return;
+        LinkBuffer out(&stop);
+        query(t, &out);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!stop)
+          report(out);
+      });
+    }
+  }
+
+  /*
+   * Stores in objects the leading objects of [begin, end) lying in the same
+   * submatrix, relative to the submatrix, and returns a pointer past them.
+   */
+  const cnt_size *RelativeObjects(const cnt_size *begin, const cnt_size *end,
+                                  std::vector<cnt_size> *objects) const {
+    cnt_size div = *begin/submatrix_size_;
+    objects->clear();
+    for (; begin < end && *begin/submatrix_size_ == div; ++begin)
+      objects->push_back(*begin % submatrix_size_);
+    return begin;
+  }
+
+  /* Returns the position in row-major order of the subtree storing a pair.*/
+  size_t Subtree(const std::pair<cnt_size, cnt_size> &pair) const {
+    return pair.first/submatrix_size_*k0_ + pair.second/submatrix_size_;
+  }
+
+  /*
+   * Reads the header of the file and the first section, storing cnt_,
+   * submatrix_size_, k0_ and the number of links of each subtree. The
+   * subtrees are stored in the last k0*k0 sections, starting at section
+   * first.
+   */
+  base_partition(std::ifstream *in, TreeKind kind, uint first)
+      : layout_(in, kind),
+        cnt_(LoadValue<cnt_size>(in)),
+        submatrix_size_(LoadValue<cnt_size>(in)),
+        k0_(LoadValue<uint>(in)),
+        subtrees_(k0_) {
+    CheckSections(first);
+    LoadSubtreeLinks(in);
+  }
+
+  base_partition(MappedReader *in, TreeKind kind, uint first)
+      : layout_(in, kind, false),
+        cnt_(LoadValue<cnt_size>(in)),
         submatrix_size_(LoadValue<cnt_size>(in)),
         k0_(LoadValue<uint>(in)),
         subtrees_(k0_) {
+    CheckSections(first);
+    LoadSubtreeLinks(in);
+  }
+
+  /*
+   * Reads cnt_, submatrix_size_ and k0_ from a file saved before the file
+   * header. The subtrees follow them, without sections.
+   */
+  base_partition(std::ifstream *in, utils::LegacyFormat)
+      : cnt_(LoadValue<cnt_size>(in)),
+        submatrix_size_(LoadValue<cnt_size>(in)),
+        k0_(LoadValue<uint>(in)),
+        subtrees_(k0_) {}
+
+  /*
+   * Opens a file, reading only the header and the first section. The
+   * subtrees must be loaded with LoadLazily.
+   */
+  base_partition(const std::string &path, TreeKind kind, uint first)
+      : stream_(std::make_shared<std::ifstream>(
+            path, std::ifstream::in | std::ifstream::binary)),
+        layout_(stream_.get(), kind, false),
+        cnt_(LoadValue<cnt_size>(stream_.get())),
+        submatrix_size_(LoadValue<cnt_size>(stream_.get())),
+        k0_(LoadValue<uint>(stream_.get())) {
+    CheckSections(first);
+    LoadSubtreeLinks(stream_.get());
+  }
+
+  /*
+   * Loads each subtree from stream_ the first time it is used, keeping at
+   * most capacity of them in memory. The checksum of a subtree is verified
+   * every time it is loaded. Loads of different subtrees share the stream,
+   * so they take turns.
+   *
+   * @param first Section of the first subtree.
+   * @param capacity Maximum number of subtrees in memory.
+   * @param load Function expecting the stream at the beginning of a subtree
+   * and returning a shared pointer to it.
+   */
+  template<class Function>
+  void LoadLazily(uint first, size_t capacity, Function load) {
+    std::shared_ptr<std::ifstream> in = stream_;
+    std::shared_ptr<std::mutex> mutex = std::make_shared<std::mutex>();
+    utils::FileLayout layout = layout_;
+    cache_ = std::make_shared<utils::LruCache<K2Tree>>(
+        k0_*k0_, capacity, [=] (size_t t) {
+      uint section = first + (uint) t;
+      std::lock_guard<std::mutex> lock(*mutex);
+      in->clear();
+      layout.Verify(in.get(), section);
+      layout.Seek(in.get(), section);
+      return load(in.get());
+    });
   }
 
+  /* Returns the section storing a subtree.*/
+  uint Section(uint first, uint row, uint col) const {
+    return first + row*k0_ + col;
+  }
+
+  void CheckSections(uint first) const {
+    if (layout_.sections() != first + k0_*k0_) {
+      std::cerr << "[base_partition::base_partition] Error: Wrong number of "
+                << "sections" << std::endl;
+      exit(1);
+    }
+  }
+
+  /* Reads the number of links of each subtree.*/
+  template<class Reader>
+  void LoadSubtreeLinks(Reader *in) {
+    subtree_links_.resize(k0_*k0_);
+    for (size_t &l : subtree_links_)
+      l = LoadValue<size_t>(in);
+  }
+
+  /*
+   * Stores the number of links of each subtree, for the files that don't
+   * store them. The subtrees must be in memory.
+   */
+  void CountSubtreeLinks() {
+    subtree_links_.resize(k0_*k0_);
+    for (uint i = 0; i < k0_; ++i)
+      for (uint j = 0; j < k0_; ++j)
+        subtree_links_[i*k0_ + j] = subtrees_[i][j].links();
+  }
+
+  /* Returns the number of links of a subtree.*/
+  size_t SubtreeLinks(uint row, uint col) const {
+    return subtree_links_[row*k0_ + col];
+  }
+
+  /*
+   * Writes the content of the first section: cnt_, submatrix_size_, k0_ and
+   * the number of links of each subtree.
+   */
   void Save(std::ofstream *out) const {
     SaveValue(out, cnt_);
     SaveValue(out, submatrix_size_);
     SaveValue(out, k0_);
+    for (uint i = 0; i < k0_; ++i)
+      for (uint j = 0; j < k0_; ++j)
+        SaveValue<size_t>(out, SubtreeLinks(i, j));
   }
 
 
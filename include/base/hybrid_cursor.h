@@ -0,0 +1,287 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Pull-style traversal of hybrid k2trees.
+ */
+
+#ifndef INCLUDE_BASE_HYBRID_CURSOR_H_
+#define INCLUDE_BASE_HYBRID_CURSOR_H_
+
+#include <libk2tree_basic.h>
+#include <base/base_hybrid.h>
+#include <vector>
+
+namespace libk2tree {
+
+/**
+ * Cursor over the objects related to a given object. The tree is traversed
+ * depth first keeping one frame per level, so objects are returned in
+ * increasing order and no memory is allocated after construction.
+ * The cursor must not outlive the tree.
+ *
+ * Use DirectCursor and InverseCursor instead of this class directly.
+ */
+template<class Hybrid, class Impl>
+class LinksCursor {
+ public:
+  /**
+   * Creates a cursor positioned before the first object.
+   *
+   * @param tree Tree to traverse.
+   * @param object Row (direct) or column (inverse) of the matrix.
+   */
+  LinksCursor(const base_hybrid<Hybrid> &tree, cnt_size object)
+      : tree_(tree),
+        frames_(tree.height_ - 1),
+        next_z_(tree.height_ - 1),
+        next_j_(tree.height_ - 1),
+        depth_(0),
+        buffer_(tree.kL_),
+        buf_pos_(0),
+        buf_len_(0) {
+    frames_[0] = Impl::FirstFrame(object);
+    Enter(0);
+  }
+
+  /**
+   * Advances the cursor.
+   *
+   * @param object Pointer to store the next related object.
+   * @return False if there are no more objects, true otherwise.
+   */
+  bool Next(cnt_size *object) {
+    while (buf_pos_ == buf_len_) {
+      if (!Fill())
+        return false;
+    }
+    *object = buffer_[buf_pos_++];
+    return true;
+  }
+
+ private:
+  /** Tree being traversed */
+  const base_hybrid<Hybrid> &tree_;
+  /** Node currently visited at each level */
+  std::vector<Frame> frames_;
+  /** Position in T of the next child to check at each level */
+  std::vector<size_t> next_z_;
+  /** Number of the next child to check at each level */
+  std::vector<uint> next_j_;
+  /** Level of the deepest node in the path, -1 after the last object */
+  int depth_;
+  /** Objects found in the last leaf */
+  std::vector<cnt_size> buffer_;
+  /** Position of the next object in the buffer */
+  uint buf_pos_;
+  /** Number of objects in the buffer */
+  uint buf_len_;
+
+  /**
+   * Sets the first child of the node in the given level as the next one to
+   * check.
+   */
+  void Enter(uint level) {
+    uint k = tree_.GetK(level);
+    const Frame &f = frames_[level];
+    next_z_[level] = tree_.Child(f.z, level, k) +
+                     Impl::Offset(f, k, tree_.div_level_[level]);
+    next_j_[level] = 0;
+  }
+
+  /**
+   * Moves the traversal until reaching the next leaf and stores its objects
+   * in the buffer.
+   *
+   * @return False when the traversal is over.
+   */
+  bool Fill() {
+    uint last = tree_.height_ - 1;
+    while (depth_ >= 0) {
+      uint level = (uint) depth_;
+      uint k = tree_.GetK(level);
+      if (next_j_[level] == k) {
+        --depth_;
+        continue;
+      }
+      size_t z = next_z_[level];
+      uint j = next_j_[level]++;
+      next_z_[level] = Impl::NextChild(z, k);
+      if (!tree_.T_->Access(z))
+        continue;
+
+      const Frame &f = frames_[level];
+      Frame child = Impl::NextFrame(f.p, f.q, z, j, tree_.div_level_[level]);
+      if (level + 1 == last) {
+        buf_pos_ = buf_len_ = 0;
+        auto store = [&] (cnt_size object) {
+          buffer_[buf_len_++] = object;
+        };
+        tree_.template LeafBits<decltype(store), Impl>(
+            child, tree_.div_level_[last], store);
+        return true;
+      }
+      ++depth_;
+      frames_[level + 1] = child;
+      Enter(level + 1);
+    }
+    return false;
+  }
+};
+
+/**
+ * Cursor over the objects related to a given row.
+ */
+template<class Hybrid>
+using DirectCursor = LinksCursor<Hybrid, DirectImpl>;
+
+/**
+ * Cursor over the objects related to a given column.
+ */
+template<class Hybrid>
+using InverseCursor = LinksCursor<Hybrid, InverseImpl>;
+
+
+/**
+ * Cursor over the links in a submatrix. The tree is traversed depth first
+ * keeping one frame per level, so links are returned in the order of the
+ * leaves of the tree (Z-order) and no memory is allocated after
+ * construction. The cursor must not outlive the tree.
+ */
+template<class Hybrid>
+class RangeCursor {
+ public:
+  /**
+   * Creates a cursor positioned before the first link.
+   *
+   * @param tree Tree to traverse.
+   * @param p1 Starting row in the matrix.
+   * @param p2 Ending row in the matrix.
+   * @param q1 Starting column in the matrix.
+   * @param q2 Ending column in the matrix.
+   */
+  RangeCursor(const base_hybrid<Hybrid> &tree,
+              cnt_size p1, cnt_size p2, cnt_size q1, cnt_size q2)
+      : tree_(tree),
+        levels_(tree.height_ - 1),
+        depth_(0),
+        buffer_(tree.kL_*tree.kL_),
+        buf_pos_(0),
+        buf_len_(0) {
+    assert(p1 <= p2 && q1 <= q2);
+    Enter(0, {p1, p2, q1, q2, 0, 0, 0});
+  }
+
+  /**
+   * Advances the cursor.
+   *
+   * @param p Pointer to store the row of the next link.
+   * @param q Pointer to store the column of the next link.
+   * @return False if there are no more links, true otherwise.
+   */
+  bool Next(cnt_size *p, cnt_size *q) {
+    while (buf_pos_ == buf_len_) {
+      if (!Fill())
+        return false;
+    }
+    *p = buffer_[buf_pos_].first;
+    *q = buffer_[buf_pos_].second;
+    ++buf_pos_;
+    return true;
+  }
+
+ private:
+  /** Node visited at a level and the children of it lying in the range. */
+  struct Level {
+    RangeFrame f;
+    size_t first;
+    cnt_size div_p1, rem_p1, div_p2, rem_p2;
+    cnt_size div_q1, rem_q1, div_q2, rem_q2;
+    /** Next child to check */
+    cnt_size i, j;
+  };
+
+  /** Tree being traversed */
+  const base_hybrid<Hybrid> &tree_;
+  /** Node currently visited at each level */
+  std::vector<Level> levels_;
+  /** Level of the deepest node in the path, -1 after the last link */
+  int depth_;
+  /** Links found in the last leaf */
+  std::vector<std::pair<cnt_size, cnt_size>> buffer_;
+  /** Position of the next link in the buffer */
+  uint buf_pos_;
+  /** Number of links in the buffer */
+  uint buf_len_;
+
+  /**
+   * Visits the given node in the specified level.
+   */
+  void Enter(uint level, const RangeFrame &f) {
+    Divider<cnt_size> div_level = tree_.div_level_[level];
+    Level &l = levels_[level];
+    l.f = f;
+    l.first = tree_.Child(f.z, level, tree_.GetK(level));
+    l.div_p1 = f.p1/div_level, l.rem_p1 = f.p1%div_level;
+    l.div_p2 = f.p2/div_level, l.rem_p2 = f.p2%div_level;
+    l.div_q1 = f.q1/div_level, l.rem_q1 = f.q1%div_level;
+    l.div_q2 = f.q2/div_level, l.rem_q2 = f.q2%div_level;
+    l.i = l.div_p1;
+    l.j = l.div_q1;
+  }
+
+  /**
+   * Moves the traversal until reaching the next leaf and stores its links
+   * in the buffer.
+   *
+   * @return False when the traversal is over.
+   */
+  bool Fill() {
+    uint last = tree_.height_ - 1;
+    while (depth_ >= 0) {
+      uint level = (uint) depth_;
+      Level &l = levels_[level];
+      if (l.i > l.div_p2) {
+        --depth_;
+        continue;
+      }
+      cnt_size i = l.i, j = l.j;
+      if (++l.j > l.div_q2) {
+        l.j = l.div_q1;
+        ++l.i;
+      }
+
+      size_t z = l.first + tree_.GetK(level)*i + j;
+      if (!tree_.T_->Access(z))
+        continue;
+
+      cnt_size div_level = (cnt_size) tree_.div_level_[level];
+      RangeFrame child = {
+        i == l.div_p1 ? l.rem_p1 : 0,
+        i == l.div_p2 ? l.rem_p2 : div_level - 1,
+        j == l.div_q1 ? l.rem_q1 : 0,
+        j == l.div_q2 ? l.rem_q2 : div_level - 1,
+        l.f.dp + div_level*i,
+        l.f.dq + div_level*j,
+        z
+      };
+      if (level + 1 == last) {
+        buf_pos_ = buf_len_ = 0;
+        auto store = [&] (cnt_size p, cnt_size q) {
+          buffer_[buf_len_++] = std::make_pair(p, q);
+        };
+        tree_.RangeLeafBits(child, tree_.div_level_[last], store);
+        return true;
+      }
+      ++depth_;
+      Enter(level + 1, child);
+    }
+    return false;
+  }
+};
+}  // namespace libk2tree
+#endif  // INCLUDE_BASE_HYBRID_CURSOR_H_
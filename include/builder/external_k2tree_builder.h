@@ -0,0 +1,144 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_BUILDER_EXTERNAL_K2TREE_BUILDER_H_
+#define INCLUDE_BUILDER_EXTERNAL_K2TREE_BUILDER_H_
+
+#include <libk2tree_basic.h>
+#include <boost/filesystem.hpp>
+#include <builder/k2tree_builder.h>
+#include <builder/link_key.h>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+namespace libk2tree {
+using boost::filesystem::path;
+
+/**
+ * Builds a HybridK2Tree from links given in any order using a bounded amount
+ * of memory. Links are mapped to their LinkKey and kept in a buffer; when it
+ * is full the keys are sorted and written to a temporary file as a run.
+ * Build merges the runs, which yields the links in the order of their
+ * leaves, and writes the bits of each level to its own temporary file as
+ * they are found. Finally the tree is written level by level, streaming T
+ * and L from those files.
+ *
+ * Besides the buffer it uses a block of each run being merged, so the
+ * memory does not depend on the number of links. The disk needs about 8
+ * bytes for each link plus twice the size of the tree. The matrix must
+ * have at most 2^32 rows.
+ */
+class ExternalK2TreeBuilder {
+ public:
+  /**
+   * Creates a builder for a tree with a hybrid approach.
+   *
+   * @param cnt Number of object in the relation.
+   * @param k1 arity of the first levels.
+   * @param k2 arity of the second part.
+   * @param kL arity of the level height-1.
+   * @param k1_levels Number of levels with arity k1.
+   * @param tmp_dir Directory to store the temporary files.
+   * @param memory Number of bytes of the buffer of links.
+   * @param fan_in Maximum number of runs merged at once. When there are more
+   * runs, groups of them are merged into longer runs first.
+   */
+  ExternalK2TreeBuilder(cnt_size cnt, uint k1, uint k2, uint kL,
+                        uint k1_levels, const path &tmp_dir,
+                        size_t memory = 1UL << 30, uint fan_in = 64);
+
+  ExternalK2TreeBuilder(const ExternalK2TreeBuilder &) = delete;
+  ExternalK2TreeBuilder &operator=(const ExternalK2TreeBuilder &) = delete;
+
+  /**
+   * Creates a link from object p to q. Links can be added in any order and
+   * repeated links are ignored.
+   *
+   * @param p Identifier of the first object.
+   * @param q Identifier of the second object.
+   */
+  void AddLink(cnt_size p, cnt_size q);
+
+  /**
+   * Builds the tree with the links added and saves it to a file, as
+   * HybridK2Tree::Save. The builder is left empty.
+   *
+   * @param out Output stream.
+   */
+  void Build(std::ofstream *out);
+
+  /**
+   * Returns the number of runs written to disk and not yet merged.
+   */
+  size_t runs() const {
+    return runs_.size();
+  }
+
+  /**
+   * Returns the resulting height of the tree.
+   */
+  uint height() const {
+    return shape_.height();
+  }
+
+  /**
+   * Removes the temporary files.
+   */
+  ~ExternalK2TreeBuilder();
+
+ private:
+  /** Number of objects in the relation. */
+  cnt_size cnt_;
+  /** Arities of the tree. */
+  uint k1_, k2_, kL_;
+  /** Last level with arity k1. */
+  uint max_level_k1_;
+  /** Empty builder, giving the height and size of the tree. */
+  K2TreeBuilder shape_;
+  /** Keys of the links. */
+  LinkKey key_;
+  /** Directory of the temporary files. */
+  path tmp_dir_;
+  /** Number of bytes of the buffer, also used when merging. */
+  size_t memory_;
+  /** Maximum number of runs merged at once. */
+  uint fan_in_;
+  /** Keys not yet written to a run. */
+  std::vector<uint64_t> buffer_;
+  /** Runs written, each one with sorted keys without repetitions. */
+  std::vector<path> runs_;
+  /** Files storing the bits of each level while building. */
+  std::vector<path> levels_;
+
+  /**
+   * Sorts the buffer and writes it as a new run.
+   */
+  void Spill();
+
+  /**
+   * Merges groups of runs until there are at most fan_in_.
+   */
+  void ReduceRuns();
+
+  /**
+   * Calls fun with the keys of the runs in increasing order, once each.
+   */
+  template<class Function>
+  void Merge(const std::vector<path> &runs, Function fun) const;
+
+  /**
+   * Returns the name of a new temporary file.
+   */
+  path Temporary() const;
+};
+
+}  // namespace libk2tree
+
+#endif  // INCLUDE_BUILDER_EXTERNAL_K2TREE_BUILDER_H_
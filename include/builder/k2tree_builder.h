@@ -13,14 +13,22 @@
 
 #include <libk2tree_basic.h>
 #include <hybrid_k2tree.h>
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
+#include <iostream>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace libk2tree {
 
 /**
  * Implements the construction of section 3.3.3, building a regular tree
- * (with pointers) inserting one link (1 in the matrix) at a time.
+ * inserting one link (1 in the matrix) at a time. The nodes of each level
+ * are stored in a slab and refer to their children by index, so memory is
+ * only allocated when a slab grows and clearing the builder keeps it for
+ * the next tree.
  */
 class K2TreeBuilder {
  public:
@@ -63,11 +71,45 @@ class K2TreeBuilder {
     tree->Save(out);
   }
 
+  /**
+   * Builds a tree from a list of links without the tree with pointers. The
+   * links are sorted by the path from the root to their leaf, which also
+   * sorts the nodes of each level in the order they appear in T and L, so
+   * each level is written directly. Besides the output it uses 8 bytes for
+   * each link. Repeated links are allowed.
+   *
+   * The keys hold matrices of at most 2^32 rows. Larger matrices are built
+   * adding the links to a K2TreeBuilder, which needs the tree with pointers.
+   *
+   * @param cnt Number of object in the relation.
+   * @param k1 arity of the first levels.
+   * @param k2 arity of the second part.
+   * @param kL arity of the level height-1.
+   * @param k1_levels Number of levels with arity k1.
+   * @param begin Pointer to the first link (p, q).
+   * @param end Pointer past the last link.
+   * @return Pointer to the tree.
+   */
+  static std::shared_ptr<HybridK2Tree> BuildFromEdges(
+      cnt_size cnt, uint k1, uint k2, uint kL, uint k1_levels,
+      const std::pair<cnt_size, cnt_size> *begin,
+      const std::pair<cnt_size, cnt_size> *end);
+
   /**
    * Clears the builder deleting the current structure
    */
   void Clear();
 
+  /**
+   * Returns an upper bound of the bytes used by an empty builder to insert
+   * the given number of links and build the tree. It assumes that every
+   * link creates a new node in each level, as far as the level has room.
+   *
+   * @param links Number of links.
+   * @return Number of bytes.
+   */
+  size_t MemoryBound(size_t links) const;
+
   /**
    * Returns the resulting height of the tree.
    * @return Height of the tree.
@@ -76,6 +118,16 @@ class K2TreeBuilder {
     return height_;
   }
 
+  /**
+   * Returns the size of the expanded matrix, ie, the product of the arities
+   * of all levels.
+   *
+   * @return Number of rows (and cols) of the matrix.
+   */
+  inline cnt_size size() const {
+    return size_;
+  }
+
   /**
    * Returns number nodes in the last level.
    *
@@ -103,8 +155,6 @@ class K2TreeBuilder {
     return internal_nodes_;
   }
 
-  ~K2TreeBuilder();
-
  private:
   /** Number of objects in the original relation. */
   cnt_size cnt_;
@@ -130,35 +180,90 @@ class K2TreeBuilder {
    */
   size_t internal_nodes_;
 
-  /** Struct to store the tree. */
-  struct Node {
-    union {
-      /** Stores the children of a node in level height_-1 (the leaves) */
-      BitArray<uchar> *data_;
-      /** Array of pointers to children of internal nodes. */
-      Node **children_;
-    };
-  };
   /**
-   * Creates a node for the specified level using an appropriate k
-   *
-   * @param level Level
-   * @return New node storing union data corresponding to the level.
+   * Nodes of a level, each one a block of values, identified by consecutive
+   * 32-bit indices. Blocks are allocated in chunks that never move, so
+   * pointers to a block remain valid when more nodes are created.
    */
-  Node *CreateNode(uint level);
+  template<class T>
+  class Slab {
+   public:
+    /** Each chunk stores 2^kChunkBits nodes. */
+    static const uint kChunkBits = 12;
+
+    /**
+     * @param block Number of values of each node.
+     */
+    explicit Slab(uint block) : block_(block), size_(0) {}
+
+    /**
+     * Creates a node with all its values set to 0.
+     *
+     * @return Index of the node.
+     */
+    uint32_t Allocate() {
+      if (size_ == UINT32_MAX) {
+        std::cerr << "[K2TreeBuilder::Slab] Error: Too many nodes in a level"
+                  << std::endl;
+        exit(1);
+      }
+      if ((size_ >> kChunkBits) == chunks_.size())
+        chunks_.emplace_back(new T[(size_t) block_ << kChunkBits]);
+      T *node = At(size_);
+      std::fill(node, node + block_, T());
+      return size_++;
+    }
+
+    T *At(uint32_t node) {
+      return chunks_[node >> kChunkBits].get() +
+          (size_t) (node & kChunkMask)*block_;
+    }
+    const T *At(uint32_t node) const {
+      return chunks_[node >> kChunkBits].get() +
+          (size_t) (node & kChunkMask)*block_;
+    }
+
+    /**
+     * Returns the number of nodes.
+     */
+    uint32_t size() const {
+      return size_;
+    }
+
+    /**
+     * Removes all nodes keeping the chunks.
+     */
+    void Clear() {
+      size_ = 0;
+    }
+
+   private:
+    static const uint32_t kChunkMask = (1u << kChunkBits) - 1;
+
+    /** Number of values of each node. */
+    uint block_;
+    /** Number of nodes. */
+    uint32_t size_;
+    /** Chunks storing the nodes. */
+    std::vector<std::unique_ptr<T[]>> chunks_;
+  };
+
   /**
-   * Frees memory allocated for the given node assuming it was built for the
-   * specified level. Recursively delete children first.
-   *
-   * @param n Node.
-   * @param level Level containing the node.
+   * Nodes of the levels 0 to height_-2. Each one stores for every child the
+   * index of the child in the next level plus one, or 0 if it is empty.
+   * The root is the node 0 of the level 0.
    */
-  void DeleteNode(Node *n, uint level);
+  std::vector<Slab<uint32_t>> internal_slabs_;
+  /** Nodes of the level height_-1, storing the bits of their children. */
+  Slab<uchar> leaf_slab_;
 
   /**
-   * Root of the tree. This is never NULL.
+   * Creates a node for the specified level using an appropriate k
+   *
+   * @param level Level
+   * @return Index of the node in the level.
    */
-  mutable Node *root_;
+  uint32_t CreateNode(uint level);
 };
 
 
@@ -13,7 +13,9 @@
 #include <libk2tree_basic.h>
 #include <boost/filesystem.hpp>
 #include <builder/k2tree_builder.h>
+#include <utils/file_format.h>
 #include <fstream>
+#include <vector>
 
 namespace libk2tree {
 using boost::filesystem::path;
@@ -128,6 +130,8 @@ class K2TreePartitionBuilder {
   uint col_;
   /** Whether all submatrices have been built or not */
   bool ready_;
+  /** Number of links of each subtree built, in row-major order. */
+  std::vector<size_t> links_;
   /** Builder for the current submatrix. */
   K2TreeBuilder builder_;
   /** Name of the temporary file. */
@@ -139,6 +143,8 @@ class K2TreePartitionBuilder {
    * all the submatrices have been built.
    */
   std::ofstream out_;
+  /** Writes the header and the sections of the file. */
+  utils::FileWriter writer_;
 };
 }  // namespace libk2tree
 
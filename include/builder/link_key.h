@@ -0,0 +1,107 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_BUILDER_LINK_KEY_H_
+#define INCLUDE_BUILDER_LINK_KEY_H_
+
+#include <libk2tree_basic.h>
+#include <cstdint>
+#include <vector>
+
+namespace libk2tree {
+
+/**
+ * Maps a link to the sequence of children followed from the root to its
+ * leaf, as a number in mixed radix. The prefix of the key up to a level
+ * identifies the node, so sorting the keys sorts the nodes of every level
+ * as in the breadth first traversal, ie, as they appear in T and L. The
+ * matrix must have at most 2^32 rows for the keys to fit in 64 bits.
+ */
+class LinkKey {
+ public:
+  /**
+   * @param size Size of the expanded matrix.
+   * @param k1 Arity of the first levels.
+   * @param k2 Arity of the second part.
+   * @param kL Arity of the level height-1.
+   * @param max_level_k1 Last level with arity k1.
+   * @param height Height of the tree.
+   */
+  LinkKey(cnt_size size, uint k1, uint k2, uint kL, uint max_level_k1,
+          uint height)
+      : size_(size),
+        k_(height),
+        arity_(height),
+        weight_(height) {
+    for (uint level = 0; level < height; ++level) {
+      k_[level] = level == height - 1 ? kL : level <= max_level_k1 ? k1 : k2;
+      arity_[level] = k_[level]*k_[level];
+    }
+    weight_[height - 1] = 1;
+    for (uint level = height - 1; level > 0; --level)
+      weight_[level - 1] = weight_[level]*arity_[level];
+  }
+
+  /**
+   * Returns the key of the link from object p to q.
+   */
+  uint64_t operator()(cnt_size p, cnt_size q) const {
+    cnt_size N = size_;
+    uint64_t key = 0;
+    for (uint level = 0; level < k_.size(); ++level) {
+      cnt_size k = (cnt_size) k_[level];
+      cnt_size div_level = N/k;
+      key = key*arity_[level] + p/div_level*k + q/div_level;
+      N = div_level, p %= div_level, q %= div_level;
+    }
+    return key;
+  }
+
+  /**
+   * Returns the number of children of the nodes of a level.
+   */
+  uint64_t arity(uint level) const {
+    return arity_[level];
+  }
+
+  /**
+   * Returns the prefix of a key identifying its node in a level. Two keys
+   * are in the same node of the level iff their prefixes are equal.
+   *
+   * @param key Key of a link.
+   * @param level Level greater than 0.
+   */
+  uint64_t Node(uint64_t key, uint level) const {
+    return key/weight_[level - 1];
+  }
+
+  /**
+   * Returns the child followed by a key in a level.
+   */
+  uint Child(uint64_t key, uint level) const {
+    return (uint) (key/weight_[level] % arity_[level]);
+  }
+
+ private:
+  /** Size of the expanded matrix. */
+  cnt_size size_;
+  /** Arity of each level. */
+  std::vector<uint64_t> k_;
+  /** Squared arity of each level. */
+  std::vector<uint64_t> arity_;
+  /**
+   * Weight of the child of each level in the key, ie, the product of the
+   * squared arities below.
+   */
+  std::vector<uint64_t> weight_;
+};
+
+}  // namespace libk2tree
+
+#endif  // INCLUDE_BUILDER_LINK_KEY_H_
@@ -0,0 +1,181 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_BUILDER_PARALLEL_PARTITION_BUILDER_H_
+#define INCLUDE_BUILDER_PARALLEL_PARTITION_BUILDER_H_
+
+#include <libk2tree_basic.h>
+#include <boost/filesystem.hpp>
+#include <builder/k2tree_builder.h>
+#include <utils/thread_pool.h>
+#include <condition_variable>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace libk2tree {
+using boost::filesystem::path;
+
+/**
+ * Builder for the same structure as K2TreePartitionBuilder that constructs
+ * several subtrees at the same time. The links of each submatrix are
+ * collected by the calling thread and the subtree is built and saved to its
+ * own temporary segment by a thread of a pool. When all subtrees have been
+ * built the segments are assembled in order into the resulting file.
+ *
+ * Submatrices must be filled in row-wise order, as with
+ * K2TreePartitionBuilder. The memory budget bounds the memory of the
+ * submatrices waiting or being built, counting their links and a bound of
+ * the memory used to build their subtrees; when it is exceeded BuildSubtree
+ * blocks until some of them are done.
+ */
+class ParallelPartitionBuilder {
+ public:
+  /**
+   * Creates a builder partitioning the matrix in submatrices of the given
+   * size.
+   *
+   * @param cnt Number of objects in the relation or matrix.
+   * @param submatrix_size Size of submatrices.
+   * @param k1 Aritiy of the first levels in the subtrees.
+   * @param k2 Arity of the second part in the subtrees.
+   * @param kl Arity of the level height-1.
+   * @param k1_levels Number of levels with arity k1.
+   * @param file Name of the file to store the structure.
+   * @param threads Number of threads building subtrees. If 0 uses one for
+   * each hardware thread.
+   * @param memory Maximum number of bytes used by the submatrices not yet
+   * built.
+   *
+   * @see K2TreePartitionBuilder::K2TreePartitionBuilder
+   */
+  ParallelPartitionBuilder(cnt_size cnt, cnt_size submatrix_size,
+                           uint k1, uint k2, uint kl, uint k1_levels,
+                           const path &file, uint threads = 0,
+                           size_t memory = 1UL << 30);
+
+  /**
+   * Creates a link from object p to q, assuming it correspond to the current
+   * submatrix beeing built.
+   *
+   * @param p Identifier of the first object.
+   * @param q Identifier of the second object.
+   * @see K2TreePartitionBuilder::AddLink
+   */
+  void AddLink(cnt_size p, cnt_size q);
+
+  /**
+   * Queues the construction of the current submatrix and moves to the next
+   * one. After the last submatrix it waits for all of them and writes the
+   * resulting file.
+   */
+  void BuildSubtree();
+
+  /**
+   * Checks if all submatrices have been built and the file was written.
+   *
+   * @return True if all submatrices have been built, false otherwise.
+   */
+  bool Ready() const {
+    return ready_;
+  }
+
+  /**
+   * Returns the number of objects in the relation or matrix.
+   */
+  cnt_size cnt() const {
+    return cnt_;
+  }
+
+  /**
+   * Returns the row of the current submatrix in the row-wise traversal.
+   */
+  uint row() const {
+    return row_;
+  }
+
+  /**
+   * Returns the column of the current submatrix in the row-wise traversal.
+   */
+  uint col() const {
+    return col_;
+  }
+
+  /**
+   * Returns the number of division.
+   */
+  uint k0() const {
+    return k0_;
+  }
+
+  /**
+   * Waits for the subtrees being built and removes the temporary files.
+   */
+  ~ParallelPartitionBuilder();
+
+ private:
+  typedef std::pair<cnt_size, cnt_size> Link;
+
+  /** Number of objects in the relation or matrix. */
+  cnt_size cnt_;
+  /** Size of each submatrix. */
+  cnt_size submatrix_size_;
+  /** Value of k for the first level, ie, there are k0*k0 submatrices. */
+  uint k0_;
+  /** Arities and number of levels with arity k1 of the subtrees. */
+  uint k1_, k2_, kl_, k1_levels_;
+  /** Row of the current submatrix in the matrix of submatrices. */
+  uint row_;
+  /** Col of the current submatrix in the matrix of submatrices. */
+  uint col_;
+  /** Whether all submatrices have been built or not */
+  bool ready_;
+  /** Links of the current submatrix, relative to the submatrix. */
+  std::vector<Link> links_;
+  /** Name of the resulting file. */
+  path file_;
+  /** Temporary file storing each subtree, in row-major order. */
+  std::vector<path> segments_;
+  /** Number of links of each subtree, in row-major order. */
+  std::vector<size_t> subtree_links_;
+  /** Empty builder with the shape of the subtrees, bounding their memory. */
+  K2TreeBuilder shape_;
+  /** Maximum number of bytes used by the submatrices not yet built. */
+  size_t memory_;
+  /** Bytes used by the submatrices waiting or being built. */
+  size_t used_;
+  /** Number of submatrices waiting or being built. */
+  size_t pending_;
+  /** Protects used_ and pending_. */
+  std::mutex mutex_;
+  /** Signaled when a subtree is built. */
+  std::condition_variable built_;
+  /** Threads building the subtrees. */
+  utils::ThreadPool pool_;
+
+  /**
+   * Builds a subtree and saves it to its segment.
+   *
+   * @return Number of links of the subtree.
+   */
+  size_t Build(const std::vector<Link> &links, const path &segment) const;
+
+  /**
+   * Blocks until all queued subtrees are built.
+   */
+  void Wait();
+
+  /**
+   * Writes the resulting file with the segments in order.
+   */
+  void Assemble();
+};
+}  // namespace libk2tree
+
+#endif  // INCLUDE_BUILDER_PARALLEL_PARTITION_BUILDER_H_
@@ -32,8 +32,8 @@ class CompressedHybrid: public base_hybrid<CompressedHybrid> {
    * Builds a tree with the specified data that correctly represent a
    * <em>k<sup>2</sup></em>tree.
    *
-   * @param T Bit Sequence storing the internal nodes. Multiple instances
-   * can share the same sequence.
+   * @param T Bit array with rank support storing the internal nodes.
+   * Multiple instances can share the same array.
    * @param compressL Compressed representation of the last level using direct
    * addressable codes.
    * @param vocabulary Pointer to vocabulary of the leafs. Multiple instances
@@ -46,15 +46,15 @@ class CompressedHybrid: public base_hybrid<CompressedHybrid> {
    * @param cnt Number of object in the relation represented by the tree.
    * @param size Size of the expanded matrix.
    */
-  CompressedHybrid(std::shared_ptr<BitSequence> T,
+  CompressedHybrid(std::shared_ptr<RankBitArray> T,
                    FTRep *compressL,
                    std::shared_ptr<Vocabulary> vocabulary,
                    uint k1, uint k2, uint kL, uint max_level_k1, uint height,
                    cnt_size cnt, cnt_size size, size_t links);
 
   /**
-   * Loads a tree from a file. If the file doesn't contain
-   * a valid representation this function yields an undefined behaviour.
+   * Loads a tree from a file. The header of the file and the checksums are
+   * checked, reporting an error if they don't match.
    *
    * @param in Input stream pointing to the file storing the tree.
    * @see CompressedHybrid::Save
@@ -63,7 +63,8 @@ class CompressedHybrid: public base_hybrid<CompressedHybrid> {
 
   /**
    * Creates a tree loading it from a file but using the specified vocabulary.
-   * This method is used when a series of trees share the same vocabulary.
+   * This method is used when a series of trees share the same vocabulary,
+   * the tree must have been saved without vocabulary nor file header.
    *
    * @param in Input stream pointing to the file storing the tree.
    * @param voc Vocabulary of the leaf level.
@@ -71,11 +72,65 @@ class CompressedHybrid: public base_hybrid<CompressedHybrid> {
    */
   CompressedHybrid(ifstream *in, std::shared_ptr<Vocabulary> voc);
 
+  /**
+   * Loads a tree from a mapped file. The large arrays are used in place.
+   *
+   * @param in Reader pointing to the tree.
+   * @see CompressedHybrid::Save
+   */
+  explicit CompressedHybrid(MappedReader *in);
+
+  /**
+   * Loads a tree saved with its vocabulary by the versions of the library
+   * before the file header. T is converted to the current layout and the
+   * DAC widened to 64 bits, so saving the tree migrates the file.
+   *
+   * @param in Input stream pointing to the tree.
+   * @param legacy Tag selecting the old format.
+   */
+  CompressedHybrid(ifstream *in, utils::LegacyFormat legacy);
+
+  /**
+   * Loads a tree saved without vocabulary by the versions of the library
+   * before the file header, using the specified vocabulary.
+   *
+   * @param in Input stream pointing to the tree.
+   * @param voc Vocabulary of the leaf level.
+   * @param legacy Tag selecting the old format.
+   */
+  CompressedHybrid(ifstream *in, std::shared_ptr<Vocabulary> voc,
+                   utils::LegacyFormat legacy);
+
+  /**
+   * Loads a tree from a mapped file but using the specified vocabulary. The
+   * tree must have been saved without vocabulary nor file header.
+   *
+   * @param in Reader pointing to the tree.
+   * @param voc Vocabulary of the leaf level.
+   * @see CompressedHybrid::Save
+   */
+  CompressedHybrid(MappedReader *in, std::shared_ptr<Vocabulary> voc);
+
+  /**
+   * Maps a file storing a tree saved with Save, including the vocabulary.
+   * The arrays of the tree are read from the file as they are accessed, and
+   * the memory is shared with other processes mapping the same file.
+   *
+   * @param path Path of the file.
+   * @param verify Whether to check the checksums of the file, which reads
+   * it completely.
+   * @return Pointer to the tree.
+   */
+  static std::shared_ptr<CompressedHybrid> Open(const std::string &path,
+                                                bool verify = false);
+
   /** 
    * Saves the tree to a file.
    *
    * @param out Stream pointing to file.
-   * @param save_voc Wheter or not to save the vocabulary.
+   * @param save_voc Wheter or not to save the vocabulary. Trees without
+   * vocabulary are saved without file header, as sections of the file of a
+   * partition.
    */
   void Save(ofstream *out, bool save_voc = true) const;
 
@@ -101,6 +156,15 @@ class CompressedHybrid: public base_hybrid<CompressedHybrid> {
   /** Pointer to vocabulary */
   std::shared_ptr<Vocabulary> vocabulary_;
 
+  /**
+   * Creates the DAC of the leaves using in place the arrays of a mapped
+   * file.
+   *
+   * @param in Reader pointing to the DAC.
+   * @return Pointer to representation, to be freed with UnmapFT.
+   */
+  static FTRep *MapFT(MappedReader *in);
+
   /**
    * Returns word containing the bit at the given position
    * It access the corresponding word in the DAC.
@@ -109,7 +173,6 @@ class CompressedHybrid: public base_hybrid<CompressedHybrid> {
    * @return Pointer to the first position of the word.
    */
   const uchar *GetWord(size_t pos) const {
-    // TODO Port to 64-bits
     uint iword = accessFT(compressL_, pos/(kL_*kL_));
     return vocabulary_->get(iword);
   }
@@ -119,7 +182,8 @@ class CompressedHybrid: public base_hybrid<CompressedHybrid> {
    * specified in the given frame and calls fun reporting the object for
    * every child that is 1.
    * This function makes one access to the DAC to obtain the word containing
-   * the \a kL_<sup>2</sup> children.
+   * the \a kL_<sup>2</sup> children. When the word fits in 64 bits the row
+   * (or column) is extracted from it at once.
    *
    * @param f Frame containing the information required.
    * @param fun Pointer to function, functor or lambda to call for every bit
@@ -131,6 +195,10 @@ class CompressedHybrid: public base_hybrid<CompressedHybrid> {
     size_t first = Child(f.z, height_ - 1, kL_);
 
     const uchar *word = GetWord(first - T_->GetLength());
+    if (kL_ <= utils::kMaxWordArity) {
+      WordLeafBits<Function, Impl>(LeafWord(word), f, div_level, fun);
+      return;
+    }
 
     size_t z = first + Impl::Offset(f, kL_, div_level);
     for (uint j = 0; j < kL_; ++j) {
@@ -175,6 +243,31 @@ class CompressedHybrid: public base_hybrid<CompressedHybrid> {
     }
   }
 
+  /**
+   * Counts the children in the leaf lying in the range corresponding to the
+   * given frame that are 1, using a popcount over each row of the word.
+   * This function makes one access to the DAC.
+   *
+   * @param f Frame containing the information required.
+   * @return Number of ones in the range.
+   */
+  size_t CountLeafBits(const RangeFrame &f,
+                       Divider<cnt_size> div_level) const {
+    size_t first = Child(f.z, height_ - 1, kL_);
+    const uchar *word = GetWord(first - T_->GetLength());
+    cnt_size div_p1 = f.p1/div_level, div_p2 = f.p2/div_level;
+    cnt_size div_q1 = f.q1/div_level, div_q2 = f.q2/div_level;
+
+    // Rows are contiguous, whole rows are counted at once.
+    if (div_q1 == 0 && div_q2 == kL_ - 1)
+      return utils::CountOnes(word, kL_*div_p1, kL_*(div_p2 + 1));
+
+    size_t cnt = 0;
+    for (cnt_size i = div_p1; i <= div_p2; ++i)
+      cnt += utils::CountOnes(word, kL_*i + div_q1, kL_*i + div_q2 + 1);
+    return cnt;
+  }
+
   /**
    * Check if a child of the specified nodes is 1 or 0.
    *
@@ -189,6 +282,21 @@ class CompressedHybrid: public base_hybrid<CompressedHybrid> {
     return (word[child/kUcharBits] >> (child%kUcharBits)) & 1;
   }
 
+  /**
+   * Packs a word of the vocabulary into a 64-bit integer. The leaf must fit
+   * in a word, ie, kL must be at most utils::kMaxWordArity.
+   *
+   * @param word Pointer to the first position of the word.
+   * @return Children of the leaf, the first one in the lowest bit.
+   */
+  uint64_t LeafWord(const uchar *word) const {
+    uint64_t bits = 0;
+    uint size = WordSize();
+    for (uint b = 0; b < size; ++b)
+      bits |= (uint64_t) word[b] << (b*kUcharBits);
+    return bits;
+  }
+
   /**
    * Return the number of unsigned chars necessary to store a word 
    * in the leaf level, ie, \f$\frac{k_L^2}{kUcharBits}\f$
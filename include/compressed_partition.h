@@ -32,6 +32,48 @@ class CompressedPartition: public base_partition<CompressedHybrid> {
    */
   explicit CompressedPartition(std::ifstream *in);
 
+  /**
+   * Loads a tree from a mapped file. The large arrays of the subtrees and
+   * the vocabulary are used in place.
+   *
+   * @param in Reader pointing to the tree.
+   * @see CompressedPartition::Save
+   */
+  explicit CompressedPartition(MappedReader *in);
+
+  /**
+   * Loads a tree saved by the versions of the library before the file
+   * header. The subtrees are converted to the current layout, so saving
+   * the tree migrates the file.
+   *
+   * @param in Input stream.
+   * @param legacy Tag selecting the old format.
+   */
+  CompressedPartition(std::ifstream *in, utils::LegacyFormat legacy);
+
+  /**
+   * Opens a file reading only the metadata and the vocabulary. Each subtree
+   * is loaded the first time a query uses it, keeping in memory at most
+   * capacity subtrees, the least recently used one is discarded to make
+   * room for another.
+   *
+   * @param path Path of the file.
+   * @param capacity Maximum number of subtrees in memory.
+   * @see K2TreePartition::K2TreePartition(const std::string&, size_t)
+   */
+  CompressedPartition(const std::string &path, size_t capacity);
+
+  /**
+   * Maps a file storing a tree saved with Save or with
+   * K2TreePartition::CompressLeaves.
+   *
+   * @param path Path of the file.
+   * @return Pointer to the tree.
+   * @see HybridK2Tree::Open
+   */
+  static std::shared_ptr<CompressedPartition> Open(const std::string &path,
+                                                   bool verify = false);
+
   /**
    * Saves tree to file.
    *
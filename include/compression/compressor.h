@@ -13,6 +13,7 @@
 #include <libk2tree_basic.h>
 #include <compression/hash.h>
 #include <compression/vocabulary.h>
+#include <utils/thread_pool.h>
 #include <vector>
 #include <algorithm>
 #include <memory>
@@ -24,60 +25,71 @@ namespace compression {
 using std::shared_ptr;
 
 /**
- * Creates new k2tree with the leaves compressed.
- * @param tree
- * @param build 
+ * Number of occurrences of a word of a vocabulary.
+ */
+struct WordCount {
+  /** Position of the first occurrence of the word. */
+  size_t first;
+  /** Number of occurrences. */
+  size_t weight;
+};
+
+/**
+ * Counts the occurrences of the different words of a vocabulary. The words
+ * are distributed by a hash of their bytes in shards, and each shard is
+ * sorted to group its equal words. With a pool, the distribution and the
+ * shards are processed by its threads.
+ *
+ * @param words Vocabulary with all the words, possibly repeated.
+ * @param pool Pool running the tasks, or NULL to use the calling thread.
+ * @return One entry for each different word, sorted by decreasing number of
+ * occurrences and then by first occurrence.
+ */
+std::vector<WordCount> CountWords(const Vocabulary &words,
+                                  utils::ThreadPool *pool = NULL);
+
+/**
+ * Computes the vocabulary of the leaves of a tree sorted by frequency and
+ * calls build with it. Words with the same frequency are sorted by their
+ * first occurrence, so the result does not depend on the pool.
+ *
+ * @param tree Tree providing WordsCnt, WordSize and CopyWords.
+ * @param build Function receiving a HashTable associating each word with
+ * its frequency and its codeword, ie, its position in the vocabulary, and
+ * the vocabulary. The words of the table are valid only during the call.
+ * @param pool Pool used to count the words, or NULL to use the calling
+ * thread.
  */
 template<class K2Tree, class Fun>
-void FreqVoc(const K2Tree &tree, Fun build) {
+void FreqVoc(const K2Tree &tree, Fun build, utils::ThreadPool *pool = NULL) {
   try {
     size_t cnt = tree.WordsCnt();
     uint size = tree.WordSize();
 
     Vocabulary words(cnt, size);
+    tree.CopyWords(words.data());
 
-    size_t pos = 0;
-    tree.Words([&] (const uchar *word) {
-      words.assign(pos, word);
-      ++pos;
-    });
-
-
-    // Count number of different words
     // We hope there are many repetead words. We need to encode each word in
-    // a 32-bit integer.
-    size_t res = words.sort();
-    if (res > INT_MAX) {
+    // a 32-bit integer smaller than UINT_MAX.
+    std::vector<WordCount> counts = CountWords(words, pool);
+    if (counts.size() > UINT_MAX) {
       std::cerr << "[comperssion::FreqVoc] Too many different words ";
       std::cerr << "in the vocabulary\n";
       exit(1);
     }
-    uint diff_cnt = (uint) res;
-
-    // Insert words in hash
-    HashTable table(diff_cnt);
-    std::vector<size_t> posInHash;
-    posInHash.reserve(diff_cnt);
-    for (size_t i = 0; i < cnt; ++i) {
-      size_t addr;
-      if (!table.search(words[i], size, &addr)) {
-        table.add(words[i], size, addr);
-        posInHash.push_back(addr);
-      } else {
-        table[addr].weight += 1;
-      }
-    }
-
-    // Sort words by frequency
-    std::sort(posInHash.begin(), posInHash.end(), [&](size_t a, size_t b) {
-      return table[a].weight > table[b].weight;
-    });
+    uint diff_cnt = (uint) counts.size();
 
+    HashTable table(diff_cnt, 1.5, size);
     shared_ptr<Vocabulary> voc(new Vocabulary(diff_cnt, size));
     for (uint i = 0; i < diff_cnt; ++i) {
-      Nword &w = table[posInHash[i]];
+      const uchar *word = words[counts[i].first];
+      size_t addr;
+      table.search(word, size, &addr);
+      table.add(word, size, addr);
+      Nword &w = table[addr];
+      w.weight = (uint) std::min<size_t>(counts[i].weight, UINT_MAX);
       w.codeword = i;
-      voc->assign(i, w.word);
+      voc->assign(i, word);
     }
 
     build(table, voc);
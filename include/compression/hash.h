@@ -35,7 +35,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include <libk2tree_basic.h>
 #include <utils/utils.h>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <vector>
 
 // jump done when a collision appears
@@ -58,9 +60,24 @@ struct Nword {
   uint codeword;
 };
 
+/**
+ * Open addressing table of words. Words of up to 16 bytes with a size known
+ * in advance are stored as integers, hashed with a multiplicative hash in a
+ * table whose size is a power of two and probed linearly, so a search
+ * usually reads a single cache line of keys. Other words are hashed byte by
+ * byte and probed with a fixed jump.
+ */
 class HashTable {
  public:
-  HashTable(size_t sizeVoc, double occup_hash= 1.5);
+  /**
+   * Creates an empty table.
+   *
+   * @param sizeVoc Maximum number of words in the table.
+   * @param occup_hash Ratio between the number of entries and sizeVoc.
+   * @param word_size Size in bytes of every word of the table, or 0 if it
+   * is not known. Words of up to 16 bytes are then stored as integers.
+   */
+  HashTable(size_t sizeVoc, double occup_hash = 1.5, uint word_size = 0);
 
   /**
    * Adds a word to the hash in the specific addres.
@@ -82,7 +99,11 @@ class HashTable {
    * @param returnedAddr Pointer to store the address.
    * @return Ture in case the word is present and false otherwise.
    */
-  bool search(const uchar *aWord, uint len, size_t *returnedAddr) const;
+  bool search(const uchar *aWord, uint len, size_t *returnedAddr) const {
+    if (word_size_ != 0 && len == word_size_)
+      return integerSearch(aWord, returnedAddr);
+    return bytesSearch(aWord, len, returnedAddr);
+  }
 
   Nword &operator[](size_t i) {
     return hash_[i];
@@ -104,6 +125,54 @@ class HashTable {
   /** holds a hashTable of words*/
   std::vector<Nword> hash_;
 
+  /** Largest size of the words stored as integers. */
+  static const uint kMaxIntegerWord = 16;
+  /** Size of the words if they are stored as integers, otherwise 0. */
+  uint word_size_;
+  /** Number of integers of each key, 1 for words of up to 8 bytes. */
+  uint stride_;
+  /** Shift taking the bits of the multiplicative hash used as address. */
+  uint shift_;
+  /** Keys of the words stored as integers, stride_ for each entry. */
+  std::vector<uint64_t> keys_;
+  /** Whether each entry holds a word stored as integer. */
+  std::vector<uchar> used_;
+
+  /**
+   * Copies the bytes of a word stored as integer to its key.
+   */
+  void integerKey(const uchar *aWord, uint64_t key[2]) const {
+    key[0] = key[1] = 0;
+    memcpy(key, aWord, word_size_);
+  }
+
+  /**
+   * Searches a word stored as integer.
+   *
+   * @see HashTable::search
+   */
+  bool integerSearch(const uchar *aWord, size_t *returnedAddr) const {
+    uint64_t key[2];
+    integerKey(aWord, key);
+    uint64_t h = (key[0] ^ (key[1]*0xc2b2ae3d27d4eb4fULL)) *
+                 0x9e3779b97f4a7c15ULL;
+    size_t addr = (size_t) (h >> shift_);
+    const uint64_t *k = keys_.data();
+    while (used_[addr] &&
+           (k[addr*stride_] != key[0] ||
+            (stride_ == 2 && k[addr*stride_ + 1] != key[1])))
+      addr = (addr + 1) & (tam_hash_ - 1);
+    *returnedAddr = addr;
+    return used_[addr];
+  }
+
+  /**
+   * Searches a word hashing its bytes.
+   *
+   * @see HashTable::search
+   */
+  bool bytesSearch(const uchar *aWord, uint len, size_t *returnedAddr) const;
+
   /*------------------------------------------------------------------
    Modification of Zobel's bitwise function to have into account the 
    lenght of the key explicetely 
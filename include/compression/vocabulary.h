@@ -11,8 +11,11 @@
 #define INCLUDE_COMPRESSION_VOCABULARY_H_
 
 #include <libk2tree_basic.h>
+#include <utils/mapped_file.h>
+#include <utils/file_format.h>
 #include <algorithm>
 #include <fstream>
+#include <memory>
 
 namespace libk2tree {
 namespace compression {
@@ -27,6 +30,22 @@ class Vocabulary {
 
   explicit Vocabulary(std::ifstream *in);
 
+  /**
+   * Loads a vocabulary saved before the file header, which stored the words
+   * without padding.
+   *
+   * @param in Input stream.
+   */
+  Vocabulary(std::ifstream *in, utils::LegacyFormat);
+
+  /**
+   * Loads a vocabulary using in place the words stored in a mapped file.
+   * The vocabulary keeps a reference to the file and can't be modified.
+   *
+   * @param in Reader pointing to the vocabulary.
+   */
+  explicit Vocabulary(utils::MappedReader *in);
+
   void Save(std::ofstream *out);
 
   const uchar *operator[](size_t i) const {
@@ -36,6 +55,15 @@ class Vocabulary {
     return data_ + i*size_;
   }
 
+  /**
+   * Returns the array storing the words one after the other, cnt()*size()
+   * bytes. It can't be modified if the vocabulary was loaded from a mapped
+   * file.
+   */
+  uchar *data() {
+    return data_;
+  }
+
   /**
    * Print the vocabulary
    */
@@ -55,12 +83,10 @@ class Vocabulary {
 
   /**
    * Sort the vocabulary lexicographically and return the number of differents
-   * words.
+   * words. The words are ordered with SortByWord, so it takes linear time.
    * @return Number of differents words.
    */
-  size_t sort() {
-    return quicksort(0, cnt_);
-  }
+  size_t sort();
 
   /**
    * Return the size of the words in the vocabulary.
@@ -85,30 +111,27 @@ class Vocabulary {
   bool operator==(const Vocabulary &rhs) const;
 
  private:
-  /**
-   * Swap words in the vocabulary.
-   * @param a Position of the first word.
-   * @param b Position of the second word.
-   */
-  void swap(size_t a, size_t b);
-
-  /**
-   * Sort lexicographically the words between positions left and right, and
-   * returns the number of differents words.
-   * @param left Left position of the subarray.
-   * @param right Right position of the subarray.
-   * @return Number of differents words.
-   */
-  size_t quicksort(size_t left, size_t right);
-
   /** Number of words in the vocabulary*/
   size_t cnt_;
   /** Size in bytes of each word*/
   uint size_;
   /** Array storing words*/
   uchar *data_;
+  /** Mapped file holding data_, if any */
+  std::shared_ptr<utils::MappedFile> file_;
 };
 
+/**
+ * Sorts positions of a vocabulary by their words with a stable LSD radix
+ * sort, so equal words keep the order of their positions and the sort takes
+ * linear time. Words of up to 8 bytes are sorted as integers.
+ *
+ * @param words Vocabulary with the words.
+ * @param first Pointer to the first position.
+ * @param last Pointer past the last position.
+ */
+void SortByWord(const Vocabulary &words, size_t *first, size_t *last);
+
 }  // namespace compression
 }  // namespace libk2tree
 #endif  // INCLUDE_COMPRESSION_VOCABULARY_H_
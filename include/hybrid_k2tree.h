@@ -44,22 +44,145 @@ class HybridK2Tree : public base_hybrid<HybridK2Tree> {
                uint k1, uint k2, uint kL, uint max_level_k1, uint height,
                cnt_size cnt, cnt_size size, size_t links);
 
+  /**
+   * Builds a tree taking the arrays of the internal nodes and the leaves,
+   * instead of copying them. L is used as is and T is released after being
+   * copied into the rank structure, so at most one copy of each is kept.
+   *
+   * @see HybridK2Tree::HybridK2Tree
+   */
+  HybridK2Tree(BitArray<uint> &&T,
+               BitArray<uint> &&L,
+               uint k1, uint k2, uint kL, uint max_level_k1, uint height,
+               cnt_size cnt, cnt_size size, size_t links);
+
   HybridK2Tree(cnt_size cnt, cnt_size size): base_hybrid(cnt, size), L_() {};
 
   /**
-   * Loads a tree from a file.
+   * Loads a tree from a file. The header of the file and the checksums are
+   * checked, reporting an error if they don't match.
    *
    * @param in Input stream pointing to the file storing the tree.
+   * @param header Whether the tree was saved with the file header.
    * @see HybridK2Tree::Save
    */
-  explicit HybridK2Tree(ifstream *in);
+  explicit HybridK2Tree(ifstream *in, bool header = true);
+
+  /**
+   * Loads a tree from a mapped file. The large arrays are used in place.
+   *
+   * @param in Reader pointing to the tree.
+   * @param header Whether the tree was saved with the file header.
+   * @see HybridK2Tree::Save
+   */
+  explicit HybridK2Tree(MappedReader *in, bool header = true);
+
+  /**
+   * Loads a tree saved by the versions of the library before the file
+   * header. T is converted to the current layout, so saving the tree
+   * migrates the file.
+   *
+   * @param in Input stream pointing to the tree.
+   * @param legacy Tag selecting the old format.
+   */
+  HybridK2Tree(ifstream *in, utils::LegacyFormat legacy);
+
+  /**
+   * Maps a file storing a tree saved with Save. The arrays of the tree are
+   * read from the file as they are accessed, and the memory is shared
+   * with other processes mapping the same file.
+   *
+   * @param path Path of the file.
+   * @param verify Whether to check the checksums of the file, which reads
+   * it completely.
+   * @return Pointer to the tree.
+   */
+  static std::shared_ptr<HybridK2Tree> Open(const std::string &path,
+                                            bool verify = false);
 
   /** 
    * Saves the tree to a file.
    *
    * @param out Output stream
+   * @param header Whether to write the file header. Subtrees of a partition
+   * are saved without it, as sections of the file of the partition.
    */
-  void Save(ofstream *out) const;
+  void Save(ofstream *out, bool header = true) const;
+
+  /**
+   * Writes a tree to a file given the bits of T and L in order, without
+   * keeping them in memory. The rest of the structure only depends on the
+   * number of nodes in each level, so it is written first and the result is
+   * the same file written by Save.
+   */
+  class Writer {
+   public:
+    /**
+     * Writes the file header and the fields of the tree before T.
+     *
+     * @param out Output stream.
+     * @param k1 Arity of the first levels.
+     * @param k2 Arity of the second part.
+     * @param kL Arity of the level height-1.
+     * @param max_level_k1 Last level with arity k1.
+     * @param height Height of the tree.
+     * @param cnt Number of object in the original matrix.
+     * @param size Size of the expanded matrix.
+     * @param links Number of links.
+     * @param nodes Number of nodes in each level, the first one being the
+     * root.
+     */
+    Writer(ofstream *out, uint k1, uint k2, uint kL, uint max_level_k1,
+           uint height, cnt_size cnt, cnt_size size, size_t links,
+           const std::vector<size_t> &nodes);
+
+    /**
+     * Appends bits to T, ie, the children of the levels 0 to height-2.
+     *
+     * @param bits Word with the bits, the first one being the least
+     * significant.
+     * @param len Number of bits, at most 64.
+     */
+    void AppendT(uint64_t bits, uint len) {
+      T_->Append(bits, len);
+    }
+
+    /**
+     * Appends bits to L, ie, the children of the level height-1. T must
+     * be complete.
+     *
+     * @param bits Word with the bits, the first one being the least
+     * significant.
+     * @param len Number of bits, at most 64.
+     */
+    void AppendL(uint64_t bits, uint len) {
+      if (!L_)
+        BeginL();
+      L_->Append(bits, len);
+    }
+
+    /**
+     * Completes the file. All bits must have been appended.
+     */
+    void Finish();
+
+   private:
+    /** Output stream. */
+    ofstream *out_;
+    /** Writer of the header and the checksum of the tree. */
+    utils::FileWriter file_;
+    /** Length of L. */
+    size_t leaves_;
+    /** Writer of T. */
+    std::unique_ptr<RankBitArray::Writer> T_;
+    /** Writer of L, created after T is complete. */
+    std::unique_ptr<BitArray<uint>::Writer> L_;
+
+    /**
+     * Completes T and starts L.
+     */
+    void BeginL();
+  };
 
   /**
    * Returns memory usage.
@@ -92,36 +215,50 @@ class HybridK2Tree : public base_hybrid<HybridK2Tree> {
   }
 
   /**
-   * Iterates over the words in the leaf level.
+   * Iterates over the words in the leaf level. The bit j of a word is the
+   * bit j%8 of its byte j/8. When the words fill whole bytes they are read
+   * in place from L, otherwise each one is assembled in a buffer reused for
+   * all of them.
    *
    * @param fun Pointer to function, functor or lambda expecting a pointer to
-   * each word.
+   * each word. The pointer is only valid during the call.
    */
   template<typename Function>
   void Words(Function fun) const {
     size_t cnt = WordsCnt();
     uint size = WordSize();
 
-    size_t bit = 0;
+    const uchar *data = InPlaceWords();
+    if (data) {
+      for (size_t i = 0; i < cnt; ++i)
+        fun(data + i*size);
+      return;
+    }
+    std::vector<uchar> word(size);
     for (size_t i = 0; i < cnt; ++i) {
-      uchar *word = new uchar[size];
-      std::fill(word, word + size, 0);
-      for (uint j = 0; j < kL_*kL_; ++j, ++bit) {
-        if (L_.GetBit(bit))
-          word[j/kUcharBits] |= (uchar) (1 << (j%kUcharBits));
-      }
-      fun(word);
-      delete [] word;
+      ReadWord(i, word.data());
+      fun(static_cast<const uchar *>(word.data()));
     }
   }
 
+  /**
+   * Copies all the words in the leaf level to an array, one after the
+   * other, as reported by Words.
+   *
+   * @param out Array of WordsCnt()*WordSize() bytes.
+   */
+  void CopyWords(uchar *out) const;
+
   /**
    * Builds a <em>k<sup>2</sup></em>-tree with the same information but
    * compressing the leaves.
    *
+   * @param pool Pool used to compute the vocabulary, or NULL to use the
+   * calling thread.
    * @return Pointer to the new tree.
    */
-  std::shared_ptr<CompressedHybrid> CompressLeaves() const;
+  std::shared_ptr<CompressedHybrid> CompressLeaves(
+      utils::ThreadPool *pool = NULL) const;
 
   /**
    * Builds a <em>k<sup>2</sup></em>-tree with the same information but
@@ -140,12 +277,44 @@ class HybridK2Tree : public base_hybrid<HybridK2Tree> {
   /** BitArray containing leaf nodes. */
   BitArray<uint> L_;
 
+  /**
+   * Returns the words stored in place in L, if the words fill whole bytes
+   * and the bytes of L are in the order of its bits, or NULL otherwise.
+   */
+  const uchar *InPlaceWords() const {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // The bit p of L is the bit p%32 of its word p/32, which on a little
+    // endian machine is the bit p%8 of its byte p/8.
+    if (kL_*kL_ % kUcharBits == 0)
+      return reinterpret_cast<const uchar *>(L_.GetRawData());
+#endif
+    return NULL;
+  }
+
+  /**
+   * Assembles a word reading L in blocks of 64 bits.
+   *
+   * @param i Number of the word.
+   * @param word Array of WordSize() bytes to store the word.
+   */
+  void ReadWord(size_t i, uchar *word) const {
+    uint bits = kL_*kL_;
+    size_t start = i*bits;
+    for (uint b = 0; b < bits; b += 64) {
+      uint len = std::min(64u, bits - b);
+      uint64_t block = L_.GetBits(start + b, len);
+      for (uint j = 0; j < len; j += kUcharBits)
+        word[(b + j)/kUcharBits] = (uchar) (block >> j);
+    }
+  }
+
   /**
    * Iterates over the children in the leaf corresponding to the node  
    * specified in the given frame and calls fun reporting the object for
    * every child that is 1.
-   * This function simply access the position in the bit array representing the
-   * last level.
+   * When the leaf fits in a word it is loaded at once and the row (or column)
+   * is extracted from it. Otherwise the children in the row (or column) are
+   * read from the bit array in words of up to 64 bits.
    *
    * @param f Frame containing the information required.
    * @param fun Pointer to function, functor or lambda to call for every bit
@@ -154,19 +323,23 @@ class HybridK2Tree : public base_hybrid<HybridK2Tree> {
   template<typename Function, typename Impl>
   void LeafBits(const Frame &f, Divider<cnt_size> div_level,
                 Function fun) const {
-    size_t z = Child(f.z, height_-1, kL_) + Impl::Offset(f, kL_, div_level);
-    for (uint j  = 0; j < kL_; ++j) {
-      if (L_.GetBit(z - T_->GetLength()))
-        fun(Impl::Output(Impl::NextFrame(f.p, f.q, z, j, div_level)));
-      z = Impl::NextChild(z, kL_);
+    size_t first = Child(f.z, height_-1, kL_) - T_->GetLength();
+    if (kL_ <= utils::kMaxWordArity) {
+      WordLeafBits<Function, Impl>(L_.GetBits(first, kL_*kL_), f, div_level,
+                                   fun);
+      return;
     }
+    size_t start = first + Impl::Offset(f, kL_, div_level);
+    uint stride = (uint) Impl::NextChild(0, kL_);
+    ScanLine(start, kL_, stride, [&] (uint j) {
+      fun(Impl::Output(Impl::NextFrame(f.p, f.q, 0, j, div_level)));
+    });
   }
 
   /**
    * Iterates over the children in the leaf lying in the range corresponding to
    * the given frame and calls fun reporting the link for every child that is 1.
-   * This function simple access the position in the bit array representing the
-   * last level.
+   * Each row of the leaf is read from the bit array as a single word.
    *
    * @param f Frame containing the information required.
    * @param fun Pointer to function, functor or lambda to call for every bit
@@ -175,24 +348,76 @@ class HybridK2Tree : public base_hybrid<HybridK2Tree> {
   template<typename Function>
   void RangeLeafBits(const RangeFrame &f, Divider<cnt_size> div_level,
                      Function fun) const {
-    cnt_size div_p1, div_p2, div_q1, div_q2;
-    cnt_size dp, dq;
-    size_t first = Child(f.z, height_ - 1, kL_);
-
-    div_p1 = f.p1/div_level, div_p2 = f.p2/div_level;
+    size_t first = Child(f.z, height_ - 1, kL_) - T_->GetLength();
+    cnt_size div_p1 = f.p1/div_level, div_p2 = f.p2/div_level;
+    cnt_size div_q1 = f.q1/div_level, div_q2 = f.q2/div_level;
     for (cnt_size i = div_p1; i <= div_p2; ++i) {
-      size_t z = first + kL_*i;
-      dp = f.dp + (cnt_size) div_level*i;
+      cnt_size dp = f.dp + (cnt_size) div_level*i;
+      cnt_size dq = f.dq + (cnt_size) div_level*div_q1;
+      ScanLine(first + kL_*i + div_q1, (uint) (div_q2 - div_q1 + 1), 1,
+               [&] (uint j) {
+        fun(dp, dq + (cnt_size) div_level*j);
+      });
+    }
+  }
 
-      div_q1 = f.q1/div_level, div_q2 = f.q2/div_level;
-      for (cnt_size j = div_q1; j <= div_q2; ++j) {
-        dq = f.dq + (cnt_size) div_level*j;
-        if (L_.GetBit(z+j - T_->GetLength()))
-          fun(dp, dq);
+  /**
+   * Calls fun(j) for every j < cnt such that the bit start + j*stride of L
+   * is 1. The bits are loaded in words of up to 64 bits, masked to keep
+   * the positions in the line and iterated with ctz.
+   *
+   * @param start Position in L of the first bit of the line.
+   * @param cnt Number of bits in the line.
+   * @param stride Distance between consecutive bits of the line.
+   * @param fun Function receiving the number of each bit that is 1.
+   */
+  template<typename Function>
+  void ScanLine(size_t start, uint cnt, uint stride, Function fun) const {
+    // Number of bits of the line fitting in a word.
+    uint per_word = 63/stride + 1;
+    uint64_t mask = ~0ULL;
+    if (stride > 1) {
+      mask = 0;
+      for (uint j = 0; j < per_word; ++j)
+        mask |= 1ULL << (j*stride);
+    }
+
+    for (uint j0 = 0; j0 < cnt; j0 += per_word) {
+      uint len = (std::min(per_word, cnt - j0) - 1)*stride + 1;
+      uint64_t bits = L_.GetBits(start + (size_t) j0*stride, len) & mask;
+      while (bits) {
+        uint b = (uint) __builtin_ctzll(bits);
+        bits &= bits - 1;
+        fun(j0 + b/stride);
       }
     }
   }
 
+  /**
+   * Counts the children in the leaf lying in the range corresponding to the
+   * given frame that are 1, using a popcount over each row of the leaf.
+   *
+   * @param f Frame containing the information required.
+   * @return Number of ones in the range.
+   */
+  size_t CountLeafBits(const RangeFrame &f,
+                       Divider<cnt_size> div_level) const {
+    size_t first = Child(f.z, height_ - 1, kL_) - T_->GetLength();
+    cnt_size div_p1 = f.p1/div_level, div_p2 = f.p2/div_level;
+    cnt_size div_q1 = f.q1/div_level, div_q2 = f.q2/div_level;
+
+    // Rows are contiguous, whole rows are counted at once.
+    if (div_q1 == 0 && div_q2 == kL_ - 1)
+      return L_.CountOnes(first + kL_*div_p1, first + kL_*(div_p2 + 1));
+
+    size_t cnt = 0;
+    for (cnt_size i = div_p1; i <= div_p2; ++i) {
+      size_t z = first + kL_*i;
+      cnt += L_.CountOnes(z + div_q1, z + div_q2 + 1);
+    }
+    return cnt;
+  }
+
   /**
    * Check if the child of the specified nodes is 1 or 0.
    *
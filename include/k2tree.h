@@ -10,10 +10,51 @@
 #ifndef INCLUDE_K2TREE_H_
 #define INCLUDE_K2TREE_H_
 
+#include <builder/external_k2tree_builder.h>
 #include <builder/k2tree_builder.h>
 #include <builder/k2tree_partition_builder.h>
+#include <builder/parallel_partition_builder.h>
 #include <k2tree_partition.h>
 #include <hybrid_k2tree.h>
+#include <base/hybrid_cursor.h>
 #include <compressed_partition.h>
+#include <utils/file_format.h>
+#include <string>
+
+namespace libk2tree {
+
+/**
+ * Maps a file storing any kind of tree and calls fun with a shared pointer
+ * to it. The kind is read from the header of the file, so fun must accept
+ * a pointer to each kind of tree, eg, a functor with a template operator().
+ *
+ * @param path Path of the file.
+ * @param fun Function called with the tree.
+ * @param verify Whether to check the checksums of the file.
+ * @see HybridK2Tree::Open
+ */
+template<class Function>
+void Open(const std::string &path, Function fun, bool verify = false) {
+  switch (utils::FileLayout::Kind(path)) {
+    case kHybridK2Tree:
+      fun(HybridK2Tree::Open(path, verify));
+      break;
+    case kCompressedHybrid:
+      fun(CompressedHybrid::Open(path, verify));
+      break;
+    case kK2TreePartition:
+      fun(K2TreePartition::Open(path, verify));
+      break;
+    case kCompressedPartition:
+      fun(CompressedPartition::Open(path, verify));
+      break;
+    default:
+      std::cerr << "[Open] Error: Unknown kind of tree in " << path
+                << std::endl;
+      exit(1);
+  }
+}
+
+}  // namespace libk2tree
 
 #endif  // INCLUDE_K2TREE_H_
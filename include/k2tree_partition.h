@@ -33,6 +33,48 @@ class K2TreePartition: public base_partition<HybridK2Tree> {
    */
   explicit K2TreePartition(std::ifstream *in);
 
+  /**
+   * Loads tree from a mapped file. The large arrays of the subtrees are
+   * used in place.
+   *
+   * @param in Reader pointing to the tree.
+   * @see K2TreePartition::Save
+   */
+  explicit K2TreePartition(MappedReader *in);
+
+  /**
+   * Loads a tree saved by the versions of the library before the file
+   * header. The subtrees are converted to the current layout, so saving
+   * the tree migrates the file.
+   *
+   * @param in Input stream.
+   * @param legacy Tag selecting the old format.
+   */
+  K2TreePartition(std::ifstream *in, utils::LegacyFormat legacy);
+
+  /**
+   * Opens a file reading only the metadata of the tree. Each subtree is
+   * loaded the first time a query uses it, and its checksum is verified.
+   * At most capacity subtrees are kept in memory, the least recently used
+   * one is discarded to make room for another.
+   *
+   * @param path Path of the file.
+   * @param capacity Maximum number of subtrees in memory.
+   * @see base_partition::cache_hits
+   * @see base_partition::cache_misses
+   */
+  K2TreePartition(const std::string &path, size_t capacity);
+
+  /**
+   * Maps a file storing a tree saved with Save.
+   *
+   * @param path Path of the file.
+   * @return Pointer to the tree.
+   * @see HybridK2Tree::Open
+   */
+  static std::shared_ptr<K2TreePartition> Open(const std::string &path,
+                                               bool verify = false);
+
   /**
    * Returns number of words of size kL*kL in the leaf level.
    *
@@ -47,7 +89,7 @@ class K2TreePartition: public base_partition<HybridK2Tree> {
    * @return Size of the words.
    */
   uint WordSize() const {
-    return subtrees_[0][0].WordSize();
+    return GetSubtree(0, 0)->WordSize();
   }
 
   /**
@@ -60,17 +102,28 @@ class K2TreePartition: public base_partition<HybridK2Tree> {
   void Words(Function fun) const {
     for (uint row = 0; row < k0_; ++row)
       for (uint col = 0; col < k0_; ++col)
-        subtrees_[row][col].Words(fun);
+        GetSubtree(row, col)->Words(fun);
   }
 
+  /**
+   * Copies all the words in the leaf level to an array, in the order
+   * reported by Words.
+   *
+   * @param out Array of WordsCnt()*WordSize() bytes.
+   */
+  void CopyWords(uchar *out) const;
+
   /**
    * Constructs a new tree with the same information but compressing the leafs
    * of each subtree. A common vocabulary including all words is used to
    * compress each subtree.
    *
    * @param out Output stream to store the resulting tree.
+   * @param pool Pool used to compute the vocabulary, or NULL to use the
+   * calling thread.
    */
-  void CompressLeaves(std::ofstream *out) const;
+  void CompressLeaves(std::ofstream *out,
+                      utils::ThreadPool *pool = NULL) const;
 
   /**
    * Saves tree to file
@@ -13,45 +13,65 @@
 #include <libk2tree_basic.h>
 #include <type_traits>
 #include <utility>
+#include <algorithm>
 
 namespace libk2tree {
 namespace utils {
 
 /**
- * Queue implemented with a fixed size array.
+ * Queue implemented with a circular array. Slots released by pop are reused,
+ * so the memory is bounded by the largest number of elements stored at the
+ * same time. When the array is full its capacity is doubled.
+ * T must be default constructible and copy assignable.
  */
-template<class T, size_t Capacity = 10485760>
+template<class T>
 class ArrayQueue {
  public:
-  explicit ArrayQueue()
-      : data_(reinterpret_cast<T*>(::operator new (sizeof(T) * Capacity))),
+  /**
+   * Creates an empty queue. By default the array is allocated by the first
+   * push, so queues that are never used don't allocate memory.
+   *
+   * @param capacity Number of elements that can be stored before growing.
+   * It is rounded up to a power of two.
+   */
+  explicit ArrayQueue(size_t capacity = 0)
+      : data_(NULL),
+        capacity_(0),
         start_(0),
-        end_(0) {}
+        size_(0) {
+    reserve(capacity);
+  }
 
-  template<typename... Args>
-  void emplace_back(Args... args) {
-    new (&data_[end_]) T(std::forward<Args...>(args...));
-    ++end_;
+  ArrayQueue(const ArrayQueue &) = delete;
+  ArrayQueue &operator=(const ArrayQueue &) = delete;
+
+  ArrayQueue(ArrayQueue &&rhs)
+      : data_(rhs.data_),
+        capacity_(rhs.capacity_),
+        start_(rhs.start_),
+        size_(rhs.size_) {
+    rhs.data_ = NULL;
+    rhs.capacity_ = rhs.start_ = rhs.size_ = 0;
   }
 
-  /**
-   * Add value to the end of the queue
-   */
-  void push(const T &val) {
-    new (&data_[end_]) T(val);
-    ++end_;
+  template<typename... Args>
+  void emplace_back(Args&&... args) {
+    push(T{std::forward<Args>(args)...});
   }
 
   /**
    * Add value to the end of the queue
    */
-  void push(T &&val) {
-    new (&data_[end_]) T(val);
-    ++end_;
+  void push(const T &val) {
+    if (size_ == capacity_)
+      reserve(std::max<size_t>(1, 2*capacity_));
+    data_[(start_ + size_) & (capacity_ - 1)] = val;
+    ++size_;
   }
 
   /**
-   * Returns the value in the front of the queue.
+   * Returns the value in the front of the queue. The reference is invalidated
+   * by the next push.
    *
    * @return Const reference to the value.
    */
@@ -60,7 +80,8 @@ class ArrayQueue {
   }
 
   /**
-   * Returns the value in the front of the queue.
+   * Returns the value in the front of the queue. The reference is invalidated
+   * by the next push.
    *
    * @return Reference to the value.
    */
@@ -73,28 +94,64 @@ class ArrayQueue {
    * Removes element at front.
    */
   void pop() {
-    ++start_;
+    start_ = (start_ + 1) & (capacity_ - 1);
+    --size_;
   }
 
   void clear() {
-    start_ = end_ = 0;
+    start_ = size_ = 0;
   }
 
   size_t size() const {
-    return end_ - start_;
+    return size_;
+  }
+
+  bool empty() const {
+    return size_ == 0;
+  }
+
+  /**
+   * Returns the number of elements the queue can hold without growing.
+   */
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  /**
+   * Ensures that the queue can hold at least n elements without growing.
+   * Stored elements are kept in the same order.
+   *
+   * @param n Number of elements.
+   */
+  void reserve(size_t n) {
+    if (n <= capacity_)
+      return;
+    size_t capacity = capacity_ > 0 ? capacity_ : 1;
+    while (capacity < n)
+      capacity *= 2;
+
+    T *data = new T[capacity];
+    for (size_t i = 0; i < size_; ++i)
+      data[i] = data_[(start_ + i) & (capacity_ - 1)];
+    delete [] data_;
+    data_ = data;
+    capacity_ = capacity;
+    start_ = 0;
   }
 
   ~ArrayQueue() {
-    delete data_;
+    delete [] data_;
   }
 
  private:
   /** Array with the elements */
   T *data_;
+  /** Size of the array, always a power of two */
+  size_t capacity_;
   /** Position of the first element */
   size_t start_;
-  /** Position of the last element */
-  size_t end_;
+  /** Number of elements in the queue */
+  size_t size_;
 };
 
 
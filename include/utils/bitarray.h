@@ -14,8 +14,12 @@
 
 #include <libk2tree_basic.h>
 #include <utils/utils.h>
+#include <utils/mapped_file.h>
+#include <utils/file_format.h>
 #include <type_traits>
 #include <algorithm>
+#include <cstdint>
+#include <vector>
 #include <libcds2/array.h>
 
 
@@ -25,6 +29,37 @@
 namespace libk2tree {
 namespace utils {
 
+/**
+ * Counts the ones in the positions [start, end) of an array of words. The
+ * bit at position p is stored in the word p/bits at position p%bits, where
+ * bits is the number of bits in T. T should be an integral type of at most
+ * 64 bits.
+ *
+ * @param data Pointer to the first word.
+ * @param start First position.
+ * @param end Position past the last one.
+ * @return Number of ones.
+ */
+template<typename T>
+size_t CountOnes(const T *data, size_t start, size_t end) {
+  typedef typename std::make_unsigned<T>::type Unsigned;
+  const size_t bits = sizeof(T)*kByteBits;
+  if (start >= end)
+    return 0;
+
+  size_t first = start/bits, last = (end - 1)/bits;
+  size_t cnt = 0;
+  for (size_t w = first; w <= last; ++w) {
+    unsigned long long word = static_cast<Unsigned>(data[w]);
+    if (w == last && end % bits)
+      word &= (1ULL << (end % bits)) - 1;
+    if (w == first)
+      word >>= start % bits;
+    cnt += (size_t) __builtin_popcountll(word);
+  }
+  return cnt;
+}
+
 /**
  * Dynamic bitarray implementation with an array of T as underlying
  * representation. T should be an integral type.
@@ -43,7 +78,8 @@ class BitArray {
    */
   explicit BitArray(size_t length) :
       length_(length),
-      data_(new T[Ceil<size_t>(length_, bits_)]) {
+      data_(new T[Ceil<size_t>(length_, bits_)]),
+      owner_(true) {
     for (size_t i = 0; i < Ceil<size_t>(length_, bits_); ++i)
       data_[i] = 0;
   }
@@ -51,7 +87,7 @@ class BitArray {
   /**
    * Creates a bit array of length 0
    */
-  BitArray() : length_(0), data_(NULL) {};
+  BitArray() : length_(0), data_(NULL), owner_(true) {};
 
   /**
    * Constructs a bitarray from a file.
@@ -60,7 +96,31 @@ class BitArray {
    */
   explicit BitArray(ifstream *in) :
       length_(LoadValue<size_t>(in)),
-      data_(LoadValue<T>(in, Ceil<size_t>(length_, bits_))) {}
+      data_(LoadAligned<T>(in, Ceil<size_t>(length_, bits_))),
+      owner_(true) {}
+
+  /**
+   * Constructs a bitarray from a file saved before the file header, which
+   * stored the words without padding.
+   *
+   * @param in Input stream.
+   */
+  BitArray(ifstream *in, LegacyFormat) :
+      length_(LoadValue<size_t>(in)),
+      data_(LoadValue<T>(in, Ceil<size_t>(length_, bits_))),
+      owner_(true) {}
+
+  /**
+   * Constructs a bitarray using in place the bits stored in a mapped file.
+   * The array can't be modified and the caller must keep the file mapped
+   * while the array is used.
+   *
+   * @param in Reader pointing to the array.
+   */
+  explicit BitArray(MappedReader *in) :
+      length_(LoadValue<size_t>(in)),
+      data_(const_cast<T*>(in->View<T>(Ceil<size_t>(length_, bits_)))),
+      owner_(false) {}
 
   /**
    * Constructs a cds Array
@@ -80,13 +140,28 @@ class BitArray {
    */
   BitArray(const BitArray<T>& rhs) :
       length_(rhs.length()),
-      data_(new T[Ceil<size_t>(length_, bits_)]) {
+      data_(new T[Ceil<size_t>(length_, bits_)]),
+      owner_(true) {
     size_t size = Ceil<size_t>(length_, bits_);
     std::copy(rhs.data_, rhs.data_ + size, data_);
   }
 
+  /**
+   * Move constructor, leaves rhs empty.
+   */
+  BitArray(BitArray<T> &&rhs) :
+      length_(rhs.length_),
+      data_(rhs.data_),
+      owner_(rhs.owner_) {
+    rhs.length_ = 0;
+    rhs.data_ = NULL;
+    rhs.owner_ = true;
+  }
+
   BitArray &operator=(const BitArray& rhs) {
-    delete [] data_;
+    if (owner_)
+      delete [] data_;
+    owner_ = true;
     length_ = rhs.length_;
     size_t size = Ceil<size_t>(length_, bits_);
     data_ = new T[size];
@@ -100,7 +175,7 @@ class BitArray {
    */
   void Save(ofstream *out) const {
     SaveValue(out, length_);
-    SaveValue(out, data_, Ceil<size_t>(length_, bits_));
+    SaveAligned(out, data_, Ceil<size_t>(length_, bits_));
   }
 
   /** 
@@ -142,6 +217,43 @@ class BitArray {
     return (data_[p/bits_] >> (p%bits_) ) & 1;
   }
 
+  /**
+   * Returns len consecutive bits as a single word. The bit at position pos
+   * is the least significant bit of the result.
+   *
+   * @param pos Position of the first bit.
+   * @param len Number of bits, at most 64.
+   * @return Word with the bits.
+   */
+  uint64_t GetBits(size_t pos, uint len) const {
+    typedef typename std::make_unsigned<T>::type Unsigned;
+    assert(len <= 64 && pos + len <= length_);
+    uint64_t bits = 0;
+    uint done = 0;
+    while (done < len) {
+      size_t p = pos + done;
+      uint offset = (uint) (p % bits_);
+      uint take = std::min((uint) bits_ - offset, len - done);
+      uint64_t word = static_cast<Unsigned>(data_[p/bits_]) >> offset;
+      if (take < 64)
+        word &= (1ULL << take) - 1;
+      bits |= word << done;
+      done += take;
+    }
+    return bits;
+  }
+
+  /**
+   * Counts the ones in the positions [start, end).
+   *
+   * @param start First position.
+   * @param end Position past the last one.
+   * @return Number of ones.
+   */
+  size_t CountOnes(size_t start, size_t end) const {
+    return utils::CountOnes(data_, start, end);
+  }
+
   /**
    * Returns the length of the bit array.
    *
@@ -161,9 +273,88 @@ class BitArray {
   }
 
   ~BitArray() {
-    delete [] data_;
+    if (owner_)
+      delete [] data_;
   }
 
+  /**
+   * Writes a bit array to a file appending its bits in order, without
+   * keeping it in memory. The result can be loaded as an array saved with
+   * Save.
+   */
+  class Writer {
+   public:
+    /**
+     * Writes the beginning of the array.
+     *
+     * @param out Output stream.
+     * @param length Number of bits that will be appended.
+     */
+    Writer(ofstream *out, size_t length) : out_(out), length_(length),
+                                           pos_(0) {
+      SaveValue(out_, length_);
+      AlignStream(out_);
+      buffer_.reserve(kBufferWords);
+    }
+
+    /**
+     * Appends bits to the array.
+     *
+     * @param bits Word with the bits, the first one being the least
+     * significant.
+     * @param len Number of bits, at most 64.
+     */
+    void Append(uint64_t bits, uint len) {
+      typedef typename std::make_unsigned<T>::type Unsigned;
+      assert(len <= 64 && pos_ + len <= length_);
+      while (len > 0) {
+        uint offset = (uint) (pos_ % bits_);
+        if (offset == 0) {
+          if (buffer_.size() == kBufferWords)
+            Flush();
+          buffer_.push_back(0);
+        }
+        uint take = std::min((uint) bits_ - offset, len);
+        uint64_t chunk = take < 64 ? bits & ((1ULL << take) - 1) : bits;
+        buffer_.back() = (T) (static_cast<Unsigned>(buffer_.back()) |
+                              (Unsigned) (chunk << offset));
+        bits = take < 64 ? bits >> take : 0;
+        len -= take;
+        pos_ += take;
+      }
+    }
+
+    /**
+     * Writes the pending bits. All bits must have been appended.
+     */
+    void Finish() {
+      if (pos_ != length_) {
+        std::cerr << "[BitArray::Writer] Error: Expected " << length_
+                  << " bits, got " << pos_ << std::endl;
+        exit(1);
+      }
+      Flush();
+    }
+
+   private:
+    /** Words kept before writing them. */
+    static const size_t kBufferWords = 1 << 16;
+
+    /** Output stream. */
+    ofstream *out_;
+    /** Number of bits of the array. */
+    size_t length_;
+    /** Number of bits appended. */
+    size_t pos_;
+    /** Words not yet written, the last one may be incomplete. */
+    std::vector<T> buffer_;
+
+    void Flush() {
+      SaveValue(out_, buffer_.data(), buffer_.size());
+      buffer_.clear();
+    }
+  };
+
 
  private:
   /** Number of bits on T. */
@@ -172,6 +363,8 @@ class BitArray {
   size_t length_;
   /** Array to hold bits. */
   T * data_;
+  /** Whether data_ was allocated by the array or points to a mapped file. */
+  bool owner_;
 };
 
 }  // namespace utils
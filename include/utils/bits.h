@@ -0,0 +1,71 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Bit manipulation over the words of the leaf level.
+ */
+
+#ifndef INCLUDE_UTILS_BITS_H_
+#define INCLUDE_UTILS_BITS_H_
+
+#include <libk2tree_basic.h>
+#include <cassert>
+#include <cstdint>
+
+namespace libk2tree {
+namespace utils {
+
+/** Largest arity whose kL*kL leaf fits in a 64-bit word. */
+const uint kMaxWordArity = 8;
+
+/**
+ * Gathers the bits of word selected by mask into the lowest bits of the
+ * result, preserving their order (parallel bit extract). Uses the PEXT
+ * instruction when the processor supports BMI2 and a scalar loop
+ * otherwise. The implementation is selected once at load time.
+ *
+ * @param word Word to extract from.
+ * @param mask Positions to extract.
+ * @return Word with popcount(mask) significant bits.
+ */
+uint64_t ExtractBits(uint64_t word, uint64_t mask);
+
+/**
+ * Returns a mask with the bits of column 0 of a kL*kL matrix stored row by
+ * row in a word, ie, the bits 0, kL, 2kL, ..., (kL-1)kL.
+ *
+ * @param kL Arity, at most kMaxWordArity.
+ */
+inline uint64_t ColumnMask(uint kL) {
+  static const uint64_t masks[kMaxWordArity + 1] = {
+    0x0, 0x1, 0x5, 0x49, 0x1111, 0x108421, 0x41041041, 0x40810204081,
+    0x101010101010101
+  };
+  assert(kL <= kMaxWordArity);
+  return masks[kL];
+}
+
+/**
+ * Extracts a column of a kL*kL matrix stored row by row in a word. Bit i of
+ * the result is the element in row i. For kL = 8 a multiplication gathers
+ * the column, which is as fast as PEXT and avoids its high latency on some
+ * processors; other arities use ExtractBits.
+ *
+ * @param word Matrix stored row by row, the first row in the lowest bits.
+ * @param col Column to extract.
+ * @param kL Arity, at most kMaxWordArity.
+ * @return Word with kL significant bits.
+ */
+inline uint64_t ExtractColumn(uint64_t word, uint col, uint kL) {
+  if (kL == 8)
+    return (((word >> col) & ColumnMask(8))*0x0102040810204080ULL) >> 56;
+  return ExtractBits(word, ColumnMask(kL) << col);
+}
+
+}  // namespace utils
+}  // namespace libk2tree
+#endif  // INCLUDE_UTILS_BITS_H_
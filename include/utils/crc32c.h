@@ -0,0 +1,39 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * CRC-32C (Castagnoli) checksum.
+ */
+
+#ifndef INCLUDE_UTILS_CRC32C_H_
+#define INCLUDE_UTILS_CRC32C_H_
+
+#include <libk2tree_basic.h>
+#include <cstdint>
+#include <cstddef>
+
+namespace libk2tree {
+namespace utils {
+
+/**
+ * Computes the CRC-32C of an array of bytes. Uses the CRC32 instruction
+ * when the processor supports SSE 4.2 and a lookup table otherwise. The
+ * implementation is selected once at load time.
+ *
+ * The checksum of a sequence split in several parts can be computed
+ * passing the checksum of the previous parts as crc.
+ *
+ * @param data Pointer to the first byte.
+ * @param length Number of bytes.
+ * @param crc Checksum of the preceding bytes, 0 for the first part.
+ * @return Checksum of the bytes.
+ */
+uint32_t Crc32c(const void *data, size_t length, uint32_t crc = 0);
+
+}  // namespace utils
+}  // namespace libk2tree
+#endif  // INCLUDE_UTILS_CRC32C_H_
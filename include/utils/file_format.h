@@ -0,0 +1,356 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Header and section table of the files storing a tree.
+ *
+ * A file starts with a FileHeader followed by a table with one SectionEntry
+ * for each section. The sections come next, in order, each one starting at
+ * an offset multiple of kFileAlignment. Offsets are relative to the first
+ * byte of the header.
+ */
+
+#ifndef INCLUDE_UTILS_FILE_FORMAT_H_
+#define INCLUDE_UTILS_FILE_FORMAT_H_
+
+#include <libk2tree_basic.h>
+#include <utils/utils.h>
+#include <utils/mapped_file.h>
+#include <cstdint>
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+namespace libk2tree {
+
+/**
+ * Kind of tree stored in a file.
+ */
+enum TreeKind : uint32_t {
+  kHybridK2Tree = 1,
+  kCompressedHybrid = 2,
+  kK2TreePartition = 3,
+  kCompressedPartition = 4
+};
+
+namespace utils {
+
+/** Version of the format written by FileWriter. */
+const uint32_t kFormatVersion = 1;
+
+/**
+ * Tag selecting the constructors that read the files saved by the versions
+ * of the library before the header. Those files store T as a libcds
+ * BitSequenceOneLevelRank, the arrays without padding and the DAC of the
+ * compressed trees with 32 bits. They can only be read from a stream.
+ */
+struct LegacyFormat {};
+
+/** Value written to detect files saved with a different byte order. */
+const uint32_t kEndianness = 0x01020304;
+
+/**
+ * First bytes of a file.
+ */
+struct FileHeader {
+  /** Identifies the file as a tree, "LIBK2TRE". */
+  char magic[8];
+  /** Version of the format. */
+  uint32_t version;
+  /** kEndianness as written by the machine saving the file. */
+  uint32_t endianness;
+  /** Kind of the tree. */
+  uint32_t kind;
+  /** Number of sections. */
+  uint32_t sections;
+  /**
+   * CRC-32C of the header, with this field set to 0, followed by the section
+   * table.
+   */
+  uint32_t crc;
+  /** Unused, always 0. */
+  uint32_t reserved;
+};
+
+/**
+ * Location and checksum of a section.
+ */
+struct SectionEntry {
+  /** Position of the section relative to the header. */
+  uint64_t offset;
+  /** Length in bytes. */
+  uint64_t length;
+  /** CRC-32C of the section. */
+  uint32_t crc;
+  /** Unused, always 0. */
+  uint32_t reserved;
+};
+
+/**
+ * Returns the name of the given kind of tree.
+ */
+const char *KindName(uint32_t kind);
+
+/**
+ * Writes a file with header and sections into a stream. The sections are
+ * written with the usual functions between BeginSection and EndSection,
+ * while the writer computes their checksum.
+ */
+class FileWriter {
+ public:
+  /**
+   * Writes a provisional header at the next aligned position of the stream.
+   *
+   * @param out Output stream.
+   * @param kind Kind of tree.
+   * @param sections Number of sections that will be written.
+   */
+  FileWriter(ofstream *out, TreeKind kind, uint sections);
+
+  FileWriter(const FileWriter &) = delete;
+  FileWriter &operator=(const FileWriter &) = delete;
+
+  /**
+   * Restores the stream if Finish was not called.
+   */
+  ~FileWriter();
+
+  /**
+   * Starts the first section not written yet.
+   */
+  void BeginSection();
+
+  /**
+   * Starts the given section. Sections may be written in any order, but
+   * each one only once.
+   *
+   * @param i Number of the section.
+   */
+  void BeginSection(uint i);
+
+  /**
+   * Ends the current section.
+   */
+  void EndSection();
+
+  /**
+   * Writes the final header and section table, and leaves the stream at the
+   * end of the file. All the sections must have been written.
+   */
+  void Finish();
+
+ private:
+  /**
+   * Stream buffer forwarding the writes to another buffer while computing
+   * their checksum.
+   */
+  class ChecksumBuffer : public std::streambuf {
+   public:
+    explicit ChecksumBuffer(std::streambuf *sink) : sink_(sink), crc_(0) {}
+
+    uint32_t crc() const {
+      return crc_;
+    }
+    void Reset() {
+      crc_ = 0;
+    }
+
+   protected:
+    int_type overflow(int_type c);
+    std::streamsize xsputn(const char *s, std::streamsize n);
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                     std::ios_base::openmode which);
+    pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+    int sync();
+
+   private:
+    std::streambuf *sink_;
+    uint32_t crc_;
+  };
+
+  /** Output stream. */
+  ofstream *out_;
+  /** Buffer of the stream before the writer was created. */
+  std::streambuf *sink_;
+  /** Buffer installed in the stream while writing the sections. */
+  ChecksumBuffer buffer_;
+  /** Position of the header in the stream. */
+  size_t base_;
+  /** Header. */
+  FileHeader header_;
+  /** Section table. */
+  std::vector<SectionEntry> sections_;
+  /** Whether each section was written. */
+  std::vector<bool> written_;
+  /** Section being written. */
+  uint current_;
+  /** First section not written yet. */
+  uint next_;
+  /** Whether the stream was restored. */
+  bool finished_;
+};
+
+/**
+ * Header and section table of a file, read from a stream or a mapped file.
+ * If the file is not a tree of the expected kind, saved with a supported
+ * version and byte order, or a checksum doesn't match, it reports the error
+ * and exits.
+ */
+class FileLayout {
+ public:
+  /**
+   * Reads the header at the next aligned position of the stream and checks
+   * every section. Leaves the stream at the first section.
+   *
+   * @param in Input stream.
+   * @param kind Expected kind of tree.
+   * @param verify Whether to check the checksums, reading the whole file.
+   */
+  FileLayout(ifstream *in, TreeKind kind, bool verify = true);
+
+  /**
+   * Reads the header at the next aligned position of a mapped file. Leaves
+   * the reader at the first section.
+   *
+   * @param in Reader of the mapped file.
+   * @param kind Expected kind of tree.
+   * @param verify Whether to check the checksums, reading the whole file.
+   */
+  FileLayout(MappedReader *in, TreeKind kind, bool verify);
+
+  /**
+   * Empty layout, used by the trees loaded from files without header.
+   */
+  FileLayout() : base_(0), version_(0) {}
+
+  /**
+   * Returns the kind of tree stored in a file.
+   *
+   * @param path Path of the file.
+   * @return Kind of tree.
+   */
+  static TreeKind Kind(const std::string &path);
+
+  /**
+   * Returns the version of the format of the file.
+   */
+  uint32_t version() const {
+    return version_;
+  }
+
+  /**
+   * Returns the number of sections.
+   */
+  uint sections() const {
+    return (uint) sections_.size();
+  }
+
+  /**
+   * Returns the absolute position of a section.
+   *
+   * @param i Number of the section.
+   */
+  size_t offset(uint i) const {
+    return base_ + sections_[i].offset;
+  }
+
+  /**
+   * Returns the length of a section.
+   *
+   * @param i Number of the section.
+   */
+  size_t length(uint i) const {
+    return sections_[i].length;
+  }
+
+  /**
+   * Checks the checksum of a section, reading it from the stream.
+   *
+   * @param in Input stream.
+   * @param i Number of the section.
+   */
+  void Verify(ifstream *in, uint i) const;
+
+  /**
+   * Moves the stream to the beginning of a section.
+   *
+   * @param in Input stream.
+   * @param i Number of the section.
+   */
+  void Seek(ifstream *in, uint i) const {
+    in->seekg((std::streamoff) offset(i));
+  }
+
+  /**
+   * Moves the reader to the beginning of a section.
+   *
+   * @param in Reader of the mapped file.
+   * @param i Number of the section.
+   */
+  void Seek(MappedReader *in, uint i) const {
+    in->Seek(offset(i));
+  }
+
+ private:
+  /** Position of the header. */
+  size_t base_;
+  /** Version of the format. */
+  uint32_t version_;
+  /** Section table. */
+  std::vector<SectionEntry> sections_;
+
+  /**
+   * Checks the header against the expected kind and the file size, before
+   * reading the section table.
+   */
+  void CheckHeader(const FileHeader &header, TreeKind kind,
+                   size_t size) const;
+
+  /**
+   * Checks the checksum of the header and the section table, and the
+   * sections against the file size.
+   */
+  void Check(const FileHeader &header, size_t size) const;
+
+  /**
+   * Reports that section i is corrupted and exits.
+   */
+  void Corrupted(uint i) const;
+};
+
+/**
+ * Reads and checks the header of a file storing a tree of the given kind,
+ * leaving the stream at the first section. Meant to be used in the
+ * initialization of a tree loaded from a file.
+ *
+ * @param in Input stream.
+ * @param kind Expected kind of tree.
+ * @return The same stream.
+ */
+inline ifstream *SkipHeader(ifstream *in, TreeKind kind) {
+  FileLayout layout(in, kind);
+  return in;
+}
+
+/**
+ * Reads and checks the header of a mapped file storing a tree of the given
+ * kind, leaving the reader at the first section. The checksums are not
+ * verified.
+ *
+ * @param in Reader of the mapped file.
+ * @param kind Expected kind of tree.
+ * @return The same reader.
+ */
+inline MappedReader *SkipHeader(MappedReader *in, TreeKind kind) {
+  FileLayout layout(in, kind, false);
+  return in;
+}
+
+}  // namespace utils
+}  // namespace libk2tree
+#endif  // INCLUDE_UTILS_FILE_FORMAT_H_
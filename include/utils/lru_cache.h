@@ -0,0 +1,165 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_UTILS_LRU_CACHE_H_
+#define INCLUDE_UTILS_LRU_CACHE_H_
+
+#include <libk2tree_basic.h>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace libk2tree {
+namespace utils {
+
+/**
+ * Values identified by the keys 0..n-1 that are loaded on first access and
+ * kept in memory up to a maximum number, discarding the least recently used
+ * one when a new value has to be loaded. It can be used by several threads
+ * at the same time.
+ */
+template<class T>
+class LruCache {
+ public:
+  /**
+   * Function loading the value of a key.
+   */
+  typedef std::function<std::shared_ptr<T>(size_t)> Loader;
+
+  /**
+   * Creates an empty cache.
+   *
+   * @param keys Number of keys.
+   * @param capacity Maximum number of values kept in memory, at least one.
+   * @param load Function loading a value. It is called without holding the
+   * lock of the cache, so it may run concurrently for different keys, but
+   * never twice at the same time for the same key.
+   */
+  LruCache(size_t keys, size_t capacity, Loader load)
+      : values_(keys),
+        loading_(keys),
+        positions_(keys),
+        capacity_(capacity > 0 ? capacity : 1),
+        load_(load),
+        hits_(0),
+        misses_(0) {}
+
+  LruCache(const LruCache &) = delete;
+  LruCache &operator=(const LruCache &) = delete;
+
+  /**
+   * Returns the value of a key, loading it if it is not in memory. A value
+   * discarded from the cache remains valid while the returned pointer lives.
+   *
+   * @param key Key of the value.
+   * @return Pointer to the value.
+   */
+  std::shared_ptr<const T> Get(size_t key) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (values_[key]) {
+      ++hits_;
+      recent_.splice(recent_.begin(), recent_, positions_[key]);
+      return values_[key];
+    }
+    if (loading_[key].valid()) {
+      // Another thread is loading the value.
+      ++hits_;
+      std::shared_future<std::shared_ptr<T>> loading = loading_[key];
+      lock.unlock();
+      return loading.get();
+    }
+
+    ++misses_;
+    std::promise<std::shared_ptr<T>> promise;
+    loading_[key] = promise.get_future().share();
+    lock.unlock();
+    std::shared_ptr<T> value = load_(key);
+    promise.set_value(value);
+
+    lock.lock();
+    loading_[key] = std::shared_future<std::shared_ptr<T>>();
+    if (recent_.size() == capacity_) {
+      values_[recent_.back()].reset();
+      recent_.pop_back();
+    }
+    values_[key] = value;
+    recent_.push_front(key);
+    positions_[key] = recent_.begin();
+    return value;
+  }
+
+  /**
+   * Returns the number of calls to Get finding the value in memory or being
+   * loaded by another call.
+   */
+  size_t hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+  }
+
+  /**
+   * Returns the number of calls to Get loading the value.
+   */
+  size_t misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+  }
+
+  /**
+   * Returns the number of values in memory.
+   */
+  size_t resident() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return recent_.size();
+  }
+
+  /**
+   * Returns the maximum number of values in memory.
+   */
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  /**
+   * Calls fun with each value in memory.
+   */
+  template<class Function>
+  void ForEachResident(Function fun) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t key : recent_)
+      fun(*values_[key]);
+  }
+
+ private:
+  /** Values in memory, indexed by key. */
+  std::vector<std::shared_ptr<T>> values_;
+  /** Values being loaded, indexed by key. Invalid if it is not loading. */
+  std::vector<std::shared_future<std::shared_ptr<T>>> loading_;
+  /** Keys in memory, the most recently used first. */
+  std::list<size_t> recent_;
+  /** Position of each key in memory in recent_. */
+  std::vector<std::list<size_t>::iterator> positions_;
+  /** Maximum number of values in memory. */
+  size_t capacity_;
+  /** Function loading the values. */
+  Loader load_;
+  /** Number of hits. */
+  size_t hits_;
+  /** Number of misses. */
+  size_t misses_;
+  /** Protects all the members above. */
+  mutable std::mutex mutex_;
+};
+
+}  // namespace utils
+}  // namespace libk2tree
+#endif  // INCLUDE_UTILS_LRU_CACHE_H_
@@ -0,0 +1,163 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Read only files mapped in memory.
+ */
+
+#ifndef INCLUDE_UTILS_MAPPED_FILE_H_
+#define INCLUDE_UTILS_MAPPED_FILE_H_
+
+#include <libk2tree_basic.h>
+#include <utils/utils.h>
+#include <cstring>
+#include <memory>
+#include <string>
+
+namespace libk2tree {
+namespace utils {
+
+/**
+ * File mapped in memory for reading. The pages are shared with the page
+ * cache, so processes mapping the same file share the memory, and they are
+ * loaded only when accessed.
+ */
+class MappedFile {
+ public:
+  /**
+   * Maps the whole file.
+   *
+   * @param path Path of the file.
+   */
+  explicit MappedFile(const std::string &path);
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile();
+
+  /**
+   * Returns a pointer to the first byte of the file.
+   */
+  const char *data() const {
+    return data_;
+  }
+
+  /**
+   * Returns the size of the file in bytes.
+   */
+  size_t size() const {
+    return size_;
+  }
+
+ private:
+  /** First byte of the mapping. */
+  const char *data_;
+  /** Size of the file. */
+  size_t size_;
+};
+
+/**
+ * Reads sequentially the values of a mapped file, in the same order they
+ * are read from a stream with LoadValue. Arrays saved with SaveAligned can
+ * be used in place with View, the object using them must keep a reference
+ * to the file.
+ */
+class MappedReader {
+ public:
+  /**
+   * @param file Mapped file.
+   * @param offset Position of the first value to read.
+   */
+  explicit MappedReader(std::shared_ptr<MappedFile> file, size_t offset = 0)
+      : file_(file),
+        offset_(offset) {}
+
+  /**
+   * Reads a value and advances past it.
+   * The type must be TriviallyCopyable
+   */
+  template<typename T>
+  T Read() {
+    T ret;
+    memcpy(&ret, Advance(sizeof(T)), sizeof(T));
+    return ret;
+  }
+
+  /**
+   * Returns a pointer to an array saved with SaveAligned and advances past
+   * it. The array remains valid while the file is mapped.
+   *
+   * @param length Number of values in the array.
+   * @return Pointer to the first value.
+   */
+  template<typename T>
+  const T *View(size_t length) {
+    offset_ += (kFileAlignment - offset_%kFileAlignment) % kFileAlignment;
+    return reinterpret_cast<const T*>(Advance(length*sizeof(T)));
+  }
+
+  /**
+   * Returns the mapped file.
+   */
+  const std::shared_ptr<MappedFile> &file() const {
+    return file_;
+  }
+
+  /**
+   * Returns the position of the next value to read.
+   */
+  size_t offset() const {
+    return offset_;
+  }
+
+  /**
+   * Moves the position of the next value to read.
+   *
+   * @param offset New position.
+   */
+  void Seek(size_t offset) {
+    offset_ = offset;
+  }
+
+ private:
+  /** Mapped file. */
+  std::shared_ptr<MappedFile> file_;
+  /** Position of the next value to read. */
+  size_t offset_;
+
+  /**
+   * Returns a pointer to the current position and advances the given
+   * number of bytes.
+   */
+  const char *Advance(size_t bytes);
+};
+
+/**
+ * Loads a value from a mapped file.
+ * The type must be TriviallyCopyable
+ */
+template <typename T>
+T LoadValue(MappedReader *in) {
+  return in->Read<T>();
+}
+
+/**
+ * Loads len values from a mapped file, copying them into a new array.
+ * The type must be TriviallyCopyable
+ */
+template <typename T>
+T *LoadValue(MappedReader *in, size_t length) {
+  T *ret = new T[length];
+  for (size_t i = 0; i < length; ++i)
+    ret[i] = in->Read<T>();
+  return ret;
+}
+
+}  // namespace utils
+}  // namespace libk2tree
+#endif  // INCLUDE_UTILS_MAPPED_FILE_H_
@@ -0,0 +1,229 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Static bit array with rank support.
+ */
+
+#ifndef INCLUDE_UTILS_RANK_BITARRAY_H_
+#define INCLUDE_UTILS_RANK_BITARRAY_H_
+
+#include <libk2tree_basic.h>
+#include <utils/bitarray.h>
+#include <utils/utils.h>
+#include <utils/mapped_file.h>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+namespace libk2tree {
+namespace utils {
+
+/**
+ * Static bit array answering access and rank in constant time. Bits are
+ * stored in cache lines of 64 bytes: the first word of a line holds the
+ * number of ones before the line and the remaining seven words hold 448
+ * bits. A rank therefore touches a single cache line, the same one holding
+ * the accessed bit, so both can be answered at once with AccessRank.
+ */
+class RankBitArray {
+ public:
+  /**
+   * Builds the structure with the bits of the given array.
+   *
+   * @param bits Bit array to copy.
+   */
+  explicit RankBitArray(const BitArray<uint> &bits);
+
+  /**
+   * Loads the structure from a file.
+   *
+   * @param in Input stream.
+   * @see RankBitArray::Save
+   */
+  explicit RankBitArray(ifstream *in);
+
+  /**
+   * Loads the structure from a file saved before the file header, which
+   * stored the bits as a libcds BitSequenceOneLevelRank.
+   *
+   * @param in Input stream.
+   */
+  RankBitArray(ifstream *in, LegacyFormat);
+
+  /**
+   * Loads the structure from a mapped file. The lines are used in place.
+   *
+   * @param in Reader pointing to the structure.
+   * @see RankBitArray::Save
+   */
+  explicit RankBitArray(MappedReader *in);
+
+  RankBitArray(const RankBitArray &) = delete;
+  RankBitArray &operator=(const RankBitArray &) = delete;
+
+  ~RankBitArray();
+
+  /**
+   * Saves the structure to a file.
+   *
+   * @param out Output stream.
+   */
+  void Save(ofstream *out) const;
+
+  /**
+   * Returns the bit at the given position.
+   *
+   * @param i Position.
+   * @return True if the bit is 1, false otherwise.
+   */
+  bool Access(size_t i) const {
+    const uint64_t *line = data_ + i/kLineBits*kLineWords;
+    size_t offset = i % kLineBits;
+    return (line[1 + offset/64] >> (offset % 64)) & 1;
+  }
+
+  /**
+   * Returns the bit at the given position and the number of ones before it.
+   *
+   * @param i Position.
+   * @param rank Pointer to store the number of ones in [0, i).
+   * @return True if the bit is 1, false otherwise.
+   */
+  bool AccessRank(size_t i, size_t *rank) const {
+    const uint64_t *line = data_ + i/kLineBits*kLineWords;
+    size_t offset = i % kLineBits;
+    uint word = (uint) (offset/64);
+    uint bit = (uint) (offset % 64);
+
+    size_t r = line[0];
+    for (uint w = 0; w < word; ++w)
+      r += (size_t) __builtin_popcountll(line[1 + w]);
+    uint64_t bits = line[1 + word];
+    r += (size_t) __builtin_popcountll(bits & ((1ULL << bit) - 1));
+    *rank = r;
+    return (bits >> bit) & 1;
+  }
+
+  /**
+   * Returns the number of ones until the given position, inclusive.
+   *
+   * @param i Position.
+   * @return Number of ones in [0, i].
+   */
+  size_t Rank1(size_t i) const {
+    size_t rank;
+    bool bit = AccessRank(i, &rank);
+    return rank + bit;
+  }
+
+  /**
+   * Requests the cache line holding the given position, without waiting
+   * for it.
+   *
+   * @param i Position.
+   */
+  void Prefetch(size_t i) const {
+    __builtin_prefetch(data_ + i/kLineBits*kLineWords);
+  }
+
+  /**
+   * Returns the number of bits in the array.
+   */
+  size_t GetLength() const {
+    return length_;
+  }
+
+  /**
+   * Returns memory usage.
+   *
+   * @return Size in bytes.
+   */
+  size_t GetSize() const;
+
+  /**
+   * Writes the structure to a file appending its bits in order, without
+   * keeping it in memory. The ranks are computed while the bits are
+   * appended, so the result is the same file written by Save.
+   */
+  class Writer {
+   public:
+    /**
+     * Writes the beginning of the structure.
+     *
+     * @param out Output stream.
+     * @param length Number of bits that will be appended.
+     */
+    Writer(ofstream *out, size_t length);
+
+    /**
+     * Appends bits to the array.
+     *
+     * @param bits Word with the bits, the first one being the least
+     * significant.
+     * @param len Number of bits, at most 64.
+     */
+    void Append(uint64_t bits, uint len);
+
+    /**
+     * Writes the pending lines. All bits must have been appended.
+     */
+    void Finish();
+
+   private:
+    /** Lines kept before writing them. */
+    static const size_t kBufferLines = 1 << 12;
+
+    /** Output stream. */
+    ofstream *out_;
+    /** Number of bits of the array. */
+    size_t length_;
+    /** Number of bits appended. */
+    size_t pos_;
+    /** Number of ones appended. */
+    size_t rank_;
+    /** Number of lines written. */
+    size_t lines_;
+    /** Lines not yet written, the last one may be incomplete. */
+    std::vector<uint64_t> buffer_;
+
+    /**
+     * Starts a line after the last one, writing the buffer if it is full.
+     */
+    void NewLine();
+  };
+
+ private:
+  /** Words of 64 bits in a line. */
+  static const uint kLineWords = 8;
+  /** Bits of the array stored in a line. */
+  static const uint kLineBits = 64*(kLineWords - 1);
+
+  /** Number of bits. */
+  size_t length_;
+  /** Number of lines. */
+  size_t lines_;
+  /**
+   * Allocated memory, data_ is aligned to a cache line inside it. It is
+   * NULL when data_ points to a mapped file.
+   */
+  uint64_t *raw_;
+  /** Lines with the ranks and the bits. */
+  uint64_t *data_;
+  /** Mapped file holding data_, if any. */
+  std::shared_ptr<MappedFile> file_;
+
+  /**
+   * Allocates the lines for length_ bits.
+   */
+  void Allocate();
+};
+
+}  // namespace utils
+}  // namespace libk2tree
+#endif  // INCLUDE_UTILS_RANK_BITARRAY_H_
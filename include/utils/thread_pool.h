@@ -0,0 +1,117 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef INCLUDE_UTILS_THREAD_POOL_H_
+#define INCLUDE_UTILS_THREAD_POOL_H_
+
+#include <libk2tree_basic.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libk2tree {
+namespace utils {
+
+/**
+ * Fixed set of threads running tasks with work stealing. Each thread has its
+ * own queue; it runs the tasks in its queue and when it is empty takes tasks
+ * from the queues of the other threads.
+ */
+class ThreadPool {
+ public:
+  /**
+   * Starts the threads.
+   *
+   * @param threads Number of threads. If 0 uses one for each hardware thread.
+   */
+  explicit ThreadPool(uint threads = 0);
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  /**
+   * Waits for the queued tasks and stops the threads.
+   */
+  ~ThreadPool();
+
+  /**
+   * Returns the number of threads.
+   */
+  uint threads() const {
+    return (uint) workers_.size();
+  }
+
+  /**
+   * Calls fun(i) for each i in [0, n) using the threads of the pool and
+   * returns after all calls are done. The calling thread runs tasks while
+   * waiting, so it can be used from inside a task.
+   *
+   * @param n Number of calls.
+   * @param fun Function expecting a parameter of type size_t. It may be
+   * called concurrently.
+   */
+  void ParallelFor(size_t n, const std::function<void(size_t)> &fun);
+
+  /**
+   * Queues a task to be run by one of the threads and returns immediately.
+   * The destructor waits for all the queued tasks.
+   *
+   * @param task Function without parameters.
+   */
+  void Submit(std::function<void()> task);
+
+ private:
+  /** Tasks of a thread. */
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  /** One queue for each thread. */
+  std::vector<std::unique_ptr<Queue>> queues_;
+  /** Threads of the pool. */
+  std::vector<std::thread> workers_;
+  /** Number of queued tasks, changed holding the lock of their queue. */
+  std::atomic<size_t> pending_;
+  /** Number of tasks submitted, used to pick the queue of the next one. */
+  std::atomic<size_t> submitted_;
+  /** Protects stop_ and is used to sleep while there are no tasks. */
+  std::mutex mutex_;
+  /** Signaled when a task is queued or the pool is stopped. */
+  std::condition_variable wake_;
+  /** Whether the threads must exit. */
+  bool stop_;
+
+  /**
+   * Adds a task to the back of queue q.
+   */
+  void Push(size_t q, std::function<void()> task);
+
+  /**
+   * Takes a task from the back of queue q, or from the front of another
+   * queue if it is empty.
+   *
+   * @return false if all queues are empty.
+   */
+  bool Pop(size_t q, std::function<void()> *task);
+
+  /**
+   * Loop run by the thread owning queue q.
+   */
+  void Work(size_t q);
+};
+
+}  // namespace utils
+}  // namespace libk2tree
+#endif  // INCLUDE_UTILS_THREAD_POOL_H_
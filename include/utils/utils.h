@@ -106,6 +106,70 @@ T *LoadValue(ifstream *in, size_t length) {
   return ret;
 }
 
+/**
+ * Alignment in bytes of the large arrays stored in a file. These arrays
+ * start at a position of the file multiple of this value, so they can be
+ * used in place when the file is mapped in memory.
+ */
+const size_t kFileAlignment = 64;
+
+/**
+ * Writes zeros until the position of the stream is a multiple of
+ * kFileAlignment.
+ */
+void AlignStream(ofstream *out);
+
+/**
+ * Skips the padding written by AlignStream(ofstream*).
+ */
+void AlignStream(ifstream *in);
+
+/**
+ * Saves len values into an ofstream at an aligned position.
+ * The type must be TriviallyCopyable
+ *
+ * @see kFileAlignment
+ */
+template <typename T>
+void SaveAligned(ofstream *out, T *val, size_t length) {
+  AlignStream(out);
+  SaveValue(out, val, length);
+}
+
+/**
+ * Loads len values saved with SaveAligned.
+ * The type must be TriviallyCopyable
+ */
+template <typename T>
+T *LoadAligned(ifstream *in, size_t length) {
+  AlignStream(in);
+  return LoadValue<T>(in, length);
+}
+
+/**
+ * Calls a function used as callback in a query. The function may return
+ * nothing or a value convertible to bool, in which case returning false
+ * requests the query to stop.
+ *
+ * @return False if the function requested to stop, true otherwise.
+ */
+template<class Function, class... Args>
+inline typename std::enable_if<
+    std::is_void<typename std::result_of<Function&(Args...)>::type>::value,
+    bool>::type
+Visit(Function &fun, Args... args) {
+  fun(args...);
+  return true;
+}
+
+template<class Function, class... Args>
+inline typename std::enable_if<
+    !std::is_void<typename std::result_of<Function&(Args...)>::type>::value,
+    bool>::type
+Visit(Function &fun, Args... args) {
+  return static_cast<bool>(fun(args...));
+}
+
 /**
  * Find the smallest prime greater or equal to n
  */
@@ -0,0 +1,310 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#include <builder/external_k2tree_builder.h>
+#include <utils/utils.h>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <utility>
+
+namespace libk2tree {
+using utils::Ceil;
+using utils::SaveValue;
+using boost::filesystem::unique_path;
+
+namespace {
+
+/**
+ * Reads the keys of a run in blocks.
+ */
+class RunReader {
+ public:
+  RunReader(const path &run, size_t block)
+      : in_(run.native(), std::ifstream::binary),
+        buffer_(block),
+        pos_(0),
+        size_(0) {
+    if (!in_) {
+      std::cerr << "[ExternalK2TreeBuilder] Error: Could not open " << run
+                << std::endl;
+      exit(1);
+    }
+    Fill();
+  }
+
+  bool Empty() const {
+    return pos_ == size_;
+  }
+
+  uint64_t Front() const {
+    return buffer_[pos_];
+  }
+
+  void Pop() {
+    if (++pos_ == size_)
+      Fill();
+  }
+
+ private:
+  std::ifstream in_;
+  std::vector<uint64_t> buffer_;
+  size_t pos_, size_;
+
+  void Fill() {
+    in_.read(reinterpret_cast<char *>(buffer_.data()),
+             (std::streamsize) (buffer_.size()*sizeof(uint64_t)));
+    size_ = (size_t) in_.gcount()/sizeof(uint64_t);
+    pos_ = 0;
+  }
+};
+
+/**
+ * Writes the bits of a level, given the positions of its ones in
+ * increasing order.
+ */
+class LevelWriter {
+ public:
+  explicit LevelWriter(const path &file)
+      : file_(file),
+        out_(file.native(), std::ofstream::binary),
+        word_(0),
+        index_(0) {}
+
+  void Set(size_t pos) {
+    while (index_ < pos/64) {
+      SaveValue(&out_, word_);
+      word_ = 0;
+      ++index_;
+    }
+    word_ |= 1ULL << (pos % 64);
+  }
+
+  /**
+   * Writes the remaining words of a level with the given number of bits.
+   */
+  void Close(size_t length) {
+    while (index_ < Ceil<size_t>(length, 64)) {
+      SaveValue(&out_, word_);
+      word_ = 0;
+      ++index_;
+    }
+    out_.close();
+    if (!out_) {
+      std::cerr << "[ExternalK2TreeBuilder] Error: Could not write " << file_
+                << std::endl;
+      exit(1);
+    }
+  }
+
+ private:
+  path file_;
+  std::ofstream out_;
+  uint64_t word_;
+  size_t index_;
+};
+
+}  // namespace
+
+ExternalK2TreeBuilder::ExternalK2TreeBuilder(cnt_size cnt,
+                                             uint k1, uint k2, uint kL,
+                                             uint k1_levels,
+                                             const path &tmp_dir,
+                                             size_t memory, uint fan_in)
+    : cnt_(cnt),
+      k1_(k1),
+      k2_(k2),
+      kL_(kL),
+      max_level_k1_(k1_levels - 1),
+      shape_(cnt, k1, k2, kL, k1_levels),
+      key_(shape_.size(), k1, k2, kL, k1_levels - 1, shape_.height()),
+      tmp_dir_(tmp_dir),
+      memory_(std::max<size_t>(memory, sizeof(uint64_t))),
+      fan_in_(std::max(fan_in, 2u)) {
+  if (shape_.size() > ((cnt_size) 1 << 32)) {
+    std::cerr << "[ExternalK2TreeBuilder] Error: Matrix too large"
+              << std::endl;
+    exit(1);
+  }
+  buffer_.reserve(memory_/sizeof(uint64_t));
+}
+
+void ExternalK2TreeBuilder::AddLink(cnt_size p, cnt_size q) {
+  buffer_.push_back(key_(p, q));
+  if (buffer_.size() == buffer_.capacity())
+    Spill();
+}
+
+void ExternalK2TreeBuilder::Spill() {
+  std::sort(buffer_.begin(), buffer_.end());
+  buffer_.erase(std::unique(buffer_.begin(), buffer_.end()), buffer_.end());
+
+  path run = Temporary();
+  runs_.push_back(run);
+  std::ofstream out(run.native(), std::ofstream::binary);
+  SaveValue(&out, buffer_.data(), buffer_.size());
+  out.close();
+  if (!out) {
+    std::cerr << "[ExternalK2TreeBuilder::Spill] Error: Could not write "
+              << run << std::endl;
+    exit(1);
+  }
+  buffer_.clear();
+}
+
+void ExternalK2TreeBuilder::ReduceRuns() {
+  while (runs_.size() > fan_in_) {
+    std::vector<path> group(runs_.begin(), runs_.begin() + fan_in_);
+    path run = Temporary();
+    runs_.push_back(run);
+    std::ofstream out(run.native(), std::ofstream::binary);
+    Merge(group, [&] (uint64_t key) {
+      SaveValue(&out, key);
+    });
+    out.close();
+    if (!out) {
+      std::cerr << "[ExternalK2TreeBuilder::ReduceRuns] Error: Could not "
+                << "write " << run << std::endl;
+      exit(1);
+    }
+    for (const path &merged : group)
+      remove(merged);
+    runs_.erase(runs_.begin(), runs_.begin() + fan_in_);
+  }
+}
+
+template<class Function>
+void ExternalK2TreeBuilder::Merge(const std::vector<path> &runs,
+                                  Function fun) const {
+  size_t block = std::max<size_t>(memory_/sizeof(uint64_t)/runs.size(), 1);
+  std::vector<std::unique_ptr<RunReader>> readers;
+  for (const path &run : runs)
+    readers.emplace_back(new RunReader(run, block));
+
+  // Smallest key of each run not yet reported.
+  typedef std::pair<uint64_t, size_t> Entry;
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+  for (size_t r = 0; r < readers.size(); ++r)
+    if (!readers[r]->Empty())
+      heap.emplace(readers[r]->Front(), r);
+
+  bool first = true;
+  uint64_t last = 0;
+  while (!heap.empty()) {
+    Entry e = heap.top();
+    heap.pop();
+    if (first || e.first != last)
+      fun(e.first);
+    first = false;
+    last = e.first;
+
+    RunReader &reader = *readers[e.second];
+    reader.Pop();
+    if (!reader.Empty())
+      heap.emplace(reader.Front(), e.second);
+  }
+}
+
+void ExternalK2TreeBuilder::Build(std::ofstream *out) {
+  uint height = shape_.height();
+  // When all links fit in the buffer they are not written to a run.
+  if (!runs_.empty()) {
+    if (!buffer_.empty())
+      Spill();
+    ReduceRuns();
+    std::vector<uint64_t>().swap(buffer_);
+  }
+
+  std::vector<std::unique_ptr<LevelWriter>> writers;
+  for (uint level = 0; level < height; ++level) {
+    levels_.push_back(Temporary());
+    writers.emplace_back(new LevelWriter(levels_.back()));
+  }
+
+  // Nodes of each level found so far; the last one is the node of the
+  // previous key.
+  std::vector<size_t> nodes(height, 0);
+  size_t links = 0;
+  uint64_t last = 0;
+  auto add = [&] (uint64_t key) {
+    for (uint level = 0; level < height; ++level) {
+      if (links == 0 ||
+          (level > 0 && key_.Node(key, level) != key_.Node(last, level)))
+        ++nodes[level];
+      writers[level]->Set((nodes[level] - 1)*key_.arity(level) +
+                          key_.Child(key, level));
+    }
+    last = key;
+    ++links;
+  };
+  if (runs_.empty()) {
+    std::vector<uint64_t> keys;
+    keys.swap(buffer_);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    std::for_each(keys.begin(), keys.end(), add);
+  } else {
+    Merge(runs_, add);
+  }
+  for (uint level = 0; level < height; ++level)
+    writers[level]->Close(nodes[level]*key_.arity(level));
+  writers.clear();
+  for (const path &run : runs_)
+    remove(run);
+  runs_.clear();
+
+  if (links == 0) {
+    HybridK2Tree(cnt_, shape_.size()).Save(out);
+  } else {
+    HybridK2Tree::Writer writer(out, k1_, k2_, kL_, max_level_k1_, height,
+                                cnt_, shape_.size(), links, nodes);
+    std::vector<uint64_t> words(1 << 16);
+    for (uint level = 0; level < height; ++level) {
+      size_t length = nodes[level]*key_.arity(level);
+      std::ifstream in(levels_[level].native(), std::ifstream::binary);
+      for (size_t pos = 0; pos < length;) {
+        in.read(reinterpret_cast<char *>(words.data()),
+                (std::streamsize) (words.size()*sizeof(uint64_t)));
+        size_t cnt = (size_t) in.gcount()/sizeof(uint64_t);
+        if (cnt == 0) {
+          std::cerr << "[ExternalK2TreeBuilder::Build] Error: Could not read "
+                    << levels_[level] << std::endl;
+          exit(1);
+        }
+        for (size_t w = 0; w < cnt && pos < length; ++w, pos += 64) {
+          uint len = (uint) std::min<size_t>(64, length - pos);
+          if (level < height - 1)
+            writer.AppendT(words[w], len);
+          else
+            writer.AppendL(words[w], len);
+        }
+      }
+    }
+    writer.Finish();
+  }
+  for (const path &level : levels_)
+    remove(level);
+  levels_.clear();
+  buffer_.reserve(memory_/sizeof(uint64_t));
+}
+
+path ExternalK2TreeBuilder::Temporary() const {
+  return unique_path(tmp_dir_ / "k2tree-%%%%-%%%%-%%%%-%%%%");
+}
+
+ExternalK2TreeBuilder::~ExternalK2TreeBuilder() {
+  for (const path &run : runs_)
+    remove(run);
+  for (const path &level : levels_)
+    remove(level);
+}
+
+}  // namespace libk2tree
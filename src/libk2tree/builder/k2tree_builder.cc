@@ -9,11 +9,17 @@
  */
 
 #include <builder/k2tree_builder.h>
+#include <builder/link_key.h>
 #include <utils/utils.h>
 #include <utils/bitarray.h>
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
 
 namespace libk2tree {
 using utils::Pow;
+using utils::Ceil;
 using utils::LogCeil;
 using utils::BitArray;
 
@@ -31,20 +37,24 @@ K2TreeBuilder::K2TreeBuilder(cnt_size cnt,
       leaves_(0),
       links_(0),
       internal_nodes_(0),  // we do not consider the root
-      root_(NULL) {
+      leaf_slab_((kL*kL + kUcharBits - 1)/kUcharBits) {
   assert(k1 != 0 && k2 != 0 && kL_ != 0 && k1_levels != 0);
   // we extend the size of the matrix to be the product of the arities in all
   // levels (section 5.1). There are k1_levels levels with arity k1, one with
   // arity kL and we must find the numbers of levels with arity k2, ie, the
   // smallest integer x that satisfies:
   // k1^k1_levels * k2^x * kL >= cnt.
-  uint powk1 = Pow<uint>(k1, k1_levels);
+  cnt_size powk1 = Pow<cnt_size>(k1, k1_levels);
   uint x = LogCeil((double)cnt/powk1/kL, k2);
   if (x == 0)
     fprintf(stderr, "[K2TreeBuilder] Warning: Ignoring levels with arity k2.\n");
 
   height_ = k1_levels + x + 1;
-  size_ = powk1 * Pow<uint>(k2, x) * kL;
+  size_ = powk1 * Pow<cnt_size>(k2, x) * kL;
+  for (uint level = 0; level < height_ - 1; ++level) {
+    uint k = level <= max_level_k1_ ? k1_ : k2_;
+    internal_slabs_.emplace_back(k*k);
+  }
 }
 K2TreeBuilder::K2TreeBuilder(K2TreeBuilder &&lhs) noexcept
     : cnt_(lhs.cnt_),
@@ -57,18 +67,18 @@ K2TreeBuilder::K2TreeBuilder(K2TreeBuilder &&lhs) noexcept
       leaves_(lhs.leaves_),
       links_(lhs.links_),
       internal_nodes_(lhs.internal_nodes_),
-      root_(lhs.root_) {
-  lhs.root_ = NULL;
-  internal_nodes_ = 0;
-  links_ = 0;
-  leaves_ = 0;
+      internal_slabs_(std::move(lhs.internal_slabs_)),
+      leaf_slab_(std::move(lhs.leaf_slab_)) {
+  lhs.internal_nodes_ = 0;
+  lhs.links_ = 0;
+  lhs.leaves_ = 0;
 }
 
 
 void K2TreeBuilder::AddLink(cnt_size p, cnt_size q) {
-  if (root_ == NULL)
-    root_ = CreateNode(0);
-  Node *n = root_;
+  if (internal_slabs_[0].size() == 0)
+    CreateNode(0);
+  uint32_t n = 0;
   cnt_size N = size_, div_level;
   uint child;
   for (uint level = 0; level < height_ - 1; level++) {
@@ -77,73 +87,65 @@ void K2TreeBuilder::AddLink(cnt_size p, cnt_size q) {
 
     child = (uint) (p/div_level * k + q/div_level);
 
-    if (n->children_[child] == NULL)
-        n->children_[child] = CreateNode(level + 1);
+    // Slabs never move their nodes, so the reference survives CreateNode.
+    uint32_t &next = internal_slabs_[level].At(n)[child];
+    if (next == 0)
+        next = CreateNode(level + 1) + 1;
 
-    n = n->children_[child];
+    n = next - 1;
     N = div_level, p %= div_level, q %= div_level;
   }
   // n is a node on the level height_ - 1. In this level
-  // we store the children information in a BitArray (the leaves)
+  // we store the children information in a bitmap (the leaves)
   div_level = N/kL_;
   child = (uint) (p/div_level*kL_ + q/div_level);
-  if (!n->data_->GetBit(child))
+  uchar &byte = leaf_slab_.At(n)[child/kUcharBits];
+  uchar bit = (uchar) (1 << (child%kUcharBits));
+  if (!(byte & bit))
     links_++;
-  n->data_->SetBit(child);
+  byte |= bit;
 }
 
 
 std::shared_ptr<HybridK2Tree> K2TreeBuilder::Build() const {
   try {
-    if (root_ == NULL)
+    if (internal_slabs_[0].size() == 0)
       return std::shared_ptr<HybridK2Tree>(new HybridK2Tree(cnt_, size_));
 
     BitArray<uint> T(internal_nodes_);
     BitArray<uint> L(leaves_);
-    
-    std::queue<Node*> q;
-    q.push(root_);
 
-    uint cnt_level;
-    uint level;
+    // Nodes of the current level in breadth first order.
+    std::vector<uint32_t> nodes(1, 0), next;
 
     // Position on the bitmap T
     size_t pos = 0;
-    for (level = 0; level < height_-1; ++level) {
+    for (uint level = 0; level < height_-1; ++level) {
       uint k = level <= max_level_k1_ ? k1_ : k2_;
-      cnt_level = (uint) q.size();
-      for (uint i = 0; i < cnt_level; ++i) {
-        Node *n = q.front(); q.pop();
-        if (n != NULL) {
-          if (level > 0)  // if not the root
+      next.clear();
+      for (uint32_t n : nodes) {
+        const uint32_t *children = internal_slabs_[level].At(n);
+        for (uint child = 0; child < k*k; ++child, ++pos) {
+          if (children[child] != 0) {
             T.SetBit(pos);
-
-          for (uint child = 0; child < k*k; ++child)
-            q.push(n->children_[child]);
+            next.push_back(children[child] - 1);
+          }
         }
-        if (level > 0)
-          ++pos;
       }
+      nodes.swap(next);
     }
 
-    // Visiting nodes in levels height - 1 and height
+    // Visiting nodes in level height - 1
     size_t leaf_pos = 0;
-    cnt_level = (uint) q.size();
-    for (uint i = 0; i < cnt_level; ++i) {
-      Node *n = q.front(); q.pop();
-      if (n != NULL) {
-        T.SetBit(pos);
-        for (uint child = 0; child < kL_*kL_; ++child) {
-          if (n->data_->GetBit(child))
-            L.SetBit(leaf_pos);
-          ++leaf_pos;
-        }
-      }
-      ++pos;
+    for (uint32_t n : nodes) {
+      const uchar *data = leaf_slab_.At(n);
+      for (uint child = 0; child < kL_*kL_; ++child, ++leaf_pos)
+        if (data[child/kUcharBits] & (1 << (child%kUcharBits)))
+          L.SetBit(leaf_pos);
     }
 
-    HybridK2Tree *tree = new HybridK2Tree(T, L, k1_, k2_, kL_,
-                                          max_level_k1_,
+    HybridK2Tree *tree = new HybridK2Tree(std::move(T), std::move(L),
+                                          k1_, k2_, kL_, max_level_k1_,
                                           height_, cnt_, size_, links_);
     return std::shared_ptr<HybridK2Tree>(tree);
   } catch(std::bad_alloc ba) {
@@ -156,33 +158,100 @@ std::shared_ptr<HybridK2Tree> K2TreeBuilder::Build() const {
 }
 
 
+std::shared_ptr<HybridK2Tree> K2TreeBuilder::BuildFromEdges(
+    cnt_size cnt, uint k1, uint k2, uint kL, uint k1_levels,
+    const std::pair<cnt_size, cnt_size> *begin,
+    const std::pair<cnt_size, cnt_size> *end) {
+  K2TreeBuilder b(cnt, k1, k2, kL, k1_levels);
+  uint height = b.height_;
+  if (begin == end)
+    return std::shared_ptr<HybridK2Tree>(new HybridK2Tree(cnt, b.size_));
+  if (b.size_ > ((cnt_size) 1 << 32)) {
+    // The path of a link doesn't fit in a LinkKey.
+    for (const std::pair<cnt_size, cnt_size> *e = begin; e < end; ++e)
+      b.AddLink(e->first, e->second);
+    return b.Build();
+  }
+
+  LinkKey key(b.size_, k1, k2, kL, b.max_level_k1_, height);
+  std::vector<uint64_t> keys;
+  keys.reserve((size_t) (end - begin));
+  for (const std::pair<cnt_size, cnt_size> *e = begin; e < end; ++e)
+    keys.push_back(key(e->first, e->second));
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
 
-void K2TreeBuilder::Clear() {
-  DeleteNode(root_, 0);
-  leaves_ = internal_nodes_ = links_ = 0;
-  root_ = NULL;
+  // Number of nodes in each level and their first bit in T or L.
+  std::vector<size_t> nodes(height, 1), start(height, 0);
+  for (uint level = 1; level < height; ++level) {
+    nodes[level] = 1;
+    for (size_t i = 1; i < keys.size(); ++i)
+      if (key.Node(keys[i], level) != key.Node(keys[i - 1], level))
+        ++nodes[level];
+  }
+  for (uint level = 1; level < height - 1; ++level)
+    start[level] = start[level - 1] + nodes[level - 1]*key.arity(level - 1);
+
+  BitArray<uint> T(start[height - 2] +
+                   nodes[height - 2]*key.arity(height - 2));
+  BitArray<uint> L(nodes[height - 1]*key.arity(height - 1));
+  for (uint level = 0; level < height; ++level) {
+    BitArray<uint> &bits = level < height - 1 ? T : L;
+    size_t node = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (level > 0 && i > 0 &&
+          key.Node(keys[i], level) != key.Node(keys[i - 1], level))
+        ++node;
+      bits.SetBit(start[level] + node*key.arity(level) +
+                  key.Child(keys[i], level));
+    }
+  }
+  size_t links = keys.size();
+  std::vector<uint64_t>().swap(keys);
+
+  HybridK2Tree *tree = new HybridK2Tree(std::move(T), std::move(L), k1, k2,
+                                        kL, b.max_level_k1_, height, cnt,
+                                        b.size_, links);
+  return std::shared_ptr<HybridK2Tree>(tree);
 }
 
+size_t K2TreeBuilder::MemoryBound(size_t links) const {
+  const size_t chunk = (size_t) 1 << Slab<uchar>::kChunkBits;
+  size_t bytes = 0, T = 0, L = 0;
+  size_t nodes = 1;
+  for (uint level = 0; level < height_; ++level) {
+    size_t k = level == height_ - 1 ? kL_ : level <= max_level_k1_ ? k1_ : k2_;
+    size_t block = level < height_ - 1 ? k*k*sizeof(uint32_t)
+                                       : Ceil<size_t>(k*k, kUcharBits);
+    // Slabs allocate whole chunks.
+    bytes += Ceil(nodes, chunk)*chunk*block;
+    (level < height_ - 1 ? T : L) += nodes*k*k;
+    nodes = std::min(links, nodes*k*k);
+  }
+  // Build holds T, L and the rank structure made from T, which adds a word
+  // every seven.
+  T = Ceil<size_t>(T, kUcharBits);
+  L = Ceil<size_t>(L, kUcharBits);
+  return bytes + 2*T + T/7 + L;
+}
 
-K2TreeBuilder::~K2TreeBuilder() {
-  DeleteNode(root_, 0);
+void K2TreeBuilder::Clear() {
+  for (Slab<uint32_t> &slab : internal_slabs_)
+    slab.Clear();
+  leaf_slab_.Clear();
+  leaves_ = internal_nodes_ = links_ = 0;
 }
 
 
-K2TreeBuilder::Node *K2TreeBuilder::CreateNode(uint level) {
+uint32_t K2TreeBuilder::CreateNode(uint level) {
   try {
-    K2TreeBuilder::Node *n = new K2TreeBuilder::Node;
     if (level < height_ - 1) {
       uint k = level <= max_level_k1_ ? k1_ : k2_;
-      n->children_ = new Node*[k*k];
-      for (uint i = 0; i < k*k; ++i)
-        n->children_[i] = NULL;
       internal_nodes_ += k*k;
-    } else {
-      n->data_ = new BitArray<uchar>(kL_*kL_);
-      leaves_ += kL_*kL_;
+      return internal_slabs_[level].Allocate();
     }
-    return n;
+    leaves_ += kL_*kL_;
+    return leaf_slab_.Allocate();
   } catch (std::bad_alloc ba) {
     std::cerr << "[K2TreeBuilder::CreateNode] Error: " << ba.what() << "\n";
     exit(1);
@@ -192,20 +261,4 @@ K2TreeBuilder::Node *K2TreeBuilder::CreateNode(uint level) {
   }
 }
 
-
-void K2TreeBuilder::DeleteNode(K2TreeBuilder::Node *n, uint level) {
-  if (n == NULL)
-    return;
-
-  if (level < height_ - 1) {
-    uint k = level <= max_level_k1_ ? k1_ : k2_;
-    for (uint i = 0; i < k*k; ++i)
-      DeleteNode(n->children_[i], level+1);
-    delete [] n->children_;
-  } else {
-    delete n->data_;
-  }
-  delete n;
-}
-
 }  // namespace libk2tree
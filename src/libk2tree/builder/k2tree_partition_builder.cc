@@ -33,10 +33,9 @@ K2TreePartitionBuilder::K2TreePartitionBuilder(cnt_size cnt,
       builder_(submatrix_size_, k1, k2, kl, k1_levels),
       tmp_(unique_path(file.parent_path() / "%%%%%")),
       file_(file),
-      out_(tmp_.native()) {
-  SaveValue(&out_, cnt_);
-  SaveValue(&out_, submatrix_size_);
-  SaveValue(&out_, k0_);
+      out_(tmp_.native()),
+      writer_(&out_, kK2TreePartition, 1 + k0_*k0_) {
+  links_.reserve(k0_*k0_);
 }
 
 
@@ -49,7 +48,14 @@ void K2TreePartitionBuilder::AddLink(cnt_size p, cnt_size q) {
 
 void K2TreePartitionBuilder::BuildSubtree() {
   assert(!Ready());
-  builder_.Build(&out_);
+  // The first section needs the number of links of the subtrees, so it is
+  // written after them.
+  writer_.BeginSection(1 + row_*k0_ + col_);
+  std::shared_ptr<HybridK2Tree> tree = builder_.Build();
+  tree->Save(&out_, false);
+  writer_.EndSection();
+  links_.push_back(tree->links());
+  tree.reset();
   builder_.Clear();
 
   ++col_;
@@ -59,6 +65,13 @@ void K2TreePartitionBuilder::BuildSubtree() {
   }
   if (row_ >= k0_) {
     ready_ = true;
+    writer_.BeginSection(0);
+    SaveValue(&out_, cnt_);
+    SaveValue(&out_, submatrix_size_);
+    SaveValue(&out_, k0_);
+    SaveValue(&out_, links_.data(), links_.size());
+    writer_.EndSection();
+    writer_.Finish();
     out_.close();
     rename(tmp_, file_);
   }
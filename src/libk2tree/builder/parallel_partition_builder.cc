@@ -0,0 +1,165 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#include <builder/parallel_partition_builder.h>
+#include <utils/file_format.h>
+#include <utils/utils.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+namespace libk2tree {
+using utils::Ceil;
+using utils::SaveValue;
+using utils::FileWriter;
+using boost::filesystem::unique_path;
+using boost::filesystem::rename;
+
+ParallelPartitionBuilder::ParallelPartitionBuilder(cnt_size cnt,
+                                                   cnt_size submatrix_size,
+                                                   uint k1, uint k2, uint kl,
+                                                   uint k1_levels,
+                                                   const path &file,
+                                                   uint threads,
+                                                   size_t memory)
+    : cnt_(cnt),
+      submatrix_size_(submatrix_size),
+      k0_((uint) Ceil(cnt, submatrix_size)),
+      k1_(k1),
+      k2_(k2),
+      kl_(kl),
+      k1_levels_(k1_levels),
+      row_(0),
+      col_(0),
+      ready_(false),
+      file_(file),
+      segments_(k0_*k0_),
+      subtree_links_(k0_*k0_),
+      shape_(submatrix_size, k1, k2, kl, k1_levels),
+      memory_(memory),
+      used_(0),
+      pending_(0),
+      pool_(threads) {}
+
+void ParallelPartitionBuilder::AddLink(cnt_size p, cnt_size q) {
+  assert(p >= row_*submatrix_size_ && p < (row_+1)*submatrix_size_);
+  assert(q >= col_*submatrix_size_ && q < (col_+1)*submatrix_size_);
+  assert(!Ready());
+  links_.emplace_back(p - row_ * submatrix_size_, q - col_ * submatrix_size_);
+}
+
+void ParallelPartitionBuilder::BuildSubtree() {
+  assert(!Ready());
+  size_t bytes = links_.capacity()*sizeof(Link) +
+                 shape_.MemoryBound(links_.size());
+  {
+    // A submatrix larger than the budget is built alone.
+    std::unique_lock<std::mutex> lock(mutex_);
+    built_.wait(lock, [&] {
+      return pending_ == 0 || used_ + bytes <= memory_;
+    });
+    used_ += bytes;
+    ++pending_;
+  }
+
+  size_t t = row_*k0_ + col_;
+  path segment = unique_path(file_.parent_path() / "%%%%%");
+  segments_[t] = segment;
+  std::shared_ptr<std::vector<Link>> links =
+      std::make_shared<std::vector<Link>>();
+  links->swap(links_);
+  pool_.Submit([this, links, segment, bytes, t] () {
+    subtree_links_[t] = Build(*links, segment);
+    std::vector<Link>().swap(*links);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    used_ -= bytes;
+    --pending_;
+    built_.notify_all();
+  });
+
+  ++col_;
+  if (col_ >= k0_) {
+    col_ = 0;
+    ++row_;
+  }
+  if (row_ >= k0_) {
+    Wait();
+    Assemble();
+    ready_ = true;
+  }
+}
+
+size_t ParallelPartitionBuilder::Build(const std::vector<Link> &links,
+                                       const path &segment) const {
+  K2TreeBuilder builder(submatrix_size_, k1_, k2_, kl_, k1_levels_);
+  for (const Link &link : links)
+    builder.AddLink(link.first, link.second);
+
+  std::ofstream out(segment.native(), std::ofstream::binary);
+  std::shared_ptr<HybridK2Tree> tree = builder.Build();
+  tree->Save(&out, false);
+  out.close();
+  if (!out) {
+    std::cerr << "[ParallelPartitionBuilder::Build] Error: Could not write "
+              << segment << std::endl;
+    exit(1);
+  }
+  return tree->links();
+}
+
+void ParallelPartitionBuilder::Wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  built_.wait(lock, [&] { return pending_ == 0; });
+}
+
+void ParallelPartitionBuilder::Assemble() {
+  path tmp = unique_path(file_.parent_path() / "%%%%%");
+  std::ofstream out(tmp.native(), std::ofstream::binary);
+  FileWriter writer(&out, kK2TreePartition, 1 + k0_*k0_);
+  writer.BeginSection();
+  SaveValue(&out, cnt_);
+  SaveValue(&out, submatrix_size_);
+  SaveValue(&out, k0_);
+  SaveValue(&out, subtree_links_.data(), subtree_links_.size());
+  writer.EndSection();
+
+  // Segments start at offset 0, so the arrays aligned inside them remain
+  // aligned when copied to a section.
+  std::vector<char> buffer(1 << 20);
+  for (path &segment : segments_) {
+    std::ifstream in(segment.native(), std::ifstream::binary);
+    writer.BeginSection();
+    while (in) {
+      in.read(buffer.data(), (std::streamsize) buffer.size());
+      out.write(buffer.data(), in.gcount());
+    }
+    writer.EndSection();
+    in.close();
+    remove(segment);
+    segment.clear();
+  }
+  writer.Finish();
+  out.close();
+  if (!out) {
+    std::cerr << "[ParallelPartitionBuilder::Assemble] Error: Could not write "
+              << file_ << std::endl;
+    exit(1);
+  }
+  rename(tmp, file_);
+}
+
+ParallelPartitionBuilder::~ParallelPartitionBuilder() {
+  Wait();
+  for (const path &segment : segments_)
+    if (!segment.empty())
+      remove(segment);
+}
+
+}  // namespace libk2tree
@@ -12,9 +12,12 @@
 namespace libk2tree {
 using utils::LoadValue;
 using utils::SaveValue;
+using utils::FileWriter;
+using utils::FileLayout;
+using utils::SkipHeader;
 
 
-CompressedHybrid::CompressedHybrid(std::shared_ptr<BitSequence> T,
+CompressedHybrid::CompressedHybrid(std::shared_ptr<RankBitArray> T,
                                    FTRep *compressL,
                                    std::shared_ptr<Vocabulary> vocabulary,
                                    uint k1, uint k2, uint kL,
@@ -25,7 +28,7 @@ CompressedHybrid::CompressedHybrid(std::shared_ptr<BitSequence> T,
       vocabulary_(vocabulary) {}
 
 CompressedHybrid::CompressedHybrid(ifstream *in)
-    : base_hybrid(in),
+    : base_hybrid(SkipHeader(in, kCompressedHybrid)),
       compressL_(LoadFT(in)),
       vocabulary_(new Vocabulary(in)) {}
 
@@ -35,6 +38,49 @@ CompressedHybrid::CompressedHybrid(ifstream *in,
       compressL_(LoadFT(in)),
       vocabulary_(voc) {}
 
+CompressedHybrid::CompressedHybrid(MappedReader *in)
+    : base_hybrid(SkipHeader(in, kCompressedHybrid)),
+      compressL_(MapFT(in)),
+      vocabulary_(new Vocabulary(in)) {}
+
+CompressedHybrid::CompressedHybrid(MappedReader *in,
+                                   std::shared_ptr<Vocabulary> voc)
+    : base_hybrid(in),
+      compressL_(MapFT(in)),
+      vocabulary_(voc) {}
+
+CompressedHybrid::CompressedHybrid(ifstream *in, utils::LegacyFormat legacy)
+    : base_hybrid(in, legacy),
+      compressL_(LoadLegacyFT(in)),
+      vocabulary_(new Vocabulary(in, legacy)) {}
+
+CompressedHybrid::CompressedHybrid(ifstream *in,
+                                   std::shared_ptr<Vocabulary> voc,
+                                   utils::LegacyFormat legacy)
+    : base_hybrid(in, legacy),
+      compressL_(LoadLegacyFT(in)),
+      vocabulary_(voc) {}
+
+std::shared_ptr<CompressedHybrid> CompressedHybrid::Open(
+    const std::string &path, bool verify) {
+  MappedReader in(std::make_shared<MappedFile>(path));
+  if (verify)
+    FileLayout layout(&in, kCompressedHybrid, true);
+  in.Seek(0);
+  return std::shared_ptr<CompressedHybrid>(new CompressedHybrid(&in));
+}
+
+FTRep *CompressedHybrid::MapFT(MappedReader *in) {
+  size_t pos = in->offset();
+  FTRep *rep = ::MapFT(in->file()->data(), &pos);
+  if (pos > in->file()->size()) {
+    std::cerr << "[CompressedHybrid::MapFT] Error: Unexpected end of file\n";
+    exit(1);
+  }
+  in->Seek(pos);
+  return rep;
+}
+
 
 
 size_t CompressedHybrid::GetSize() const {
@@ -46,14 +92,24 @@ size_t CompressedHybrid::GetSize() const {
 
 
 void CompressedHybrid::Save(ofstream *out, bool save_voc) const {
-  base_hybrid::Save(out);
-  SaveFT(out, compressL_);
-  if (save_voc)
-    vocabulary_->Save(out);
+  if (!save_voc) {
+    base_hybrid::Save(out);
+    SaveFT(out, compressL_);
+    return;
+  }
+  FileWriter file(out, kCompressedHybrid, 1);
+  file.BeginSection();
+  Save(out, false);
+  vocabulary_->Save(out);
+  file.EndSection();
+  file.Finish();
 }
 
 CompressedHybrid::~CompressedHybrid() {
-  destroyFT(compressL_);
+  if (file_)
+    UnmapFT(compressL_);
+  else
+    destroyFT(compressL_);
 }
 
 bool CompressedHybrid::operator==(const CompressedHybrid &rhs) const {
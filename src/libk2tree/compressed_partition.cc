@@ -14,24 +14,82 @@
 namespace libk2tree {
 using utils::LoadValue;
 using utils::SaveValue;
+using utils::FileWriter;
 CompressedPartition::CompressedPartition(std::ifstream *in)
-    : base_partition(in),
-      vocabulary_(new Vocabulary(in)) {
+    : base_partition(in, kCompressedPartition, 2) {
+  layout_.Seek(in, 1);
+  vocabulary_ = std::make_shared<Vocabulary>(in);
   for (uint i = 0; i < k0_; ++i) {
     subtrees_[i].reserve(k0_);
-    for (uint j = 0; j < k0_; ++j)
+    for (uint j = 0; j < k0_; ++j) {
+      layout_.Seek(in, Section(2, i, j));
+      subtrees_[i].emplace_back(in, vocabulary_);
+    }
+  }
+}
+
+CompressedPartition::CompressedPartition(MappedReader *in)
+    : base_partition(in, kCompressedPartition, 2) {
+  layout_.Seek(in, 1);
+  vocabulary_ = std::make_shared<Vocabulary>(in);
+  for (uint i = 0; i < k0_; ++i) {
+    subtrees_[i].reserve(k0_);
+    for (uint j = 0; j < k0_; ++j) {
+      layout_.Seek(in, Section(2, i, j));
       subtrees_[i].emplace_back(in, vocabulary_);
+    }
   }
 }
 
+CompressedPartition::CompressedPartition(std::ifstream *in,
+                                         utils::LegacyFormat legacy)
+    : base_partition(in, legacy),
+      vocabulary_(std::make_shared<Vocabulary>(in, legacy)) {
+  for (uint i = 0; i < k0_; ++i) {
+    subtrees_[i].reserve(k0_);
+    for (uint j = 0; j < k0_; ++j)
+      subtrees_[i].emplace_back(in, vocabulary_, legacy);
+  }
+  CountSubtreeLinks();
+}
+
+CompressedPartition::CompressedPartition(const std::string &path,
+                                         size_t capacity)
+    : base_partition(path, kCompressedPartition, 2) {
+  layout_.Verify(stream_.get(), 1);
+  layout_.Seek(stream_.get(), 1);
+  vocabulary_ = std::make_shared<Vocabulary>(stream_.get());
+  std::shared_ptr<Vocabulary> voc = vocabulary_;
+  LoadLazily(2, capacity, [voc] (std::ifstream *in) {
+    return std::make_shared<CompressedHybrid>(in, voc);
+  });
+}
+
+std::shared_ptr<CompressedPartition> CompressedPartition::Open(
+    const std::string &path, bool verify) {
+  MappedReader in(std::make_shared<MappedFile>(path));
+  if (verify)
+    utils::FileLayout layout(&in, kCompressedPartition, true);
+  in.Seek(0);
+  return std::shared_ptr<CompressedPartition>(new CompressedPartition(&in));
+}
+
 void CompressedPartition::Save(std::ofstream *out) const {
+  FileWriter file(out, kCompressedPartition, 2 + k0_*k0_);
+  file.BeginSection();
   base_partition::Save(out);
+  file.EndSection();
+  file.BeginSection();
   vocabulary_->Save(out);
+  file.EndSection();
   for (uint i = 0; i < k0_; ++i) {
-    for (uint j = 0; j < k0_; ++j)
-      subtrees_[i][j].Save(out, false);
+    for (uint j = 0; j < k0_; ++j) {
+      file.BeginSection();
+      GetSubtree(i, j)->Save(out, false);
+      file.EndSection();
+    }
   }
-
+  file.Finish();
 }
 
 }  // namespace libk2tree
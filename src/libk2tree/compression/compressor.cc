@@ -0,0 +1,123 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Refer to compressor.h for more details.
+ */
+
+#include <compression/compressor.h>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <utility>
+
+namespace libk2tree {
+namespace compression {
+
+namespace {
+
+/**
+ * FNV-1a hash of a word. It is independent of the hash of HashTable.
+ */
+uint64_t WordHash(const uchar *word, uint size) {
+  uint64_t h = 14695981039346656037ULL;
+  for (uint i = 0; i < size; ++i) {
+    h ^= word[i];
+    h *= 1099511628211ULL;
+  }
+  return h;
+}
+
+/**
+ * Orders counts by decreasing weight and then by first occurrence.
+ */
+bool ByFrequency(const WordCount &a, const WordCount &b) {
+  return a.weight > b.weight || (a.weight == b.weight && a.first < b.first);
+}
+
+}  // namespace
+
+std::vector<WordCount> CountWords(const Vocabulary &words,
+                                  utils::ThreadPool *pool) {
+  size_t cnt = words.cnt();
+  uint size = words.size();
+  auto run = [&] (size_t n, const std::function<void(size_t)> &fun) {
+    if (pool) {
+      pool->ParallelFor(n, fun);
+    } else {
+      for (size_t i = 0; i < n; ++i)
+        fun(i);
+    }
+  };
+
+  // Several shards and chunks per thread balance the load.
+  size_t parts = pool ? 4*pool->threads() : 1;
+  size_t shards = parts, chunks = parts;
+  size_t chunk_size = (cnt + chunks - 1)/chunks;
+
+  // Number of words of each chunk in each shard.
+  std::vector<size_t> start(chunks*shards, 0);
+  run(chunks, [&] (size_t c) {
+    size_t end = std::min(cnt, (c + 1)*chunk_size);
+    for (size_t i = c*chunk_size; i < end; ++i)
+      ++start[c*shards + WordHash(words[i], size) % shards];
+  });
+
+  // The positions of a shard are stored together, and inside the shard in
+  // increasing order.
+  std::vector<size_t> shard_start(shards + 1, 0);
+  size_t total = 0;
+  for (size_t s = 0; s < shards; ++s) {
+    shard_start[s] = total;
+    for (size_t c = 0; c < chunks; ++c) {
+      size_t words_cnt = start[c*shards + s];
+      start[c*shards + s] = total;
+      total += words_cnt;
+    }
+  }
+  shard_start[shards] = total;
+
+  std::vector<size_t> positions(cnt);
+  run(chunks, [&] (size_t c) {
+    size_t end = std::min(cnt, (c + 1)*chunk_size);
+    for (size_t i = c*chunk_size; i < end; ++i)
+      positions[start[c*shards + WordHash(words[i], size) % shards]++] = i;
+  });
+  std::vector<size_t>().swap(start);
+
+  // Equal words are in the same shard, sorting it makes them consecutive
+  // with their first occurrence first, as the radix sort is stable.
+  std::vector<std::vector<WordCount>> shard_counts(shards);
+  run(shards, [&] (size_t s) {
+    size_t *first = positions.data() + shard_start[s];
+    size_t *last = positions.data() + shard_start[s + 1];
+    SortByWord(words, first, last);
+    for (size_t *i = first; i < last;) {
+      size_t *j = i + 1;
+      while (j < last && memcmp(words[*i], words[*j], size) == 0)
+        ++j;
+      shard_counts[s].push_back(WordCount{*i, (size_t) (j - i)});
+      i = j;
+    }
+  });
+  std::vector<size_t>().swap(positions);
+
+  std::vector<WordCount> counts;
+  total = 0;
+  for (const std::vector<WordCount> &c : shard_counts)
+    total += c.size();
+  counts.reserve(total);
+  for (std::vector<WordCount> &c : shard_counts) {
+    counts.insert(counts.end(), c.begin(), c.end());
+    std::vector<WordCount>().swap(c);
+  }
+  std::sort(counts.begin(), counts.end(), ByFrequency);
+  return counts;
+}
+
+}  // namespace compression
+}  // namespace libk2tree
@@ -28,6 +28,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 
 #include <compression/hash.h>
+#include <algorithm>
 
 
 namespace libk2tree {
@@ -35,12 +36,27 @@ namespace compression {
 using utils::NearestPrime;
 using std::vector;
 
-HashTable::HashTable(size_t sizeVoc, double occup_hash)
-    : tam_hash_(NearestPrime((size_t) (occup_hash * sizeVoc))),
+HashTable::HashTable(size_t sizeVoc, double occup_hash, uint word_size)
+    : tam_hash_(0),
       num_elem_(0),
-      hash_() {
-  if (tam_hash_ <= JUMP)
-    tam_hash_ = NearestPrime(JUMP+1);
+      hash_(),
+      word_size_(word_size <= kMaxIntegerWord ? word_size : 0),
+      stride_(word_size_ > sizeof(uint64_t) ? 2 : 1),
+      shift_(0) {
+  if (word_size_ == 0) {
+    tam_hash_ = NearestPrime((size_t) (occup_hash * (double) sizeVoc));
+    if (tam_hash_ <= JUMP)
+      tam_hash_ = NearestPrime(JUMP+1);
+  } else {
+    // A power of two with at least one free entry, so searches end.
+    size_t min_size = std::max((size_t) (occup_hash * (double) sizeVoc),
+                             sizeVoc + 1);
+    shift_ = 64 - 4;
+    for (tam_hash_ = 16; tam_hash_ < min_size; tam_hash_ <<= 1)
+      --shift_;
+    keys_.resize(tam_hash_*stride_);
+    used_.resize(tam_hash_);
+  }
   hash_.resize(tam_hash_);
 }
 
@@ -56,12 +72,18 @@ size_t HashTable::add(const uchar *aWord,
   hash_[addr].len = len;
   hash_[addr].weight = 1;
   num_elem_++;
+  if (word_size_ != 0 && len == word_size_) {
+    uint64_t key[2];
+    integerKey(aWord, key);
+    std::copy(key, key + stride_, keys_.data() + addr*stride_);
+    used_[addr] = 1;
+  }
 
   return addr;
 }
-bool HashTable::search(const uchar *aWord,
-                       uint len,
-                       size_t *returnedAddr) const {
+bool HashTable::bytesSearch(const uchar *aWord,
+                            uint len,
+                            size_t *returnedAddr) const {
   size_t addr;
   addr = hashFunction(aWord, len);
 
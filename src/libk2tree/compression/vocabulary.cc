@@ -11,28 +11,81 @@
 #include <libk2tree_basic.h>
 #include <compression/vocabulary.h>
 #include <utils/utils.h>
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
 
 namespace libk2tree {
 using utils::strcmp;
 using utils::LoadValue;
 using utils::SaveValue;
+using utils::LoadAligned;
+using utils::SaveAligned;
+using utils::MappedReader;
 
 namespace compression {
 
+namespace {
+
+/**
+ * Stable counting sort of n elements by one of their bytes. Calls
+ * move(from, to) for each element with its position in the sorted order,
+ * unless all elements have the same byte.
+ *
+ * @param n Number of elements.
+ * @param byte Function returning the byte of an element.
+ * @param move Function moving an element to its sorted position.
+ * @return Whether the elements were moved.
+ */
+template<class Byte, class Move>
+bool RadixPass(size_t n, Byte byte, Move move) {
+  size_t count[1 << kUcharBits] = {0};
+  for (size_t i = 0; i < n; ++i)
+    ++count[byte(i)];
+  for (size_t c : count)
+    if (c == n)
+      return false;
+
+  size_t pos = 0;
+  for (size_t &c : count) {
+    size_t k = c;
+    c = pos;
+    pos += k;
+  }
+  for (size_t i = 0; i < n; ++i)
+    move(i, count[byte(i)]++);
+  return true;
+}
+
+}  // namespace
+
 Vocabulary::Vocabulary(size_t cnt, uint size)
     : cnt_(cnt),
       size_(size),
       data_(new uchar[cnt*size_]) {}
 
 Vocabulary::Vocabulary(std::ifstream *in)
+    : cnt_(LoadValue<size_t>(in)),
+      size_(LoadValue<uint>(in)),
+      data_(LoadAligned<uchar>(in, cnt_*size_)) {}
+
+Vocabulary::Vocabulary(std::ifstream *in, utils::LegacyFormat)
     : cnt_(LoadValue<size_t>(in)),
       size_(LoadValue<uint>(in)),
       data_(LoadValue<uchar>(in, cnt_*size_)) {}
 
+Vocabulary::Vocabulary(MappedReader *in)
+    : cnt_(LoadValue<size_t>(in)),
+      size_(LoadValue<uint>(in)),
+      data_(const_cast<uchar*>(in->View<uchar>(cnt_*size_))),
+      file_(in->file()) {}
+
 void Vocabulary::Save(std::ofstream *out) {
   SaveValue(out, cnt_);
   SaveValue(out, size_);
-  SaveValue(out, data_, cnt_*size_);
+  SaveAligned(out, data_, cnt_*size_);
 }
 
 
@@ -58,14 +111,9 @@ void Vocabulary::assign(size_t p, const uchar* val) {
 }
 
 
-void Vocabulary::swap(size_t a, size_t b) {
-  for (uint i = 0; i < size_; ++i)
-    std::swap(data_[a*size_ + i], data_[b*size_ + i]);
-}
-
-
 Vocabulary::~Vocabulary() {
-  delete [] data_;
+  if (!file_)
+    delete [] data_;
 }
 
 bool Vocabulary::operator==(const Vocabulary &rhs) const {
@@ -77,38 +125,63 @@ bool Vocabulary::operator==(const Vocabulary &rhs) const {
   return true;
 }
 
-size_t Vocabulary::quicksort(size_t left, size_t right) {
-  if (left == right)
-    return 0;
-  if (left == right - 1)
-    return 1;
-
-  size_t i, j, k;
-  i = j = k = left;
-  while (k < right - 1) {
-    // We use the last element as pivot.
-    int cmp = strcmp((*this)[k], (*this)[right-1], size_);
-
-    if (cmp == 0) {
-      swap(j, k);
-      ++j;
+size_t Vocabulary::sort() {
+  std::vector<size_t> order(cnt_);
+  std::iota(order.begin(), order.end(), 0);
+  SortByWord(*this, order.data(), order.data() + cnt_);
+
+  std::vector<uchar> sorted(cnt_*size_);
+  for (size_t i = 0; i < cnt_; ++i)
+    std::copy((*this)[order[i]], (*this)[order[i]] + size_,
+              sorted.data() + i*size_);
+  std::copy(sorted.begin(), sorted.end(), data_);
+
+  size_t unique = cnt_ ? 1 : 0;
+  for (size_t i = 1; i < cnt_; ++i)
+    if (strcmp((*this)[i - 1], (*this)[i], size_) != 0)
+      ++unique;
+  return unique;
+}
+
+void SortByWord(const Vocabulary &words, size_t *first, size_t *last) {
+  size_t n = (size_t) (last - first);
+  uint size = words.size();
+
+  if (size <= sizeof(uint64_t)) {
+    // Read as big endian integers the words compare as their keys.
+    std::vector<std::pair<uint64_t, size_t>> keys(n), tmp(n);
+    for (size_t i = 0; i < n; ++i) {
+      uint64_t key = 0;
+      for (uint b = 0; b < size; ++b)
+        key = key << kUcharBits | words[first[i]][b];
+      keys[i] = std::make_pair(key, first[i]);
     }
-    if (cmp < 0) {
-      swap(j, k);
-      swap(j, i);
-      ++j;
-      ++i;
+    for (uint b = 0; b < size; ++b) {
+      uint shift = b*kUcharBits;
+      if (RadixPass(n, [&] (size_t i) {
+        return (uchar) (keys[i].first >> shift);
+      }, [&] (size_t from, size_t to) {
+        tmp[to] = keys[from];
+      }))
+        keys.swap(tmp);
     }
-    ++k;
+    for (size_t i = 0; i < n; ++i)
+      first[i] = keys[i].second;
+    return;
+  }
+
+  std::vector<size_t> tmp(n);
+  size_t *src = first, *dst = tmp.data();
+  for (uint b = size; b-- > 0;) {
+    if (RadixPass(n, [&] (size_t i) {
+      return words[src[i]][b];
+    }, [&] (size_t from, size_t to) {
+      dst[to] = src[from];
+    }))
+      std::swap(src, dst);
   }
-  // Move the pivot to final position
-  swap(j, right - 1);
-  ++j;
-
-  size_t unique;
-  unique = quicksort(left, i);
-  unique += quicksort(j, right);
-  return unique + 1;
+  if (src != first)
+    std::copy(src, src + n, first);
 }
 
 }  // namespace compression
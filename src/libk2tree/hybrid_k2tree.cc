@@ -10,11 +10,15 @@
 #include <hybrid_k2tree.h>
 #include <compression/compressor.h>
 #include <memory>
+#include <utility>
 
 namespace libk2tree {
 using utils::LoadValue;
 using utils::SaveValue;
 using std::make_shared;
+using utils::FileWriter;
+using utils::FileLayout;
+using utils::SkipHeader;
 
 
 HybridK2Tree::HybridK2Tree(const BitArray<uint> &T,
@@ -25,30 +29,131 @@ HybridK2Tree::HybridK2Tree(const BitArray<uint> &T,
     : base_hybrid(T, k1, k2, kl, max_level_k1, height, cnt, size, links),
       L_(L) {}
 
+HybridK2Tree::HybridK2Tree(BitArray<uint> &&T,
+                           BitArray<uint> &&L,
+                           uint k1, uint k2, uint kl,
+                           uint max_level_k1, uint height,
+                           cnt_size cnt, cnt_size size, size_t links)
+    : base_hybrid(std::move(T), k1, k2, kl, max_level_k1, height, cnt, size,
+                  links),
+      L_(std::move(L)) {}
+
+
+HybridK2Tree::HybridK2Tree(ifstream *in, bool header)
+    : base_hybrid(header ? SkipHeader(in, kHybridK2Tree) : in),
+      L_(in) {}
+
+HybridK2Tree::HybridK2Tree(ifstream *in, utils::LegacyFormat legacy)
+    : base_hybrid(in, legacy),
+      L_(in, legacy) {}
 
-HybridK2Tree::HybridK2Tree(ifstream *in)
-    : base_hybrid(in),
+HybridK2Tree::HybridK2Tree(MappedReader *in, bool header)
+    : base_hybrid(header ? SkipHeader(in, kHybridK2Tree) : in),
       L_(in) {}
 
+std::shared_ptr<HybridK2Tree> HybridK2Tree::Open(const std::string &path,
+                                                 bool verify) {
+  MappedReader in(make_shared<MappedFile>(path));
+  if (verify)
+    FileLayout layout(&in, kHybridK2Tree, true);
+  in.Seek(0);
+  return std::shared_ptr<HybridK2Tree>(new HybridK2Tree(&in));
+}
+
 size_t HybridK2Tree::GetSize() const {
   size_t size = base_hybrid::GetSize();
   size += L_.GetSize();
   return size;
 }
 
-void HybridK2Tree::Save(ofstream *out) const {
-  base_hybrid::Save(out);
-  L_.Save(out);
+void HybridK2Tree::CopyWords(uchar *out) const {
+  size_t cnt = WordsCnt();
+  uint size = WordSize();
+  const uchar *data = InPlaceWords();
+  if (data) {
+    std::copy(data, data + cnt*size, out);
+    return;
+  }
+  for (size_t i = 0; i < cnt; ++i)
+    ReadWord(i, out + i*size);
+}
+
+void HybridK2Tree::Save(ofstream *out, bool header) const {
+  if (!header) {
+    base_hybrid::Save(out);
+    L_.Save(out);
+    return;
+  }
+  FileWriter file(out, kHybridK2Tree, 1);
+  file.BeginSection();
+  Save(out, false);
+  file.EndSection();
+  file.Finish();
 }
 
+HybridK2Tree::Writer::Writer(ofstream *out, uint k1, uint k2, uint kL,
+                             uint max_level_k1, uint height,
+                             cnt_size cnt, cnt_size size, size_t links,
+                             const std::vector<size_t> &nodes)
+    : out_(out),
+      file_(out, kHybridK2Tree, 1),
+      leaves_(nodes[height - 1]*kL*kL) {
+  // Same fields computed by the constructor of base_hybrid from T, using
+  // that the ones of a level are the nodes of the next one.
+  std::vector<Divider<cnt_size>> div_level(height);
+  std::vector<size_t> acum_rank(height - 1), offset(height + 1);
+  acum_rank[0] = 0;
+  offset[0] = offset[1] = 0;
+  offset[2] = k1*k1;
+  for (uint level = 1; level <= height - 2; ++level) {
+    uint k = level <= max_level_k1 ? k1 : k2;
+    acum_rank[level] = acum_rank[level - 1] + nodes[level];
+    offset[level + 2] = offset[level + 1] + nodes[level]*k*k;
+  }
+  cnt_size div = size;
+  for (uint level = 0; level < height; ++level) {
+    uint k = level == height - 1 ? kL : level <= max_level_k1 ? k1 : k2;
+    div /= k;
+    div_level[level] = div;
+  }
 
-std::shared_ptr<CompressedHybrid> HybridK2Tree::CompressLeaves() const {
+  file_.BeginSection();
+  SaveValue(out_, k1);
+  SaveValue(out_, k2);
+  SaveValue(out_, kL);
+  SaveValue(out_, max_level_k1);
+  SaveValue(out_, height);
+  SaveValue(out_, cnt);
+  SaveValue(out_, size);
+  SaveValue(out_, links);
+  SaveValue(out_, div_level.data(), height);
+  SaveValue(out_, acum_rank.data(), height - 1);
+  SaveValue(out_, offset.data(), height + 1);
+  T_.reset(new RankBitArray::Writer(out_, offset[height]));
+}
+
+void HybridK2Tree::Writer::Finish() {
+  if (!L_)
+    BeginL();
+  L_->Finish();
+  file_.EndSection();
+  file_.Finish();
+}
+
+void HybridK2Tree::Writer::BeginL() {
+  T_->Finish();
+  L_.reset(new BitArray<uint>::Writer(out_, leaves_));
+}
+
+
+std::shared_ptr<CompressedHybrid> HybridK2Tree::CompressLeaves(
+    utils::ThreadPool *pool) const {
   std::shared_ptr<CompressedHybrid> t;
 
   compression::FreqVoc(*this, [&] (const HashTable &table,
                                    std::shared_ptr<Vocabulary> voc) {
     t = CompressLeaves(table, voc);
-  });
+  }, pool);
   return t;
 }
 
@@ -78,7 +183,6 @@ std::shared_ptr<CompressedHybrid> HybridK2Tree::CompressLeaves(
 
   FTRep *compressL;
   try {
-    // TODO Port to 64-bits
     compressL = createFT(codewords, cnt);
   } catch (...) {
     std::cerr << "[HybridK2Tree::CompressLeaves] Error: Could not create DAC\n";
@@ -12,45 +12,114 @@
 #include <compression/compressor.h>
 
 namespace libk2tree {
-K2TreePartition::K2TreePartition(std::ifstream *in): base_partition(in) {
+using utils::FileWriter;
+
+K2TreePartition::K2TreePartition(std::ifstream *in)
+    : base_partition(in, kK2TreePartition, 1) {
+  for (uint i = 0; i < k0_; ++i) {
+    subtrees_[i].reserve(k0_);
+    for (uint j = 0; j < k0_; ++j) {
+      layout_.Seek(in, Section(1, i, j));
+      subtrees_[i].emplace_back(in, false);
+    }
+  }
+}
+
+K2TreePartition::K2TreePartition(MappedReader *in)
+    : base_partition(in, kK2TreePartition, 1) {
+  for (uint i = 0; i < k0_; ++i) {
+    subtrees_[i].reserve(k0_);
+    for (uint j = 0; j < k0_; ++j) {
+      layout_.Seek(in, Section(1, i, j));
+      subtrees_[i].emplace_back(in, false);
+    }
+  }
+}
+
+K2TreePartition::K2TreePartition(std::ifstream *in,
+                                 utils::LegacyFormat legacy)
+    : base_partition(in, legacy) {
   for (uint i = 0; i < k0_; ++i) {
     subtrees_[i].reserve(k0_);
     for (uint j = 0; j < k0_; ++j)
-      subtrees_[i].emplace_back(in);
+      subtrees_[i].emplace_back(in, legacy);
   }
+  CountSubtreeLinks();
+}
+
+K2TreePartition::K2TreePartition(const std::string &path, size_t capacity)
+    : base_partition(path, kK2TreePartition, 1) {
+  LoadLazily(1, capacity, [] (std::ifstream *in) {
+    return std::make_shared<HybridK2Tree>(in, false);
+  });
+}
+
+std::shared_ptr<K2TreePartition> K2TreePartition::Open(
+    const std::string &path, bool verify) {
+  MappedReader in(std::make_shared<MappedFile>(path));
+  if (verify)
+    utils::FileLayout layout(&in, kK2TreePartition, true);
+  in.Seek(0);
+  return std::shared_ptr<K2TreePartition>(new K2TreePartition(&in));
 }
 
 void K2TreePartition::Save(std::ofstream *out) const {
+  FileWriter file(out, kK2TreePartition, 1 + k0_*k0_);
+  file.BeginSection();
   base_partition::Save(out);
-  for (uint i = 0; i < k0_; ++i)
-    for (uint j = 0; j < k0_; ++j)
-      subtrees_[i][j].Save(out);
+  file.EndSection();
+  for (uint i = 0; i < k0_; ++i) {
+    for (uint j = 0; j < k0_; ++j) {
+      file.BeginSection();
+      GetSubtree(i, j)->Save(out, false);
+      file.EndSection();
+    }
+  }
+  file.Finish();
 }
 
 size_t K2TreePartition::WordsCnt() const {
   size_t leaves = 0;
   for (uint i = 0; i < k0_; ++i)
     for (uint j = 0; j < k0_; ++j)
-      leaves += subtrees_[i][j].WordsCnt();
+      leaves += GetSubtree(i, j)->WordsCnt();
   return leaves;
 }
 
-void K2TreePartition::CompressLeaves(std::ofstream *out) const {
-  SaveValue(out, cnt_);
-  SaveValue(out, submatrix_size_);
-  SaveValue(out, k0_);
+void K2TreePartition::CopyWords(uchar *out) const {
+  for (uint row = 0; row < k0_; ++row) {
+    for (uint col = 0; col < k0_; ++col) {
+      SubtreePtr subtree = GetSubtree(row, col);
+      subtree->CopyWords(out);
+      out += subtree->WordsCnt()*subtree->WordSize();
+    }
+  }
+}
+
+void K2TreePartition::CompressLeaves(std::ofstream *out,
+                                     utils::ThreadPool *pool) const {
+  FileWriter file(out, kCompressedPartition, 2 + k0_*k0_);
+  file.BeginSection();
+  base_partition::Save(out);
+  file.EndSection();
 
   compression::FreqVoc(*this, [&] (const HashTable &table,
                                    std::shared_ptr<Vocabulary> voc) {
+    file.BeginSection();
     voc->Save(out);
+    file.EndSection();
     for (uint i = 0; i < k0_; ++i) {
       for (uint j = 0; j < k0_; ++j) {
-        const HybridK2Tree &subtree = subtrees_[i][j];
-        std::shared_ptr<CompressedHybrid> t = subtree.CompressLeaves(table, voc);
+        SubtreePtr subtree = GetSubtree(i, j);
+        std::shared_ptr<CompressedHybrid> t =
+            subtree->CompressLeaves(table, voc);
+        file.BeginSection();
         t->Save(out, false);
+        file.EndSection();
       }
     }
-  });
+  }, pool);
+  file.Finish();
 }
 
 }  // namespace libk2tree
@@ -0,0 +1,60 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Refer to bits.h for more details.
+ */
+
+#include <utils/bits.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace libk2tree {
+namespace utils {
+
+namespace {
+
+uint64_t ExtractBitsScalar(uint64_t word, uint64_t mask) {
+  uint64_t res = 0;
+  for (uint64_t bit = 1; mask; bit <<= 1) {
+    if (word & mask & (~mask + 1))
+      res |= bit;
+    mask &= mask - 1;
+  }
+  return res;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("bmi2")))
+uint64_t ExtractBitsBMI2(uint64_t word, uint64_t mask) {
+  return _pext_u64(word, mask);
+}
+#endif
+
+typedef uint64_t (*ExtractBitsFunction)(uint64_t, uint64_t);
+
+ExtractBitsFunction SelectExtractBits() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("bmi2"))
+    return ExtractBitsBMI2;
+#endif
+  return ExtractBitsScalar;
+}
+
+const ExtractBitsFunction extract_bits = SelectExtractBits();
+
+}  // namespace
+
+uint64_t ExtractBits(uint64_t word, uint64_t mask) {
+  return extract_bits(word, mask);
+}
+
+}  // namespace utils
+}  // namespace libk2tree
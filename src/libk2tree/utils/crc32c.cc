@@ -0,0 +1,83 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Refer to crc32c.h for more details.
+ */
+
+#include <utils/crc32c.h>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace libk2tree {
+namespace utils {
+
+namespace {
+
+/** Reflected Castagnoli polynomial. */
+const uint32_t kPolynomial = 0x82f63b78;
+
+struct Table {
+  uint32_t entry[256];
+
+  Table() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t crc = i;
+      for (uint j = 0; j < 8; ++j)
+        crc = (crc >> 1) ^ (crc & 1 ? kPolynomial : 0);
+      entry[i] = crc;
+    }
+  }
+};
+
+uint32_t Crc32cScalar(const uchar *data, size_t length, uint32_t crc) {
+  static const Table table;
+  for (size_t i = 0; i < length; ++i)
+    crc = table.entry[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+uint32_t Crc32cSSE42(const uchar *data, size_t length, uint32_t crc) {
+  uint64_t crc64 = crc;
+  for (; length >= 8; data += 8, length -= 8) {
+    uint64_t word;
+    memcpy(&word, data, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = (uint32_t) crc64;
+  for (; length; ++data, --length)
+    crc = _mm_crc32_u8(crc, *data);
+  return crc;
+}
+#endif
+
+typedef uint32_t (*Crc32cFunction)(const uchar*, size_t, uint32_t);
+
+Crc32cFunction SelectCrc32c() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse4.2"))
+    return Crc32cSSE42;
+#endif
+  return Crc32cScalar;
+}
+
+const Crc32cFunction crc32c = SelectCrc32c();
+
+}  // namespace
+
+uint32_t Crc32c(const void *data, size_t length, uint32_t crc) {
+  return ~crc32c(static_cast<const uchar*>(data), length, ~crc);
+}
+
+}  // namespace utils
+}  // namespace libk2tree
@@ -0,0 +1,288 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Refer to file_format.h for more details.
+ */
+
+#include <utils/file_format.h>
+#include <utils/crc32c.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace libk2tree {
+namespace utils {
+
+namespace {
+
+const char kMagic[8] = {'L', 'I', 'B', 'K', '2', 'T', 'R', 'E'};
+
+/**
+ * Returns the checksum of a header and its section table.
+ */
+uint32_t HeaderCrc(FileHeader header,
+                   const std::vector<SectionEntry> &sections) {
+  header.crc = 0;
+  uint32_t crc = Crc32c(&header, sizeof(header));
+  return Crc32c(sections.data(), sections.size()*sizeof(SectionEntry), crc);
+}
+
+/**
+ * Reads a header and returns whether it starts with the magic bytes.
+ */
+bool ReadHeader(ifstream *in, FileHeader *header) {
+  in->read(reinterpret_cast<char*>(header), sizeof(*header));
+  return *in && memcmp(header->magic, kMagic, sizeof(kMagic)) == 0;
+}
+
+}  // namespace
+
+const char *KindName(uint32_t kind) {
+  switch (kind) {
+    case kHybridK2Tree: return "HybridK2Tree";
+    case kCompressedHybrid: return "CompressedHybrid";
+    case kK2TreePartition: return "K2TreePartition";
+    case kCompressedPartition: return "CompressedPartition";
+    default: return "unknown tree";
+  }
+}
+
+FileWriter::FileWriter(ofstream *out, TreeKind kind, uint sections)
+    : out_(out),
+      sink_(out->rdbuf()),
+      buffer_(sink_),
+      sections_(sections),
+      written_(sections, false),
+      current_(0),
+      next_(0),
+      finished_(false) {
+  AlignStream(out_);
+  base_ = (size_t) out_->tellp();
+
+  memcpy(header_.magic, kMagic, sizeof(kMagic));
+  header_.version = kFormatVersion;
+  header_.endianness = kEndianness;
+  header_.kind = kind;
+  header_.sections = sections;
+  header_.crc = header_.reserved = 0;
+  for (SectionEntry &s : sections_)
+    s.offset = s.length = s.crc = s.reserved = 0;
+
+  // The table is written again by Finish.
+  SaveValue(out_, header_);
+  SaveValue(out_, sections_.data(), sections_.size());
+  static_cast<std::ostream*>(out_)->rdbuf(&buffer_);
+}
+
+FileWriter::~FileWriter() {
+  if (!finished_)
+    static_cast<std::ostream*>(out_)->rdbuf(sink_);
+}
+
+void FileWriter::BeginSection() {
+  BeginSection(next_);
+}
+
+void FileWriter::BeginSection(uint i) {
+  assert(i < sections_.size() && !written_[i]);
+  AlignStream(out_);
+  current_ = i;
+  sections_[i].offset = (size_t) out_->tellp() - base_;
+  buffer_.Reset();
+}
+
+void FileWriter::EndSection() {
+  SectionEntry &s = sections_[current_];
+  s.length = (size_t) out_->tellp() - base_ - s.offset;
+  s.crc = buffer_.crc();
+  written_[current_] = true;
+  while (next_ < sections_.size() && written_[next_])
+    ++next_;
+}
+
+void FileWriter::Finish() {
+  if (next_ != sections_.size()) {
+    std::cerr << "[FileWriter::Finish] Error: Missing sections" << std::endl;
+    exit(1);
+  }
+  static_cast<std::ostream*>(out_)->rdbuf(sink_);
+  finished_ = true;
+
+  std::streampos end = out_->tellp();
+  header_.crc = HeaderCrc(header_, sections_);
+  out_->seekp((std::streamoff) base_);
+  SaveValue(out_, header_);
+  SaveValue(out_, sections_.data(), sections_.size());
+  out_->seekp(end);
+}
+
+FileWriter::ChecksumBuffer::int_type
+FileWriter::ChecksumBuffer::overflow(int_type c) {
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+  char ch = traits_type::to_char_type(c);
+  crc_ = Crc32c(&ch, 1, crc_);
+  return sink_->sputc(ch);
+}
+
+std::streamsize FileWriter::ChecksumBuffer::xsputn(const char *s,
+                                                   std::streamsize n) {
+  crc_ = Crc32c(s, (size_t) n, crc_);
+  return sink_->sputn(s, n);
+}
+
+FileWriter::ChecksumBuffer::pos_type
+FileWriter::ChecksumBuffer::seekoff(off_type off, std::ios_base::seekdir dir,
+                                    std::ios_base::openmode which) {
+  return sink_->pubseekoff(off, dir, which);
+}
+
+FileWriter::ChecksumBuffer::pos_type
+FileWriter::ChecksumBuffer::seekpos(pos_type pos,
+                                    std::ios_base::openmode which) {
+  return sink_->pubseekpos(pos, which);
+}
+
+int FileWriter::ChecksumBuffer::sync() {
+  return sink_->pubsync();
+}
+
+
+FileLayout::FileLayout(ifstream *in, TreeKind kind, bool verify) {
+  AlignStream(in);
+  base_ = (size_t) in->tellg();
+  in->seekg(0, std::ios_base::end);
+  size_t size = (size_t) in->tellg();
+  in->seekg((std::streamoff) base_);
+
+  FileHeader header;
+  if (!ReadHeader(in, &header)) {
+    std::cerr << "[FileLayout::FileLayout] Error: Not a tree file"
+              << std::endl;
+    exit(1);
+  }
+  CheckHeader(header, kind, size);
+  version_ = header.version;
+  sections_.resize(header.sections);
+  in->read(reinterpret_cast<char*>(sections_.data()),
+           (std::streamsize) (sections_.size()*sizeof(SectionEntry)));
+  Check(header, size);
+
+  if (verify) {
+    for (uint i = 0; i < sections(); ++i)
+      Verify(in, i);
+  }
+  Seek(in, 0);
+}
+
+FileLayout::FileLayout(MappedReader *in, TreeKind kind, bool verify) {
+  in->View<char>(0);
+  base_ = in->offset();
+  size_t size = in->file()->size();
+  FileHeader header = in->Read<FileHeader>();
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+    std::cerr << "[FileLayout::FileLayout] Error: Not a tree file"
+              << std::endl;
+    exit(1);
+  }
+  CheckHeader(header, kind, size);
+  version_ = header.version;
+  sections_.resize(header.sections);
+  for (SectionEntry &s : sections_)
+    s = in->Read<SectionEntry>();
+  Check(header, size);
+
+  if (verify) {
+    for (uint i = 0; i < sections(); ++i) {
+      if (Crc32c(in->file()->data() + offset(i), length(i)) != sections_[i].crc)
+        Corrupted(i);
+    }
+  }
+  Seek(in, 0);
+}
+
+void FileLayout::Verify(ifstream *in, uint i) const {
+  char buffer[1 << 16];
+  uint32_t crc = 0;
+  Seek(in, i);
+  for (size_t left = length(i); left > 0;) {
+    size_t chunk = std::min(left, sizeof(buffer));
+    in->read(buffer, (std::streamsize) chunk);
+    crc = Crc32c(buffer, chunk, crc);
+    left -= chunk;
+  }
+  if (crc != sections_[i].crc)
+    Corrupted(i);
+}
+
+TreeKind FileLayout::Kind(const std::string &path) {
+  ifstream in(path, ifstream::in | ifstream::binary);
+  FileHeader header;
+  if (!ReadHeader(&in, &header)) {
+    std::cerr << "[FileLayout::Kind] Error: " << path << " is not a tree file"
+              << std::endl;
+    exit(1);
+  }
+  if (header.endianness != kEndianness) {
+    std::cerr << "[FileLayout::Kind] Error: " << path << " was saved with a "
+              << "different byte order" << std::endl;
+    exit(1);
+  }
+  return static_cast<TreeKind>(header.kind);
+}
+
+void FileLayout::CheckHeader(const FileHeader &header, TreeKind kind,
+                             size_t size) const {
+  if (header.endianness != kEndianness) {
+    std::cerr << "[FileLayout::CheckHeader] Error: File saved with a "
+              << "different byte order" << std::endl;
+    exit(1);
+  }
+  if (header.version != kFormatVersion) {
+    std::cerr << "[FileLayout::CheckHeader] Error: Unsupported format "
+              << "version " << header.version << std::endl;
+    exit(1);
+  }
+  if (header.kind != kind) {
+    std::cerr << "[FileLayout::CheckHeader] Error: File stores a "
+              << KindName(header.kind) << ", expected " << KindName(kind)
+              << std::endl;
+    exit(1);
+  }
+  size_t table = base_ + sizeof(FileHeader);
+  if (table > size ||
+      header.sections > (size - table)/sizeof(SectionEntry)) {
+    std::cerr << "[FileLayout::CheckHeader] Error: Section table exceeds "
+              << "the file" << std::endl;
+    exit(1);
+  }
+}
+
+void FileLayout::Check(const FileHeader &header, size_t size) const {
+  if (HeaderCrc(header, sections_) != header.crc) {
+    std::cerr << "[FileLayout::Check] Error: Checksum mismatch in the header"
+              << std::endl;
+    exit(1);
+  }
+  for (uint i = 0; i < sections(); ++i) {
+    if (offset(i) > size || length(i) > size - offset(i)) {
+      std::cerr << "[FileLayout::Check] Error: Section " << i
+                << " exceeds the file" << std::endl;
+      exit(1);
+    }
+  }
+}
+
+void FileLayout::Corrupted(uint i) const {
+  std::cerr << "[FileLayout::FileLayout] Error: Checksum mismatch in section "
+            << i << std::endl;
+  exit(1);
+}
+
+}  // namespace utils
+}  // namespace libk2tree
@@ -0,0 +1,65 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Refer to mapped_file.h for more details.
+ */
+
+#include <utils/mapped_file.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <iostream>
+
+namespace libk2tree {
+namespace utils {
+
+MappedFile::MappedFile(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "[MappedFile::MappedFile] Error: Could not open " << path
+              << ": " << strerror(errno) << std::endl;
+    exit(1);
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0 || st.st_size == 0) {
+    std::cerr << "[MappedFile::MappedFile] Error: Empty or unreadable file "
+              << path << std::endl;
+    exit(1);
+  }
+  size_ = (size_t) st.st_size;
+
+  void *addr = mmap(NULL, size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    std::cerr << "[MappedFile::MappedFile] Error: Could not map " << path
+              << ": " << strerror(errno) << std::endl;
+    exit(1);
+  }
+  data_ = static_cast<const char*>(addr);
+}
+
+MappedFile::~MappedFile() {
+  munmap(const_cast<char*>(data_), size_);
+}
+
+const char *MappedReader::Advance(size_t bytes) {
+  if (offset_ + bytes > file_->size()) {
+    std::cerr << "[MappedReader::Advance] Error: Unexpected end of file"
+              << std::endl;
+    exit(1);
+  }
+  const char *ptr = file_->data() + offset_;
+  offset_ += bytes;
+  return ptr;
+}
+
+}  // namespace utils
+}  // namespace libk2tree
@@ -0,0 +1,173 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Refer to rank_bitarray.h for more details.
+ */
+
+#include <utils/rank_bitarray.h>
+#include <libcds2/immutable/bitsequence.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace libk2tree {
+namespace utils {
+
+namespace {
+
+/*
+ * Reads a libcds bit sequence into a bit array.
+ */
+BitArray<uint> LoadBitSequence(ifstream *in) {
+  std::unique_ptr<cds::immutable::BitSequence> seq(
+      cds::immutable::BitSequence::Load(*in));
+  if (!seq || !*in) {
+    std::cerr << "[RankBitArray::RankBitArray] Error: Can't read the bit "
+              << "sequence of a legacy file" << std::endl;
+    exit(1);
+  }
+  BitArray<uint> bits(seq->GetLength());
+  for (size_t i = 0; i < bits.length(); ++i)
+    if (seq->Access(i))
+      bits.SetBit(i);
+  return bits;
+}
+
+}  // namespace
+
+RankBitArray::RankBitArray(const BitArray<uint> &bits)
+    : length_(bits.length()) {
+  Allocate();
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // The bit p of a BitArray<uint> is the bit p%32 of its word p/32. On a
+  // little endian machine this is the same order used by the words of a
+  // line, so the bits of a line are 14 consecutive words of the array.
+  const uint *src = bits.GetRawData();
+  const size_t words = Ceil<size_t>(length_, 32);
+  const size_t line_words = kLineBits/32;
+  for (size_t l = 0; l*line_words < words; ++l) {
+    size_t cnt = std::min(line_words, words - l*line_words);
+    memcpy(data_ + l*kLineWords + 1, src + l*line_words, cnt*sizeof(uint));
+  }
+#else
+  for (size_t pos = 0; pos < length_; pos += 64) {
+    uint len = (uint) std::min<size_t>(64, length_ - pos);
+    data_[pos/kLineBits*kLineWords + 1 + pos%kLineBits/64] =
+        bits.GetBits(pos, len);
+  }
+#endif
+
+  size_t rank = 0;
+  for (size_t l = 0; l < lines_; ++l) {
+    uint64_t *line = data_ + l*kLineWords;
+    line[0] = rank;
+    for (uint w = 1; w < kLineWords; ++w)
+      rank += (size_t) __builtin_popcountll(line[w]);
+  }
+}
+
+RankBitArray::RankBitArray(ifstream *in)
+    : length_(LoadValue<size_t>(in)) {
+  Allocate();
+  AlignStream(in);
+  in->read(reinterpret_cast<char *>(data_),
+           (std::streamsize) (lines_*kLineWords*sizeof(uint64_t)));
+}
+
+RankBitArray::RankBitArray(ifstream *in, LegacyFormat)
+    : RankBitArray(LoadBitSequence(in)) {}
+
+RankBitArray::RankBitArray(MappedReader *in)
+    : length_(LoadValue<size_t>(in)),
+      lines_(length_/kLineBits + 1),
+      raw_(NULL),
+      data_(const_cast<uint64_t*>(
+          in->View<uint64_t>(lines_*kLineWords))),
+      file_(in->file()) {}
+
+RankBitArray::~RankBitArray() {
+  delete [] raw_;
+}
+
+void RankBitArray::Save(ofstream *out) const {
+  SaveValue(out, length_);
+  SaveAligned(out, data_, lines_*kLineWords);
+}
+
+size_t RankBitArray::GetSize() const {
+  size_t size = 2*sizeof(size_t) + 2*sizeof(uint64_t*);
+  size += (lines_*kLineWords + kLineWords - 1)*sizeof(uint64_t);
+  return size;
+}
+
+RankBitArray::Writer::Writer(ofstream *out, size_t length)
+    : out_(out),
+      length_(length),
+      pos_(0),
+      rank_(0),
+      lines_(0) {
+  SaveValue(out_, length_);
+  AlignStream(out_);
+  buffer_.reserve(kBufferLines*kLineWords);
+  NewLine();
+}
+
+void RankBitArray::Writer::Append(uint64_t bits, uint len) {
+  assert(len <= 64 && pos_ + len <= length_);
+  while (len > 0) {
+    size_t offset = pos_ % kLineBits;
+    if (offset == 0 && pos_ > 0)
+      NewLine();
+    uint bit = (uint) (offset % 64);
+    uint take = std::min(64 - bit, len);
+    uint64_t chunk = take < 64 ? bits & ((1ULL << take) - 1) : bits;
+    buffer_[buffer_.size() - kLineWords + 1 + offset/64] |= chunk << bit;
+    rank_ += (size_t) __builtin_popcountll(chunk);
+    bits = take < 64 ? bits >> take : 0;
+    len -= take;
+    pos_ += take;
+  }
+}
+
+void RankBitArray::Writer::Finish() {
+  if (pos_ != length_) {
+    std::cerr << "[RankBitArray::Writer] Error: Expected " << length_
+              << " bits, got " << pos_ << std::endl;
+    exit(1);
+  }
+  // As in Allocate, there is one more line than the ones holding bits.
+  while (lines_ + buffer_.size()/kLineWords < length_/kLineBits + 1)
+    NewLine();
+  SaveValue(out_, buffer_.data(), buffer_.size());
+  lines_ += buffer_.size()/kLineWords;
+  buffer_.clear();
+}
+
+void RankBitArray::Writer::NewLine() {
+  if (buffer_.size() == kBufferLines*kLineWords) {
+    SaveValue(out_, buffer_.data(), buffer_.size());
+    lines_ += kBufferLines;
+    buffer_.clear();
+  }
+  buffer_.push_back(rank_);
+  buffer_.resize(buffer_.size() + kLineWords - 1, 0);
+}
+
+void RankBitArray::Allocate() {
+  // One more line, so positions until length_ can be accessed.
+  lines_ = length_/kLineBits + 1;
+  raw_ = new uint64_t[lines_*kLineWords + kLineWords - 1];
+  size_t misalignment = reinterpret_cast<uintptr_t>(raw_) % 64;
+  data_ = raw_ + (misalignment ? (64 - misalignment)/sizeof(uint64_t) : 0);
+  std::fill(data_, data_ + lines_*kLineWords, 0);
+}
+
+}  // namespace utils
+}  // namespace libk2tree
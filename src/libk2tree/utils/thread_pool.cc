@@ -0,0 +1,119 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ *
+ * Refer to thread_pool.h for more details.
+ */
+
+#include <utils/thread_pool.h>
+#include <algorithm>
+
+namespace libk2tree {
+namespace utils {
+
+ThreadPool::ThreadPool(uint threads)
+    : pending_(0),
+      submitted_(0),
+      stop_(false) {
+  if (threads == 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  for (uint i = 0; i < threads; ++i)
+    queues_.emplace_back(new Queue());
+  for (uint i = 0; i < threads; ++i)
+    workers_.emplace_back(&ThreadPool::Work, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (std::thread &t : workers_)
+    t.join();
+}
+
+void ThreadPool::ParallelFor(size_t n,
+                             const std::function<void(size_t)> &fun) {
+  std::atomic<size_t> left(n);
+  std::mutex mutex;
+  std::condition_variable done;
+
+  for (size_t i = 0; i < n; ++i) {
+    Push(i % queues_.size(), [&, i] () {
+      fun(i);
+      // Decremented holding the lock, so the caller can't return and
+      // destroy mutex before this task releases it.
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--left == 0)
+        done.notify_all();
+    });
+  }
+
+  // Run queued tasks while there are any, and then wait for the ones
+  // running in other threads.
+  std::function<void()> task;
+  while (left > 0 && Pop(0, &task))
+    task();
+  std::unique_lock<std::mutex> lock(mutex);
+  done.wait(lock, [&] { return left == 0; });
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  Push(submitted_++ % queues_.size(), std::move(task));
+}
+
+void ThreadPool::Push(size_t q, std::function<void()> task) {
+  {
+    // Counted holding the lock of the queue, so Pop can't take the task
+    // and decrement pending_ before it is incremented.
+    std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+    ++pending_;
+    queues_[q]->tasks.push_back(std::move(task));
+  }
+  {
+    // Orders the increment with the check of the workers about to wait.
+    std::lock_guard<std::mutex> lock(mutex_);
+  }
+  wake_.notify_one();
+}
+
+bool ThreadPool::Pop(size_t q, std::function<void()> *task) {
+  for (size_t i = 0; i < queues_.size(); ++i) {
+    Queue &queue = *queues_[(q + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty())
+      continue;
+    if (i == 0) {
+      *task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    } else {
+      *task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    --pending_;
+    return true;
+  }
+  return false;
+}
+
+void ThreadPool::Work(size_t q) {
+  std::function<void()> task;
+  while (true) {
+    if (Pop(q, &task)) {
+      task();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.wait(lock, [&] { return stop_ || pending_ > 0; });
+    if (stop_ && pending_ == 0)
+      return;
+  }
+}
+
+}  // namespace utils
+}  // namespace libk2tree
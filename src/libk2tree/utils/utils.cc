@@ -16,6 +16,19 @@ namespace libk2tree {
 namespace utils {
 
 
+void AlignStream(ofstream *out) {
+  static const char zeros[kFileAlignment] = {0};
+  size_t pos = (size_t) out->tellp();
+  out->write(zeros, (std::streamsize) ((kFileAlignment - pos%kFileAlignment)
+                                       % kFileAlignment));
+}
+
+void AlignStream(ifstream *in) {
+  size_t pos = (size_t) in->tellg();
+  in->seekg((std::streamoff) ((kFileAlignment - pos%kFileAlignment)
+                              % kFileAlignment), std::ios_base::cur);
+}
+
 int SquaringPow(int base, int exp) {
   // Iterative aproach that increase pow
   // for every bit on true in exp.
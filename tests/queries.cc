@@ -12,10 +12,25 @@
 #define TESTS_QUERIES_CC_
 
 #include "./queries.h"
+#include <libcds2/immutable/bitsequence.h>
+#include <fstream>
 #include <vector>
 
 using ::std::vector;
 using ::std::pair;
+using ::libk2tree::HybridK2Tree;
+using ::libk2tree::K2TreePartition;
+using ::libk2tree::uchar;
+using ::libk2tree::CompressedHybrid;
+using ::libk2tree::CompressedPartition;
+using ::libk2tree::utils::AlignStream;
+using ::libk2tree::utils::FileLayout;
+using ::libk2tree::utils::SkipHeader;
+using ::libk2tree::utils::BitArray;
+using ::libk2tree::utils::RankBitArray;
+using ::libk2tree::utils::LoadValue;
+using ::libk2tree::utils::SaveValue;
+using ::libremainder::Divider;
 
 vector<uint> GetSuccessors(const vector<vector<bool> > &matrix, uint p) {
   vector<uint> v;
@@ -38,4 +53,149 @@ vector<uint> GetPredecessors(const vector<vector<bool> > &matrix, uint q) {
   return v;
 }
 
+namespace {
+
+/*
+ * Copies n values of type T from a stream to another.
+ */
+template<typename T>
+void Copy(std::ifstream *in, std::ofstream *out, size_t n) {
+  T *values = LoadValue<T>(in, n);
+  SaveValue(out, values, n);
+  delete [] values;
+}
+
+/*
+ * Copies n values of 64 bits from a stream to another with 32 bits.
+ */
+void Narrow(std::ifstream *in, std::ofstream *out, size_t n) {
+  for (size_t i = 0; i < n; ++i)
+    SaveValue(out, (uint) LoadValue<size_t>(in));
+}
+
+/*
+ * Rewrites the fields and T of a hybrid tree.
+ */
+void ConvertHybrid(std::ifstream *in, std::ofstream *out) {
+  // The fields before T didn't change.
+  uint *fields = LoadValue<uint>(in, 5);
+  uint height = fields[4];
+  SaveValue(out, fields, 5);
+  delete [] fields;
+  size_t bytes = 2*sizeof(cnt_size) + sizeof(size_t);
+  bytes += height*sizeof(Divider<cnt_size>) + 2*height*sizeof(size_t);
+  Copy<char>(in, out, bytes);
+
+  RankBitArray T(in);
+  BitArray<uint> bits(T.GetLength());
+  for (size_t i = 0; i < T.GetLength(); ++i)
+    if (T.Access(i))
+      bits.SetBit(i);
+  cds::immutable::BitSequenceOneLevelRank(bits.GetCDSArray(), 20).Save(*out);
+}
+
+/*
+ * Rewrites a DAC, which stored lengths and positions with 32 bits.
+ */
+void ConvertFT(std::ifstream *in, std::ofstream *out) {
+  size_t length = LoadValue<size_t>(in);
+  uchar levels = LoadValue<uchar>(in);
+  size_t code = LoadValue<size_t>(in);
+  uint table = LoadValue<uint>(in);
+  SaveValue(out, (uint) length);
+  SaveValue(out, levels);
+  SaveValue(out, (uint) code);
+  SaveValue(out, table);
+  AlignStream(in);
+  Copy<uint>(in, out, table);
+  Copy<ushort>(in, out, levels);
+  Copy<uint>(in, out, levels);
+  Narrow(in, out, 3*(size_t) levels + 1);
+  AlignStream(in);
+  Copy<uint>(in, out, code/32 + 1);
+
+  size_t n = LoadValue<size_t>(in);
+  uint factor = LoadValue<uint>(in);
+  SaveValue(out, (uint) n);
+  SaveValue(out, factor);
+  AlignStream(in);
+  Copy<uint>(in, out, n/32 + 1);
+  AlignStream(in);
+  Narrow(in, out, n/(32*factor) + 1);
+}
+
+/*
+ * Rewrites a vocabulary, whose words had no padding.
+ */
+void ConvertVocabulary(std::ifstream *in, std::ofstream *out) {
+  size_t cnt = LoadValue<size_t>(in);
+  uint size = LoadValue<uint>(in);
+  SaveValue(out, cnt);
+  SaveValue(out, size);
+  AlignStream(in);
+  Copy<uchar>(in, out, cnt*size);
+}
+
+}  // namespace
+
+void SaveLegacy(const HybridK2Tree &tree, std::ofstream *out) {
+  std::ofstream tmp("legacy_tmp", std::ofstream::out);
+  tree.Save(&tmp, false);
+  tmp.close();
+
+  std::ifstream in("legacy_tmp", std::ifstream::in);
+  ConvertHybrid(&in, out);
+  BitArray<uint> L(&in);
+  SaveValue(out, L.length());
+  SaveValue(out, const_cast<uint*>(L.GetRawData()), (L.length() + 31)/32);
+  in.close();
+  remove("legacy_tmp");
+}
+
+void SaveLegacy(const CompressedHybrid &tree, std::ofstream *out) {
+  std::ofstream tmp("legacy_tmp", std::ofstream::out);
+  tree.Save(&tmp);
+  tmp.close();
+
+  std::ifstream in("legacy_tmp", std::ifstream::in);
+  SkipHeader(&in, ::libk2tree::kCompressedHybrid);
+  ConvertHybrid(&in, out);
+  ConvertFT(&in, out);
+  ConvertVocabulary(&in, out);
+  in.close();
+  remove("legacy_tmp");
+}
+
+void SaveLegacy(const K2TreePartition &tree, cnt_size submatrix_size,
+                uint k0, std::ofstream *out) {
+  SaveValue(out, tree.cnt());
+  SaveValue(out, submatrix_size);
+  SaveValue(out, k0);
+  for (uint i = 0; i < k0; ++i)
+    for (uint j = 0; j < k0; ++j)
+      SaveLegacy(*tree.GetSubtree(i, j), out);
+}
+
+void SaveLegacy(const CompressedPartition &tree, std::ofstream *out) {
+  std::ofstream tmp("legacy_tmp", std::ofstream::out);
+  tree.Save(&tmp);
+  tmp.close();
+
+  // The subtrees are stored in the sections after the vocabulary.
+  std::ifstream in("legacy_tmp", std::ifstream::in);
+  FileLayout layout(&in, ::libk2tree::kCompressedPartition);
+  Copy<cnt_size>(&in, out, 2);
+  uint k0 = LoadValue<uint>(&in);
+  SaveValue(out, k0);
+  layout.Seek(&in, 1);
+  ConvertVocabulary(&in, out);
+  for (uint i = 0; i < k0*k0; ++i) {
+    layout.Seek(&in, 2 + i);
+    ConvertHybrid(&in, out);
+    ConvertFT(&in, out);
+  }
+  in.close();
+  remove("legacy_tmp");
+}
+
 #endif // TESTS_QUERIES_CC_
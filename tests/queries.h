@@ -16,6 +16,7 @@
 #include <memory>
 #include <vector>
 #include <cstdio>
+#include <fstream>
 #include <algorithm>
 #include <utility>
 
@@ -33,6 +34,37 @@ vector<pair<uint, uint>> GetEdges(const vector<vector<bool> > &matrix,
 
 vector<uint> GetPredecessors(const vector<vector<bool> > &matrix, uint q);
 
+/**
+ * Saves a tree in the layout of the versions of the library before the file
+ * header: no header, T as a libcds BitSequenceOneLevelRank and the arrays
+ * without padding.
+ */
+void SaveLegacy(const ::libk2tree::HybridK2Tree &tree, std::ofstream *out);
+
+/**
+ * Saves a compressed tree in the layout of the versions of the library
+ * before the file header, which also stored the lengths and positions of the
+ * DAC with 32 bits.
+ */
+void SaveLegacy(const ::libk2tree::CompressedHybrid &tree, std::ofstream *out);
+
+/**
+ * Saves a partition in the layout of the versions of the library before the
+ * file header.
+ *
+ * @param submatrix_size Size of the submatrices of the subtrees.
+ * @param k0 Number of submatrices of a row.
+ */
+void SaveLegacy(const ::libk2tree::K2TreePartition &tree,
+                cnt_size submatrix_size, uint k0, std::ofstream *out);
+
+/**
+ * Saves a compressed partition in the layout of the versions of the library
+ * before the file header.
+ */
+void SaveLegacy(const ::libk2tree::CompressedPartition &tree,
+                std::ofstream *out);
+
 
 
 template<class K2Tree>
@@ -88,6 +120,14 @@ void TestRangeQuery(const K2Tree &tree, const vector<vector<bool>> &matrix) {
   sort(v1.begin(), v1.end());
   unique(v1.begin(), v1.end());
   ASSERT_EQ(size, v1.size());
+
+  /* Depth first traversal must report the same links */
+  vector<pair<uint, uint> > v2;
+  tree.RangeQuery(p1, p2, q1, q2, [&] (cnt_size p, cnt_size q) {
+    v2.emplace_back(p, q);
+  }, ::libk2tree::kDepthFirst);
+  sort(v2.begin(), v2.end());
+  ASSERT_EQ(v1, v2);
 }
 template<class K2Tree>
 void TestCheckLink(const K2Tree &tree, const vector<vector<bool>> &matrix) {
@@ -101,5 +141,187 @@ void TestCheckLink(const K2Tree &tree, const vector<vector<bool>> &matrix) {
   }
 }
 
+template<class K2Tree>
+void TestCheckLinks(const K2Tree &tree, const vector<vector<bool>> &matrix) {
+  uint n = (uint) matrix.size();
+  uint e = n > 10 ? (uint) rand()%(n*10) + 1 : n;
+
+  vector<pair<cnt_size, cnt_size>> pairs;
+  for (uint i = 0; i < e; ++i)
+    pairs.emplace_back((uint) rand()%n, (uint) rand()%n);
+
+  std::unique_ptr<bool[]> out(new bool[e]);
+  tree.CheckLinks(pairs.data(), pairs.data() + e, out.get());
+  for (uint i = 0; i < e; ++i)
+    ASSERT_EQ(matrix[pairs[i].first][pairs[i].second], out[i]);
+}
+template<class K2Tree>
+void TestMultiLinks(const K2Tree &tree, const vector<vector<bool>> &matrix) {
+  uint n = (uint) matrix.size();
+  uint e = n > 10 ? (uint) rand()%std::min(n/4, 200u) + 1 : n;
+
+  vector<cnt_size> objects;
+  for (uint i = 0; i < e; ++i)
+    objects.push_back((uint) rand()%n);
+  sort(objects.begin(), objects.end());
+  objects.erase(unique(objects.begin(), objects.end()), objects.end());
+
+  vector<pair<cnt_size, cnt_size>> direct, inverse;
+  for (cnt_size o : objects) {
+    for (uint q : GetSuccessors(matrix, (uint) o))
+      direct.emplace_back(o, q);
+    for (uint p : GetPredecessors(matrix, (uint) o))
+      inverse.emplace_back(p, o);
+  }
+
+  vector<pair<cnt_size, cnt_size>> v;
+  tree.DirectLinks(objects.data(), objects.data() + objects.size(),
+                   [&] (cnt_size p, cnt_size q) {
+    v.emplace_back(p, q);
+  });
+  sort(v.begin(), v.end());
+  ASSERT_EQ(direct, v);
+
+  v.clear();
+  tree.InverseLinks(objects.data(), objects.data() + objects.size(),
+                    [&] (cnt_size p, cnt_size q) {
+    v.emplace_back(p, q);
+  });
+  sort(v.begin(), v.end());
+  sort(inverse.begin(), inverse.end());
+  ASSERT_EQ(inverse, v);
+}
+template<class K2Tree>
+void TestRangeFirstK(const K2Tree &tree, const vector<vector<bool>> &matrix) {
+  uint n = (uint) matrix.size();
+  vector<pair<uint, uint>> all = GetEdges(matrix, 0, n - 1, 0, n - 1);
+
+  uint e = n > 10 ? 100 : n;
+  for (uint c = 0; c < e; ++c) {
+    // Small submatrices are often empty.
+    uint side = c % 2 ? n : n/32 + 1;
+    uint p1 = (uint) rand()%n, p2 = std::min(p1 + (uint) rand()%side, n - 1);
+    uint q1 = (uint) rand()%n, q2 = std::min(q1 + (uint) rand()%side, n - 1);
+    vector<pair<uint, uint>> v;
+    for (const pair<uint, uint> &l : all) {
+      if (p1 <= l.first && l.first <= p2 && q1 <= l.second && l.second <= q2)
+        v.push_back(l);
+    }
+    ASSERT_EQ(!v.empty(), tree.RangeExists(p1, p2, q1, q2));
+
+    size_t k = (size_t) rand()%(v.size() + 2);
+    vector<pair<uint, uint>> v1;
+    size_t cnt = tree.RangeFirstK(p1, p2, q1, q2, k,
+                                  [&] (cnt_size p, cnt_size q) {
+      v1.emplace_back(p, q);
+    });
+    ASSERT_EQ(std::min(k, v.size()), cnt);
+    ASSERT_EQ(cnt, v1.size());
+    sort(v1.begin(), v1.end());
+    ASSERT_TRUE(std::includes(v.begin(), v.end(), v1.begin(), v1.end()));
+  }
+
+  // The function is called once before it can ask to stop.
+  size_t k = (size_t) rand()%(all.size() + 2);
+  size_t cnt = 0;
+  tree.RangeQuery(0, n - 1, 0, n - 1, [&] (cnt_size p, cnt_size q) {
+    EXPECT_TRUE(matrix[p][q]);
+    return ++cnt < k;
+  });
+  ASSERT_EQ(std::min(std::max(k, (size_t) 1), all.size()), cnt);
+}
+
+template<class K2Tree>
+void TestCounts(const K2Tree &tree, const vector<vector<bool>> &matrix) {
+  uint n = (uint) matrix.size();
+  uint e = n > 10 ? 100 : n;
+  for (uint c = 0; c < e; ++c) {
+    uint o = (uint) rand()%n;
+    ASSERT_EQ(GetSuccessors(matrix, o).size(), tree.OutDegree(o));
+    ASSERT_EQ(GetPredecessors(matrix, o).size(), tree.InDegree(o));
+  }
+
+  vector<pair<uint, uint>> all = GetEdges(matrix, 0, n - 1, 0, n - 1);
+  ASSERT_EQ(all.size(), tree.RangeCount(0, n - 1, 0, n - 1));
+  for (uint c = 0; c < e; ++c) {
+    uint side = c % 2 ? n : n/32 + 1;
+    uint p1 = (uint) rand()%n, p2 = std::min(p1 + (uint) rand()%side, n - 1);
+    uint q1 = (uint) rand()%n, q2 = std::min(q1 + (uint) rand()%side, n - 1);
+    size_t cnt = 0;
+    for (const pair<uint, uint> &l : all) {
+      if (p1 <= l.first && l.first <= p2 && q1 <= l.second && l.second <= q2)
+        ++cnt;
+    }
+    ASSERT_EQ(cnt, tree.RangeCount(p1, p2, q1, q2));
+  }
+}
+
+template<class K2Tree>
+void TestStop(const K2Tree &tree, const vector<vector<bool>> &matrix) {
+  uint n = (uint) matrix.size();
+  uint e = n > 10 ? 100 : n;
+  for (uint c = 0; c < e; ++c) {
+    uint o = (uint) rand()%n;
+    vector<uint> v = GetSuccessors(matrix, o);
+    size_t k = (size_t) rand()%(v.size() + 2);
+    vector<uint> v1;
+    tree.DirectLinks(o, [&] (cnt_size q) {
+      v1.push_back((uint) q);
+      return v1.size() < k;
+    });
+    // The function is called once before it can ask to stop.
+    v.resize(std::min(std::max(k, (size_t) 1), v.size()));
+    ASSERT_EQ(v, v1);
+
+    v = GetPredecessors(matrix, o);
+    k = (size_t) rand()%(v.size() + 2);
+    size_t cnt = 0;
+    tree.InverseLinks(o, [&] (cnt_size) {
+      return ++cnt < k;
+    });
+    ASSERT_EQ(std::min(std::max(k, (size_t) 1), v.size()), cnt);
+  }
+}
+
+template<class K2Tree>
+void TestCursors(const K2Tree &tree, const vector<vector<bool>> &matrix) {
+  uint n = (uint) matrix.size();
+  uint e = n > 10 ? (uint) rand()%std::min(n/4, 200u) + 1 : n;
+  for (uint c = 0; c < e; ++c) {
+    uint o = (uint) rand()%n;
+    cnt_size x;
+    vector<uint> v;
+
+    ::libk2tree::DirectCursor<K2Tree> direct(tree, o);
+    while (direct.Next(&x))
+      v.push_back((uint) x);
+    ASSERT_EQ(GetSuccessors(matrix, o), v);
+
+    v.clear();
+    ::libk2tree::InverseCursor<K2Tree> inverse(tree, o);
+    while (inverse.Next(&x))
+      v.push_back((uint) x);
+    ASSERT_EQ(GetPredecessors(matrix, o), v);
+  }
+
+  uint p1 = (uint) rand()%(n/2 + 1);
+  uint p2 = (uint) rand()%(n - n/2) + n/2;
+  uint q1 = (uint) rand()%(n/2 + 1);
+  uint q2 = (uint) rand()%(n - n/2) + n/2;
+  vector<pair<uint, uint>> v;
+  cnt_size p, q;
+  ::libk2tree::RangeCursor<K2Tree> range(tree, p1, p2, q1, q2);
+  while (range.Next(&p, &q))
+    v.emplace_back(p, q);
+
+  // Both report links in Z-order.
+  vector<pair<uint, uint>> v1;
+  tree.RangeQuery(p1, p2, q1, q2, [&] (cnt_size p, cnt_size q) {
+    v1.emplace_back(p, q);
+  }, ::libk2tree::kDepthFirst);
+  ASSERT_EQ(v1, v);
+  sort(v.begin(), v.end());
+  ASSERT_EQ(GetEdges(matrix, p1, p2, q1, q2), v);
+}
 
 #endif  // TESTS_QUERIES_H_
@@ -0,0 +1,80 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+
+#include <gtest/gtest.h>
+#include <utils/array_queue.h>
+#include <queue>
+
+using ::libk2tree::utils::ArrayQueue;
+
+TEST(ArrayQueue, Grow) {
+  ArrayQueue<size_t> q(4);
+  for (size_t i = 0; i < 1000; ++i)
+    q.push(i);
+  ASSERT_EQ(1000u, q.size());
+  ASSERT_EQ(1024u, q.capacity());
+  for (size_t i = 0; i < 1000; ++i) {
+    ASSERT_EQ(i, q.front());
+    q.pop();
+  }
+  ASSERT_TRUE(q.empty());
+}
+
+TEST(ArrayQueue, ReuseSlots) {
+  ArrayQueue<size_t> q(8);
+  std::queue<size_t> expected;
+  srand((uint) time(NULL));
+  for (size_t i = 0; i < 100000; ++i) {
+    if (expected.size() < 8 && rand()%2) {
+      q.push(i);
+      expected.push(i);
+    } else if (!expected.empty()) {
+      ASSERT_EQ(expected.front(), q.front());
+      q.pop();
+      expected.pop();
+    }
+  }
+  ASSERT_EQ(expected.size(), q.size());
+  ASSERT_EQ(8u, q.capacity());
+}
+
+TEST(ArrayQueue, GrowWrapped) {
+  ArrayQueue<size_t> q(4);
+  q.push(0);
+  q.push(1);
+  q.push(2);
+  q.pop();
+  q.pop();
+  for (size_t i = 3; i < 10; ++i)
+    q.push(i);
+  for (size_t i = 2; i < 10; ++i) {
+    ASSERT_EQ(i, q.front());
+    q.pop();
+  }
+  ASSERT_TRUE(q.empty());
+}
+
+TEST(ArrayQueue, GrowEmpty) {
+  ArrayQueue<size_t> q;
+  ASSERT_EQ(0u, q.capacity());
+  for (size_t i = 0; i < 5; ++i)
+    q.push(i);
+  ASSERT_EQ(8u, q.capacity());
+
+  ArrayQueue<size_t> moved(std::move(q));
+  ASSERT_EQ(0u, q.capacity());
+  q.push(7);
+  ASSERT_EQ(1u, q.size());
+  ASSERT_EQ(7u, q.front());
+  for (size_t i = 0; i < 5; ++i) {
+    ASSERT_EQ(i, moved.front());
+    moved.pop();
+  }
+}
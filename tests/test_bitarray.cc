@@ -11,6 +11,7 @@
 #include <gtest/gtest.h>
 #include <libk2tree_basic.h>
 #include <utils/bitarray.h>
+#include <utility>
 
 using ::libk2tree::utils::BitArray;
 using ::libk2tree::uchar;
@@ -25,6 +26,16 @@ TEST(BitArray, SetBit0) {
   bs.SetBit(0);
   ASSERT_EQ(1, bs.GetBit(0));
 }
+TEST(BitArray, Move) {
+  BitArray<uint> bs(100);
+  bs.SetBit(42);
+  const uint *data = bs.GetRawData();
+  BitArray<uint> moved(std::move(bs));
+  ASSERT_EQ(data, moved.GetRawData());
+  ASSERT_EQ(100u, moved.length());
+  ASSERT_EQ(1, moved.GetBit(42));
+  ASSERT_EQ(0u, bs.length());
+}
 TEST(BitArrayChar, SetBit) {
   srand((uint) time(NULL));
   for (uint i = 0; i < 100; ++i) {
@@ -105,3 +116,41 @@ TEST(BitArray, CopyConstructor) {
     }
   }
 }
+TEST(BitArrayInt, GetBits) {
+  srand((uint) time(NULL));
+  for (int i = 0; i < 100; ++i) {
+    size_t N = (size_t) rand()%10000 + 1000;
+    BitArray<uint> bs(N);
+    for (int j = 0; j < 1000 ; ++j)
+      bs.SetBit((uint) rand()%N);
+
+    for (int j = 0; j < 100 ; ++j) {
+      uint len = (uint) rand()%65;
+      size_t pos = (uint) rand()%(N - len + 1);
+      uint64_t bits = bs.GetBits(pos, len);
+      for (uint b = 0; b < len; ++b)
+        ASSERT_EQ(bs.GetBit(pos + b), (bits >> b) & 1);
+      if (len < 64) {
+        ASSERT_EQ(0u, bits >> len);
+      }
+    }
+  }
+}
+TEST(BitArrayChar, CountOnes) {
+  srand((uint) time(NULL));
+  for (int i = 0; i < 100; ++i) {
+    size_t N = (size_t) rand()%10000 + 1000;
+    BitArray<uchar> bs(N);
+    for (int j = 0; j < 1000 ; ++j)
+      bs.SetBit((uint) rand()%N);
+
+    for (int j = 0; j < 100 ; ++j) {
+      size_t start = (uint) rand()%N;
+      size_t end = start + (uint) rand()%(N - start + 1);
+      size_t cnt = 0;
+      for (size_t b = start; b < end; ++b)
+        cnt += bs.GetBit(b);
+      ASSERT_EQ(cnt, bs.CountOnes(start, end));
+    }
+  }
+}
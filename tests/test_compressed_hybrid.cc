@@ -58,12 +58,43 @@ TEST(CompressedHybrid, InverseLinks) {
 
   TestInverseLinks(*tree, matrix);
 }
+TEST(CompressedHybrid, MultiLinks) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedHybrid> tree = Build(&matrix);
+
+  TestMultiLinks(*tree, matrix);
+}
+TEST(CompressedHybrid, Cursors) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedHybrid> tree = Build(&matrix);
+
+  TestCursors(*tree, matrix);
+}
 TEST(CompressedHybrid, CheckLink) {
   vector<vector<bool>> matrix;
   shared_ptr<CompressedHybrid> tree = Build(&matrix);
 
   TestCheckLink(*tree, matrix);
 }
+TEST(CompressedHybrid, CheckLinks) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedHybrid> tree = Build(&matrix);
+
+  TestCheckLinks(*tree, matrix);
+}
+TEST(CompressedHybrid, RangeFirstK) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedHybrid> tree = Build(&matrix);
+
+  TestRangeFirstK(*tree, matrix);
+  TestStop(*tree, matrix);
+}
+TEST(CompressedHybrid, Counts) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedHybrid> tree = Build(&matrix);
+
+  TestCounts(*tree, matrix);
+}
 TEST(CompressedHybrid, RangeQuery) {
   vector<vector<bool>> matrix;
   shared_ptr<CompressedHybrid> tree = Build(&matrix);
@@ -88,6 +119,40 @@ TEST(CompressedHybrid, Save) {
   remove("compressed_k2tree_test");
 }
 
+TEST(CompressedHybrid, Open) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedHybrid> tree = Build(&matrix);
+
+  ofstream out("compressed_k2tree_open_test", ofstream::out);
+  tree->Save(&out);
+  out.close();
+
+  shared_ptr<CompressedHybrid> tree2 =
+      CompressedHybrid::Open("compressed_k2tree_open_test");
+  remove("compressed_k2tree_open_test");
+
+  ASSERT_TRUE(*tree == *tree2);
+  TestCheckLink(*tree2, matrix);
+  TestInverseLinks(*tree2, matrix);
+}
+
+TEST(CompressedHybrid, Legacy) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedHybrid> tree = Build(&matrix);
+
+  ofstream out("compressed_k2tree_legacy", ofstream::out);
+  SaveLegacy(*tree, &out);
+  out.close();
+
+  ifstream in("compressed_k2tree_legacy", ifstream::in);
+  CompressedHybrid tree2(&in, ::libk2tree::utils::LegacyFormat());
+  in.close();
+  remove("compressed_k2tree_legacy");
+  ASSERT_TRUE(*tree == tree2);
+  TestCheckLink(tree2, matrix);
+  TestDirectLinks(tree2, matrix);
+}
+
 // EMPTY
 TEST(CompressedHybrid, Empty) {
   vector<vector<bool>> matrix;
@@ -113,3 +178,70 @@ TEST(CompressedHybrid, Empty) {
   TestRangeQuery(tree2, matrix);
   remove("compressed_k2tree_test");
 }
+
+TEST(CompressedHybrid, CountWords) {
+  using ::libk2tree::compression::Vocabulary;
+  using ::libk2tree::compression::WordCount;
+  using ::libk2tree::compression::CountWords;
+  uchar data[] = {3, 1, 3, 2, 1, 5, 2, 1};
+  Vocabulary words(8, 1);
+  for (size_t i = 0; i < 8; ++i)
+    words.assign(i, data + i);
+
+  // Ties are sorted by first occurrence.
+  size_t first[] = {1, 0, 3, 5};
+  uint weight[] = {3, 2, 2, 1};
+  ::libk2tree::utils::ThreadPool pool(3);
+  vector<WordCount> counts[] = {CountWords(words), CountWords(words, &pool)};
+  for (const vector<WordCount> &c : counts) {
+    ASSERT_EQ(4u, c.size());
+    for (size_t i = 0; i < 4; ++i) {
+      ASSERT_EQ(first[i], c[i].first);
+      ASSERT_EQ(weight[i], c[i].weight);
+    }
+  }
+}
+
+TEST(CompressedHybrid, ParallelVocabulary) {
+  using ::libk2tree::compression::FreqVoc;
+  using ::libk2tree::compression::HashTable;
+  using ::libk2tree::compression::Vocabulary;
+  size_t n = 2000;
+  K2TreeBuilder tb(n, 4, 2, 2, 4);
+  vector<vector<bool>> matrix(n, vector<bool>(n, false));
+  for (uint i = 0; i < 20000; ++i) {
+    size_t p = (size_t) rand()%n, q = (size_t) rand()%n;
+    matrix[p][q] = true;
+    tb.AddLink(p, q);
+  }
+  shared_ptr<HybridK2Tree> tree = tb.Build();
+
+  shared_ptr<Vocabulary> expected;
+  vector<uint> weights;
+  FreqVoc(*tree, [&] (const HashTable &table, shared_ptr<Vocabulary> voc) {
+    expected = voc;
+    for (size_t i = 0; i < voc->cnt(); ++i) {
+      size_t addr;
+      ASSERT_TRUE(table.search((*voc)[i], voc->size(), &addr));
+      ASSERT_EQ(i, table[addr].codeword);
+      weights.push_back(table[addr].weight);
+    }
+  });
+  ASSERT_TRUE(std::is_sorted(weights.rbegin(), weights.rend()));
+
+  ::libk2tree::utils::ThreadPool pool(4);
+  FreqVoc(*tree, [&] (const HashTable &table, shared_ptr<Vocabulary> voc) {
+    ASSERT_EQ(expected->cnt(), voc->cnt());
+    ASSERT_TRUE(*expected == *voc);
+    for (size_t i = 0; i < voc->cnt(); ++i) {
+      size_t addr;
+      ASSERT_TRUE(table.search((*voc)[i], voc->size(), &addr));
+      ASSERT_EQ(i, table[addr].codeword);
+      ASSERT_EQ(weights[i], table[addr].weight);
+    }
+  }, &pool);
+
+  shared_ptr<CompressedHybrid> compressed = tree->CompressLeaves(&pool);
+  TestCheckLink(*compressed, matrix);
+  TestDirectLinks(*compressed, matrix);
+}
@@ -102,9 +102,78 @@ TEST(CompressedPartition, InverseLinks) {
 
   TestInverseLinks(*tree, matrix);
 }
+TEST(CompressedPartition, MultiLinks) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedPartition> tree = BuildCompressed(&matrix);
+
+  TestMultiLinks(*tree, matrix);
+}
+TEST(CompressedPartition, RangeFirstK) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedPartition> tree = BuildCompressed(&matrix);
+
+  TestRangeFirstK(*tree, matrix);
+  TestStop(*tree, matrix);
+}
+TEST(CompressedPartition, Counts) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedPartition> tree = BuildCompressed(&matrix);
+
+  TestCounts(*tree, matrix);
+}
 TEST(CompressedPartition, RangeQuery) {
   vector<vector<bool>> matrix;
   shared_ptr<CompressedPartition> tree = BuildCompressed(&matrix);
 
   TestRangeQuery(*tree, matrix);
 }
+TEST(CompressedPartition, Open) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedPartition> tree = BuildCompressed(&matrix);
+
+  ofstream out("compressed_partition_open", ofstream::out);
+  tree->Save(&out);
+  out.close();
+
+  shared_ptr<CompressedPartition> tree2 =
+      CompressedPartition::Open("compressed_partition_open");
+  remove("compressed_partition_open");
+  ASSERT_TRUE(*tree == *tree2);
+  TestCheckLink(*tree2, matrix);
+  TestRangeQuery(*tree2, matrix);
+}
+
+TEST(CompressedPartition, Legacy) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedPartition> tree = BuildCompressed(&matrix);
+
+  ofstream out("compressed_partition_legacy", ofstream::out);
+  SaveLegacy(*tree, &out);
+  out.close();
+
+  ifstream in("compressed_partition_legacy", ifstream::in);
+  CompressedPartition tree2(&in, ::libk2tree::utils::LegacyFormat());
+  in.close();
+  remove("compressed_partition_legacy");
+  ASSERT_TRUE(*tree == tree2);
+  ASSERT_EQ(tree->links(), tree2.links());
+  TestCheckLink(tree2, matrix);
+  TestRangeQuery(tree2, matrix);
+}
+
+TEST(CompressedPartition, Lazy) {
+  vector<vector<bool>> matrix;
+  shared_ptr<CompressedPartition> tree = BuildCompressed(&matrix);
+
+  ofstream out("compressed_partition_lazy", ofstream::out);
+  tree->Save(&out);
+  out.close();
+
+  CompressedPartition tree2("compressed_partition_lazy", 1);
+  TestCheckLink(tree2, matrix);
+  TestDirectLinks(tree2, matrix);
+  TestRangeQuery(tree2, matrix);
+  ASSERT_TRUE(*tree == tree2);
+  remove("compressed_partition_lazy");
+  ASSERT_EQ(1u, tree2.resident_subtrees());
+}
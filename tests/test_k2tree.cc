@@ -12,11 +12,15 @@
 #include <memory>
 #include <vector>
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <cstddef>
 
 #include "./queries.h"
 
 using ::libk2tree::K2TreeBuilder;
 using ::libk2tree::HybridK2Tree;
+using ::libk2tree::QueryContext;
 using ::std::shared_ptr;
 using ::std::vector;
 using ::std::ifstream;
@@ -45,6 +49,11 @@ void CheckLink(uint k1, uint k2, uint kl, uint k1_levels) {
   shared_ptr<HybridK2Tree > tree = Build(k1, k2, kl, k1_levels, &matrix);
   TestCheckLink(*tree, matrix);
 }
+void CheckLinks(uint k1, uint k2, uint kl, uint k1_levels) {
+  vector<vector<bool>> matrix;
+  shared_ptr<HybridK2Tree > tree = Build(k1, k2, kl, k1_levels, &matrix);
+  TestCheckLinks(*tree, matrix);
+}
 void DirectLinks(uint k1, uint k2, uint kl, uint k1_levels) {
   vector<vector<bool> > matrix;
   shared_ptr<HybridK2Tree > tree = Build(k1, k2, kl, k1_levels, &matrix);
@@ -55,6 +64,27 @@ void InverseLinks(uint k1, uint k2, uint kl, uint k1_levels) {
   shared_ptr<HybridK2Tree > tree = Build(k1, k2, kl, k1_levels, &matrix);
   TestInverseLinks(*tree, matrix);
 }
+void MultiLinks(uint k1, uint k2, uint kl, uint k1_levels) {
+  vector<vector<bool> > matrix;
+  shared_ptr<HybridK2Tree > tree = Build(k1, k2, kl, k1_levels, &matrix);
+  TestMultiLinks(*tree, matrix);
+}
+void Cursors(uint k1, uint k2, uint kl, uint k1_levels) {
+  vector<vector<bool> > matrix;
+  shared_ptr<HybridK2Tree > tree = Build(k1, k2, kl, k1_levels, &matrix);
+  TestCursors(*tree, matrix);
+}
+void RangeFirstK(uint k1, uint k2, uint kl, uint k1_levels) {
+  vector<vector<bool> > matrix;
+  shared_ptr<HybridK2Tree > tree = Build(k1, k2, kl, k1_levels, &matrix);
+  TestRangeFirstK(*tree, matrix);
+  TestStop(*tree, matrix);
+}
+void Counts(uint k1, uint k2, uint kl, uint k1_levels) {
+  vector<vector<bool> > matrix;
+  shared_ptr<HybridK2Tree > tree = Build(k1, k2, kl, k1_levels, &matrix);
+  TestCounts(*tree, matrix);
+}
 void RangeQuery(uint k1, uint k2, uint kl, uint k1_levels) {
   vector<vector<bool> > matrix;
   shared_ptr<HybridK2Tree > tree = Build(k1, k2, kl, k1_levels, &matrix);
@@ -84,6 +114,22 @@ void TestSave(uint k1, uint k2, uint kl, uint k1_levels) {
   remove("k2tree_test");
 }
 
+void TestOpen(uint k1, uint k2, uint kl, uint k1_levels) {
+  vector<vector<bool>> matrix;
+  shared_ptr<HybridK2Tree> tree = Build(k1, k2, kl, k1_levels, &matrix);
+
+  ofstream out("k2tree_open_test", ofstream::out);
+  tree->Save(&out);
+  out.close();
+
+  shared_ptr<HybridK2Tree> tree2 = HybridK2Tree::Open("k2tree_open_test");
+  remove("k2tree_open_test");
+  ASSERT_TRUE(*tree == *tree2);
+  TestCheckLink(*tree2, matrix);
+  TestDirectLinks(*tree2, matrix);
+  TestRangeQuery(*tree2, matrix);
+}
+
 // CHECK Link
 TEST(HybridK2Tree, CheckEdge1) {
   srand((uint) time(NULL));
@@ -96,6 +142,17 @@ TEST(HybridK2Tree, CheckEdge3) {
   CheckLink(4, 2, 2, 10);
 }
 
+// CHECK LINKS
+TEST(HybridK2Tree, CheckLinks1) {
+  CheckLinks(3, 2, 2, 1);
+}
+TEST(HybridK2Tree, CheckLinks2) {
+  CheckLinks(4, 2, 8, 5);
+}
+TEST(HybridK2Tree, CheckLinks3) {
+  CheckLinks(4, 2, 2, 10);
+}
+
 // DIRECT LINKS
 TEST(HybridK2Tree, DirectLinks1) {
   DirectLinks(3, 2, 2, 1);
@@ -119,6 +176,50 @@ TEST(HybridK2Tree, InverseLinks3) {
   InverseLinks(4, 2, 2, 10);
 }
 
+// MULTI LINKS
+TEST(HybridK2Tree, MultiLinks1) {
+  MultiLinks(3, 2, 2, 1);
+}
+TEST(HybridK2Tree, MultiLinks2) {
+  MultiLinks(4, 2, 8, 5);
+}
+TEST(HybridK2Tree, MultiLinks3) {
+  MultiLinks(4, 2, 2, 10);
+}
+
+// CURSORS
+TEST(HybridK2Tree, Cursors1) {
+  Cursors(3, 2, 2, 1);
+}
+TEST(HybridK2Tree, Cursors2) {
+  Cursors(4, 2, 8, 5);
+}
+TEST(HybridK2Tree, Cursors3) {
+  Cursors(4, 2, 2, 10);
+}
+
+// EARLY STOP
+TEST(HybridK2Tree, RangeFirstK1) {
+  RangeFirstK(3, 2, 2, 1);
+}
+TEST(HybridK2Tree, RangeFirstK2) {
+  RangeFirstK(4, 2, 8, 5);
+}
+TEST(HybridK2Tree, RangeFirstK3) {
+  RangeFirstK(4, 2, 2, 10);
+}
+
+// COUNTS
+TEST(HybridK2Tree, Counts1) {
+  Counts(3, 2, 2, 1);
+}
+TEST(HybridK2Tree, Counts2) {
+  Counts(4, 2, 8, 5);
+}
+TEST(HybridK2Tree, Counts3) {
+  Counts(4, 2, 2, 10);
+}
+
 // RANGE QUERY
 TEST(HybridK2Tree, RangeQuery1) {
   srand((uint) time(NULL));
@@ -143,6 +244,126 @@ TEST(HybridK2Tree, Save3) {
   TestSave(4, 2, 2, 10);
 }
 
+// OPEN
+TEST(HybridK2Tree, Open1) {
+  TestOpen(3, 2, 2, 1);
+}
+TEST(HybridK2Tree, Open2) {
+  TestOpen(4, 2, 8, 5);
+}
+TEST(HybridK2Tree, Open3) {
+  TestOpen(4, 2, 2, 10);
+}
+
+// LEGACY FILES
+void TestLegacy(uint k1, uint k2, uint kl, uint k1_levels) {
+  vector<vector<bool>> matrix;
+  shared_ptr<HybridK2Tree> tree = Build(k1, k2, kl, k1_levels, &matrix);
+
+  ofstream out("k2tree_legacy", ofstream::out);
+  SaveLegacy(*tree, &out);
+  out.close();
+
+  ifstream in("k2tree_legacy", ifstream::in);
+  HybridK2Tree tree2(&in, ::libk2tree::utils::LegacyFormat());
+  in.close();
+  remove("k2tree_legacy");
+  ASSERT_TRUE(*tree == tree2);
+  TestCheckLink(tree2, matrix);
+  TestDirectLinks(tree2, matrix);
+  TestInverseLinks(tree2, matrix);
+}
+
+TEST(HybridK2Tree, Legacy1) {
+  TestLegacy(3, 2, 2, 1);
+}
+TEST(HybridK2Tree, Legacy2) {
+  TestLegacy(4, 2, 8, 5);
+}
+
+// FILE FORMAT
+struct CheckOpened {
+  const vector<vector<bool>> &matrix;
+  uint *opened;
+
+  template<class Tree>
+  void operator()(const shared_ptr<Tree> &tree) const {
+    ++*opened;
+    TestCheckLink(*tree, matrix);
+  }
+};
+
+TEST(HybridK2Tree, OpenAnyKind) {
+  vector<vector<bool>> matrix;
+  shared_ptr<HybridK2Tree> tree = Build(4, 2, 8, 5, &matrix);
+  ofstream out("k2tree_kind_test", ofstream::out);
+  tree->Save(&out);
+  out.close();
+
+  ASSERT_EQ(::libk2tree::kHybridK2Tree,
+            ::libk2tree::utils::FileLayout::Kind("k2tree_kind_test"));
+  uint opened = 0;
+  ::libk2tree::Open("k2tree_kind_test", CheckOpened{matrix, &opened}, true);
+  remove("k2tree_kind_test");
+  ASSERT_EQ(1u, opened);
+}
+TEST(HybridK2Tree, WrongKind) {
+  vector<vector<bool>> matrix;
+  shared_ptr<HybridK2Tree> tree = Build(3, 2, 2, 1, &matrix);
+  ofstream out("k2tree_wrong_kind", ofstream::out);
+  tree->Save(&out);
+  out.close();
+
+  ASSERT_EXIT(::libk2tree::CompressedHybrid::Open("k2tree_wrong_kind"),
+              ::testing::ExitedWithCode(1), "expected CompressedHybrid");
+  remove("k2tree_wrong_kind");
+}
+TEST(HybridK2Tree, Corrupted) {
+  vector<vector<bool>> matrix;
+  shared_ptr<HybridK2Tree> tree = Build(4, 2, 8, 5, &matrix, 1000);
+  ofstream out("k2tree_corrupted", ofstream::out);
+  tree->Save(&out);
+  uint64_t size = (uint64_t) out.tellp();
+  out.close();
+
+  std::fstream file("k2tree_corrupted");
+  file.seekp((std::streamoff) size - 1);
+  file.put('\xff' ^ (char) file.peek());
+  file.close();
+
+  ASSERT_EXIT(HybridK2Tree::Open("k2tree_corrupted", true),
+              ::testing::ExitedWithCode(1), "Checksum mismatch");
+  ASSERT_EXIT({ ifstream in("k2tree_corrupted"); HybridK2Tree t(&in); },
+              ::testing::ExitedWithCode(1), "Checksum mismatch");
+  remove("k2tree_corrupted");
+}
+TEST(HybridK2Tree, CorruptedHeader) {
+  using ::libk2tree::utils::FileHeader;
+  vector<vector<bool>> matrix;
+  shared_ptr<HybridK2Tree> tree = Build(4, 2, 8, 5, &matrix, 1000);
+  ofstream out("k2tree_corrupted_header", ofstream::out);
+  tree->Save(&out);
+  out.close();
+
+  // Offset of the first section in the section table.
+  std::fstream file("k2tree_corrupted_header");
+  file.seekp((std::streamoff) sizeof(FileHeader));
+  file.put('\x01' ^ (char) file.peek());
+  file.close();
+  ASSERT_EXIT(HybridK2Tree::Open("k2tree_corrupted_header"),
+              ::testing::ExitedWithCode(1), "Checksum mismatch in the header");
+
+  // Number of sections.
+  uint32_t sections = 0xffffffff;
+  file.open("k2tree_corrupted_header");
+  file.seekp((std::streamoff) offsetof(FileHeader, sections));
+  file.write(reinterpret_cast<char*>(&sections), sizeof(sections));
+  file.close();
+  ASSERT_EXIT({ ifstream in("k2tree_corrupted_header"); HybridK2Tree t(&in); },
+              ::testing::ExitedWithCode(1), "Section table exceeds the file");
+  remove("k2tree_corrupted_header");
+}
+
 // EMPTY
 TEST(HybridK2Tree, Empty) {
   vector<vector<bool>> matrix;
@@ -151,4 +372,83 @@ TEST(HybridK2Tree, Empty) {
   TestDirectLinks(*tree, matrix);
   TestInverseLinks(*tree, matrix);
   TestRangeQuery(*tree, matrix);
+  TestCursors(*tree, matrix);
+}
+
+// CONCURRENCY
+TEST(HybridK2Tree, ConcurrentQueries) {
+  vector<vector<bool>> matrix;
+  shared_ptr<HybridK2Tree> tree = Build(4, 2, 8, 5, &matrix);
+  uint n = (uint) matrix.size();
+  uint threads = 4;
+
+  std::atomic<uint> errors(0);
+  vector<std::thread> workers;
+  for (uint t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] () {
+      QueryContext ctx;
+      for (uint p = t; p < n; p += threads) {
+        vector<uint> v = GetSuccessors(matrix, p);
+        vector<uint> links;
+        tree->DirectLinks(p, [&] (cnt_size q) {
+          links.push_back((uint) q);
+        }, &ctx);
+        if (links != v)
+          ++errors;
+      }
+    });
+  }
+  for (std::thread &w : workers)
+    w.join();
+  ASSERT_EQ(0u, errors.load());
+}
+
+TEST(HybridK2Tree, ReentrantQueries) {
+  vector<vector<bool>> matrix;
+  shared_ptr<HybridK2Tree> tree = Build(4, 2, 2, 10, &matrix);
+  uint n = (uint) matrix.size();
+
+  for (uint c = 0; c < 100; ++c) {
+    uint p = (uint) rand()%n;
+    uint i = 0;
+    vector<uint> v = GetSuccessors(matrix, p);
+    tree->DirectLinks(p, [&] (cnt_size q) {
+      bool found = false;
+      tree->InverseLinks(q, [&] (cnt_size p2) {
+        found = found || p2 == p;
+      });
+      ASSERT_TRUE(found);
+      ASSERT_EQ(v[i++], q);
+    });
+    ASSERT_EQ(v.size(), i);
+  }
+}
+
+TEST(HybridK2Tree, Words) {
+  // Words filling whole bytes are read in place, the others assembled.
+  uint kls[] = {2, 3, 4, 8, 9};
+  for (uint kl : kls) {
+    vector<vector<bool>> matrix;
+    shared_ptr<HybridK2Tree> tree = Build(4, 2, kl, 2, &matrix);
+    size_t cnt = tree->WordsCnt();
+    uint size = tree->WordSize();
+    vector<uchar> copied(cnt*size);
+    tree->CopyWords(copied.data());
+
+    size_t i = 0, ones = 0;
+    tree->Words([&] (const uchar *word) {
+      ASSERT_TRUE(std::equal(word, word + size, &copied[i*size]));
+      for (uint b = 0; b < size; ++b)
+        ones += (size_t) __builtin_popcount(word[b]);
+      // Bits past kl*kl are 0.
+      if (kl*kl % 8) {
+        ASSERT_EQ(0, word[size - 1] >> (kl*kl % 8));
+      }
+      ++i;
+    });
+    ASSERT_EQ(cnt, i);
+    ASSERT_EQ(tree->links(), ones);
+
+    TestDirectLinks(*tree->CompressLeaves(), matrix);
+  }
 }
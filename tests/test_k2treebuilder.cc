@@ -9,9 +9,16 @@
 
 #include <k2tree.h>
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <utility>
+#include <vector>
 
 
 using ::libk2tree::K2TreeBuilder;
+using ::libk2tree::ExternalK2TreeBuilder;
+using ::libk2tree::HybridK2Tree;
 
 /*
  * 0 1 0 0 | 0 0 0 0 | 0 0 0
@@ -85,3 +92,155 @@ TEST(K2TreeBuilder, 5) {
   ASSERT_EQ(12, tb.links());
   ASSERT_EQ(4, tb.height());
 }
+TEST(K2TreeBuilder, Clear) {
+  K2TreeBuilder tb(11, 3, 2, 2, 1);
+  std::shared_ptr<HybridK2Tree> expected;
+  for (uint t = 0; t < 3; ++t) {
+    // Other links that must not survive the Clear.
+    tb.AddLink(5, 5);
+    tb.AddLink(10, 0);
+    tb.Clear();
+    ASSERT_EQ(0, tb.links());
+    ASSERT_EQ(0, tb.internal_nodes());
+
+    AddLinks(&tb);
+    ASSERT_EQ(29, tb.internal_nodes());
+    ASSERT_EQ(36, tb.leaves());
+    ASSERT_EQ(12, tb.links());
+    std::shared_ptr<HybridK2Tree> tree = tb.Build();
+    if (expected) {
+      ASSERT_TRUE(*expected == *tree);
+    }
+    expected = tree;
+    tb.Clear();
+  }
+
+  K2TreeBuilder moved(std::move(tb));
+  AddLinks(&moved);
+  ASSERT_TRUE(*expected == *moved.Build());
+}
+
+void TestBuildFromEdges(size_t n, uint k1, uint k2, uint kl, uint k1_levels,
+                        const std::vector<std::pair<size_t, size_t>> &edges) {
+  K2TreeBuilder tb(n, k1, k2, kl, k1_levels);
+  for (const std::pair<size_t, size_t> &e : edges)
+    tb.AddLink(e.first, e.second);
+  std::shared_ptr<HybridK2Tree> expected = tb.Build();
+  std::shared_ptr<HybridK2Tree> tree = K2TreeBuilder::BuildFromEdges(
+      n, k1, k2, kl, k1_levels, edges.data(), edges.data() + edges.size());
+  ASSERT_TRUE(*expected == *tree);
+  ASSERT_EQ(expected->links(), tree->links());
+}
+
+TEST(K2TreeBuilder, MemoryBound) {
+  K2TreeBuilder tb(5000, 4, 2, 2, 3);
+  size_t bound = tb.MemoryBound(20000);
+  for (uint i = 0; i < 20000; ++i)
+    tb.AddLink((size_t) rand()%5000, (size_t) rand()%5000);
+  ASSERT_LE(tb.Build()->GetSize(), bound);
+  ASSERT_LE(bound, tb.MemoryBound(40000));
+  ASSERT_GT(tb.MemoryBound(1), 0u);
+}
+
+TEST(K2TreeBuilder, BuildFromEdges) {
+  std::vector<std::pair<size_t, size_t>> edges = {
+    {0, 1}, {1, 2}, {1, 3}, {1, 4}, {7, 6}, {8, 6},
+    {8, 9}, {9, 6}, {9, 8}, {9, 10}, {10, 6}, {10, 9}
+  };
+  TestBuildFromEdges(11, 4, 2, 2, 1, edges);
+  TestBuildFromEdges(11, 3, 2, 2, 1, edges);
+  TestBuildFromEdges(11, 3, 2, 3, 1, edges);
+  TestBuildFromEdges(11, 3, 2, 2, 2, edges);
+  TestBuildFromEdges(11, 3, 2, 2, 3, edges);
+  TestBuildFromEdges(11, 4, 2, 2, 1, {});
+}
+
+TEST(K2TreeBuilder, BuildFromEdgesLarge) {
+  // More than 2^32 rows, the links are added to a K2TreeBuilder.
+  size_t n = ((size_t) 1 << 33) + 5;
+  std::vector<std::pair<size_t, size_t>> edges = {
+    {0, 1}, {1, 0}, {n - 1, n - 2}, {(size_t) 1 << 32, 7}, {0, 1}
+  };
+  std::shared_ptr<HybridK2Tree> tree = K2TreeBuilder::BuildFromEdges(
+      n, 4, 2, 2, 1, edges.data(), edges.data() + edges.size());
+  ASSERT_EQ(4u, tree->links());
+  for (const std::pair<size_t, size_t> &e : edges)
+    ASSERT_TRUE(tree->CheckLink(e.first, e.second));
+  ASSERT_FALSE(tree->CheckLink(1, 1));
+  ASSERT_FALSE(tree->CheckLink(n - 2, n - 1));
+}
+
+TEST(K2TreeBuilder, BuildFromEdgesRandom) {
+  for (uint t = 0; t < 10; ++t) {
+    size_t n = (size_t) rand()%5000 + 1;
+    std::vector<std::pair<size_t, size_t>> edges;
+    size_t e = (size_t) rand()%(n*10) + 1;
+    for (size_t i = 0; i < e; ++i)
+      edges.emplace_back((size_t) rand()%n, (size_t) rand()%n);
+    // Repeated links
+    for (size_t i = 0; i < e/10; ++i)
+      edges.push_back(edges[(size_t) rand()%e]);
+    TestBuildFromEdges(n, 4, 2, 8, 5, edges);
+    TestBuildFromEdges(n, 3, 2, 2, 1, edges);
+    TestBuildFromEdges(n, 4, 2, 2, 10, edges);
+  }
+}
+
+void TestExternal(size_t n, uint k1, uint k2, uint kl, uint k1_levels,
+                  const std::vector<std::pair<size_t, size_t>> &edges,
+                  size_t memory, uint fan_in) {
+  K2TreeBuilder tb(n, k1, k2, kl, k1_levels);
+  for (const std::pair<size_t, size_t> &e : edges)
+    tb.AddLink(e.first, e.second);
+  ExternalK2TreeBuilder external(n, k1, k2, kl, k1_levels, ".", memory,
+                                 fan_in);
+  for (const std::pair<size_t, size_t> &e : edges)
+    external.AddLink(e.first, e.second);
+  std::ofstream out("external_tree", std::ofstream::binary);
+  external.Build(&out);
+  out.close();
+  ASSERT_EQ(0u, external.runs());
+
+  std::ifstream in("external_tree", std::ifstream::binary);
+  HybridK2Tree tree(&in);
+  in.close();
+  std::shared_ptr<HybridK2Tree> expected = tb.Build();
+  ASSERT_TRUE(*expected == tree);
+  ASSERT_EQ(expected->links(), tree.links());
+  // Queries use the fields written before T and the ranks of T.
+  for (size_t p = 0; p < n; ++p) {
+    std::vector<size_t> a, b;
+    expected->DirectLinks(p, [&] (size_t q) { a.push_back(q); });
+    tree.DirectLinks(p, [&] (size_t q) { b.push_back(q); });
+    ASSERT_EQ(a, b);
+  }
+  remove("external_tree");
+}
+
+TEST(ExternalK2TreeBuilder, Build) {
+  std::vector<std::pair<size_t, size_t>> edges = {
+    {10, 9}, {1, 2}, {9, 6}, {1, 4}, {7, 6}, {0, 1},
+    {8, 9}, {8, 6}, {9, 8}, {9, 10}, {10, 6}, {1, 3}, {1, 2}
+  };
+  TestExternal(11, 4, 2, 2, 1, edges, 1 << 20, 64);
+  TestExternal(11, 3, 2, 3, 1, edges, 16, 2);
+  TestExternal(11, 3, 2, 2, 3, edges, 16, 64);
+  TestExternal(11, 4, 2, 2, 1, {}, 16, 2);
+}
+
+TEST(ExternalK2TreeBuilder, Random) {
+  for (uint t = 0; t < 5; ++t) {
+    size_t n = (size_t) rand()%5000 + 1;
+    std::vector<std::pair<size_t, size_t>> edges;
+    size_t e = (size_t) rand()%(n*10) + 1;
+    for (size_t i = 0; i < e; ++i)
+      edges.emplace_back((size_t) rand()%n, (size_t) rand()%n);
+    for (size_t i = 0; i < e/10; ++i)
+      edges.push_back(edges[(size_t) rand()%e]);
+    std::random_shuffle(edges.begin(), edges.end());
+    // Small buffers produce many runs, merged in several passes.
+    TestExternal(n, 4, 2, 8, 5, edges, 8*(e/10 + 1), 3);
+    TestExternal(n, 3, 2, 2, 1, edges, 8*(e/3 + 1), 64);
+    TestExternal(n, 4, 2, 2, 10, edges, 1 << 20, 64);
+  }
+}
@@ -71,6 +71,13 @@ TEST(k2treepartition, CheckLink) {
   TestCheckLink(*tree, matrix);
 }
 
+TEST(k2treepartition, CheckLinks) {
+  vector<vector<bool>> matrix;
+  shared_ptr<K2TreePartition> tree = BuildPartition(&matrix);
+
+  TestCheckLinks(*tree, matrix);
+}
+
 TEST(k2treepartition, DirectLinks) {
   vector<vector<bool>> matrix;
   shared_ptr<K2TreePartition> tree = BuildPartition(&matrix);
@@ -83,6 +90,19 @@ TEST(k2treepartition, InverseLinks) {
 
   TestInverseLinks(*tree, matrix);
 }
+TEST(k2treepartition, RangeFirstK) {
+  vector<vector<bool>> matrix;
+  shared_ptr<K2TreePartition> tree = BuildPartition(&matrix);
+
+  TestRangeFirstK(*tree, matrix);
+  TestStop(*tree, matrix);
+}
+TEST(k2treepartition, Counts) {
+  vector<vector<bool>> matrix;
+  shared_ptr<K2TreePartition> tree = BuildPartition(&matrix);
+
+  TestCounts(*tree, matrix);
+}
 TEST(k2treepartition, RangeQuery) {
   vector<vector<bool>> matrix;
   shared_ptr<K2TreePartition> tree = BuildPartition(&matrix);
@@ -106,3 +126,150 @@ TEST(k2treepartition, Save) {
   remove("partition_save");
   ASSERT_TRUE(*tree == tree2);
 }
+
+TEST(k2treepartition, Legacy) {
+  vector<vector<bool>> matrix;
+  shared_ptr<K2TreePartition> tree = BuildPartition(&matrix);
+
+  ofstream out("partition_legacy", ofstream::out);
+  SaveLegacy(*tree, (cnt_size) matrix.size()/10, 10, &out);
+  out.close();
+
+  ifstream in("partition_legacy", ifstream::in);
+  K2TreePartition tree2(&in, ::libk2tree::utils::LegacyFormat());
+  in.close();
+  remove("partition_legacy");
+  ASSERT_TRUE(*tree == tree2);
+  ASSERT_EQ(tree->links(), tree2.links());
+  TestCheckLink(tree2, matrix);
+  TestDirectLinks(tree2, matrix);
+
+  // Saving the tree migrates it to the current format.
+  out.open("partition_migrated", ofstream::out);
+  tree2.Save(&out);
+  out.close();
+  in.open("partition_migrated", ifstream::in);
+  K2TreePartition tree3(&in);
+  in.close();
+  remove("partition_migrated");
+  ASSERT_TRUE(*tree == tree3);
+}
+
+TEST(k2treepartition, Open) {
+  vector<vector<bool>> matrix;
+  shared_ptr<K2TreePartition> tree = BuildPartition(&matrix);
+
+  ofstream out("partition_open", ofstream::out);
+  tree->Save(&out);
+  out.close();
+
+  shared_ptr<K2TreePartition> tree2 = K2TreePartition::Open("partition_open");
+  remove("partition_open");
+  ASSERT_TRUE(*tree == *tree2);
+  TestCheckLink(*tree2, matrix);
+  TestDirectLinks(*tree2, matrix);
+}
+
+TEST(k2treepartition, Lazy) {
+  vector<vector<bool>> matrix;
+  shared_ptr<K2TreePartition> tree = BuildPartition(&matrix);
+
+  ofstream out("partition_lazy", ofstream::out);
+  tree->Save(&out);
+  out.close();
+
+  K2TreePartition tree2("partition_lazy", 2);
+  ASSERT_EQ(0u, tree2.resident_subtrees());
+  // The number of links is read without loading the subtrees.
+  ASSERT_EQ(tree->links(), tree2.links());
+  ASSERT_EQ(0u, tree2.cache_misses());
+  TestCheckLink(tree2, matrix);
+  TestDirectLinks(tree2, matrix);
+  TestInverseLinks(tree2, matrix);
+  TestRangeQuery(tree2, matrix);
+  ASSERT_TRUE(*tree == tree2);
+  remove("partition_lazy");
+
+  ASSERT_LE(tree2.resident_subtrees(), 2u);
+  ASSERT_GT(tree2.cache_misses(), 0u);
+  ASSERT_GT(tree2.cache_hits(), 0u);
+}
+
+TEST(k2treepartition, ParallelQueries) {
+  vector<vector<bool>> matrix;
+  shared_ptr<K2TreePartition> tree = BuildPartition(&matrix);
+  ::libk2tree::utils::ThreadPool pool(4);
+  size_t n = matrix.size();
+
+  for (size_t i = 0; i < n; i += 7) {
+    vector<size_t> expected, ordered, unordered;
+    tree->DirectLinks(i, [&] (size_t q) {expected.push_back(q);});
+    tree->DirectLinks(i, [&] (size_t q) {ordered.push_back(q);}, &pool);
+    tree->DirectLinks(i, [&] (size_t q) {unordered.push_back(q);}, &pool,
+                      false);
+    ASSERT_EQ(expected, ordered);
+    std::sort(unordered.begin(), unordered.end());
+    std::sort(expected.begin(), expected.end());
+    ASSERT_EQ(expected, unordered);
+
+    expected.clear();
+    ordered.clear();
+    tree->InverseLinks(i, [&] (size_t p) {expected.push_back(p);});
+    tree->InverseLinks(i, [&] (size_t p) {ordered.push_back(p);}, &pool);
+    ASSERT_EQ(expected, ordered);
+  }
+
+  for (uint k = 0; k < 20; ++k) {
+    size_t p1 = (size_t) rand()%n, p2 = (size_t) rand()%n;
+    size_t q1 = (size_t) rand()%n, q2 = (size_t) rand()%n;
+    if (p1 > p2)
+      std::swap(p1, p2);
+    if (q1 > q2)
+      std::swap(q1, q2);
+    vector<std::pair<size_t, size_t>> expected, ordered;
+    tree->RangeQuery(p1, p2, q1, q2, [&] (size_t p, size_t q) {
+      expected.emplace_back(p, q);
+    });
+    tree->RangeQuery(p1, p2, q1, q2, [&] (size_t p, size_t q) {
+      ordered.emplace_back(p, q);
+    }, &pool);
+    ASSERT_EQ(expected, ordered);
+
+    size_t cnt = 0;
+    tree->RangeQuery(p1, p2, q1, q2, [&] (size_t, size_t) {
+      return ++cnt < 3;
+    }, &pool, false);
+    ASSERT_EQ(std::min<size_t>(3, expected.size()), cnt);
+  }
+}
+
+TEST(k2treepartition, ParallelBuilder) {
+  vector<vector<bool>> matrix;
+  shared_ptr<K2TreePartition> tree = BuildPartition(&matrix);
+  uint n = (uint) matrix.size();
+  uint k0 = 10;
+  uint subm = n/k0;
+
+  // A small budget forces BuildSubtree to wait for some subtrees.
+  ::libk2tree::ParallelPartitionBuilder b(n, subm, 4, 2, 2, 3,
+                                          "partition_parallel", 4, 1024);
+  for (uint row = 0; row < k0; ++row) {
+    for (uint col = 0; col < k0; ++col) {
+      for (uint i = 0; i < subm; ++i) {
+        for (uint j = 0; j < subm; ++j) {
+          if (matrix[i + row*subm][j + col*subm])
+            b.AddLink(i + row*subm, j + col*subm);
+        }
+      }
+      b.BuildSubtree();
+    }
+  }
+  ASSERT_TRUE(b.Ready());
+
+  ifstream in("partition_parallel", ifstream::in);
+  K2TreePartition tree2(&in);
+  in.close();
+  remove("partition_parallel");
+  ASSERT_TRUE(*tree == tree2);
+  TestCheckLink(tree2, matrix);
+}
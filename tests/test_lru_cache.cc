@@ -0,0 +1,82 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#include <utils/lru_cache.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using ::libk2tree::utils::LruCache;
+
+TEST(LruCache, Eviction) {
+  std::vector<size_t> loads;
+  LruCache<size_t> cache(10, 3, [&] (size_t key) {
+    loads.push_back(key);
+    return std::make_shared<size_t>(key*key);
+  });
+
+  ASSERT_EQ(4u, *cache.Get(2));
+  ASSERT_EQ(9u, *cache.Get(3));
+  ASSERT_EQ(16u, *cache.Get(4));
+  ASSERT_EQ(4u, *cache.Get(2));   // 3 becomes the least recently used
+  ASSERT_EQ(25u, *cache.Get(5));  // discards 3
+  ASSERT_EQ(4u, *cache.Get(2));
+  ASSERT_EQ(9u, *cache.Get(3));   // discards 4
+
+  ASSERT_EQ(std::vector<size_t>({2, 3, 4, 5, 3}), loads);
+  ASSERT_EQ(2u, cache.hits());
+  ASSERT_EQ(5u, cache.misses());
+  ASSERT_EQ(3u, cache.resident());
+}
+
+TEST(LruCache, HeldValues) {
+  LruCache<size_t> cache(4, 1, [] (size_t key) {
+    return std::make_shared<size_t>(key);
+  });
+
+  std::shared_ptr<const size_t> held = cache.Get(0);
+  for (size_t key = 1; key < 4; ++key)
+    ASSERT_EQ(key, *cache.Get(key));
+  ASSERT_EQ(0u, *held);
+  ASSERT_EQ(1u, cache.resident());
+}
+
+TEST(LruCache, ConcurrentLoads) {
+  std::promise<void> started, release;
+  std::shared_future<void> released = release.get_future().share();
+  std::atomic<int> loads(0);
+  LruCache<size_t> cache(4, 4, [&] (size_t key) {
+    ++loads;
+    if (key == 0) {
+      started.set_value();
+      released.wait();
+    }
+    return std::make_shared<size_t>(key);
+  });
+  ASSERT_EQ(1u, *cache.Get(1));
+
+  std::shared_ptr<const size_t> first, second;
+  std::thread loader([&] { first = cache.Get(0); });
+  started.get_future().wait();
+  // Values in memory and other keys are available while 0 is loading.
+  ASSERT_EQ(1u, *cache.Get(1));
+  ASSERT_EQ(2u, *cache.Get(2));
+  std::thread waiter([&] { second = cache.Get(0); });
+  release.set_value();
+  loader.join();
+  waiter.join();
+
+  ASSERT_EQ(0u, *first);
+  ASSERT_EQ(0u, *second);
+  ASSERT_EQ(3, loads);
+  ASSERT_EQ(3u, cache.resident());
+}
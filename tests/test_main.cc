@@ -9,13 +9,18 @@
 
 #include <gtest/gtest.h>
 #include <pthread.h>
+#include "test_array_queue.cc"
 #include "test_bitarray.cc"
 #include "test_compressed_hybrid.cc"
 #include "test_compressed_partition.cc"
 #include "test_k2tree.cc"
 #include "test_k2treebuilder.cc"
 #include "test_k2treepartition.cc"
+#include "test_lru_cache.cc"
+#include "test_rank_bitarray.cc"
+#include "test_thread_pool.cc"
 #include "test_utils.cc"
+#include "test_vocabulary.cc"
 
 int main(int argc, char **argv) {
   ::testing::InitGoogleTest(&argc, argv);
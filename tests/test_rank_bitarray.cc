@@ -0,0 +1,122 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+#include <libk2tree_basic.h>
+#include <utils/bitarray.h>
+#include <utils/rank_bitarray.h>
+#include <fstream>
+
+using ::libk2tree::utils::BitArray;
+using ::libk2tree::utils::RankBitArray;
+
+BitArray<uint> RandomBits(size_t N, uint density) {
+  BitArray<uint> bits(N);
+  for (size_t i = 0; i < N; ++i)
+    if ((uint) rand()%100 < density)
+      bits.SetBit(i);
+  return bits;
+}
+
+TEST(RankBitArray, AccessRank) {
+  srand((uint) time(NULL));
+  for (uint t = 0; t < 20; ++t) {
+    size_t N = (size_t) rand()%5000 + 1;
+    BitArray<uint> bits = RandomBits(N, (uint) rand()%101);
+    RankBitArray rank(bits);
+    ASSERT_EQ(N, rank.GetLength());
+
+    size_t ones = 0;
+    for (size_t i = 0; i < N; ++i) {
+      size_t r;
+      bool bit = rank.AccessRank(i, &r);
+      ASSERT_EQ(bits.GetBit(i), bit);
+      ASSERT_EQ(bits.GetBit(i), rank.Access(i));
+      ASSERT_EQ(ones, r);
+      ones += bit;
+      ASSERT_EQ(ones, rank.Rank1(i));
+    }
+  }
+}
+
+TEST(RankBitArray, LineBoundaries) {
+  // Lines hold 448 bits, check every position around the first ones.
+  size_t N = 448*4;
+  BitArray<uint> bits = RandomBits(N, 100);
+  RankBitArray rank(bits);
+  for (size_t i = 0; i < N; ++i)
+    ASSERT_EQ(i + 1, rank.Rank1(i));
+}
+
+TEST(RankBitArray, Lengths) {
+  // Lengths around the words of the BitArray and the lines copied at once.
+  size_t lengths[] = {1, 31, 32, 33, 64, 447, 448, 449, 895, 896, 897};
+  for (size_t N : lengths) {
+    BitArray<uint> bits = RandomBits(N, 50);
+    RankBitArray rank(bits);
+    size_t ones = 0;
+    for (size_t i = 0; i < N; ++i) {
+      ones += bits.GetBit(i);
+      ASSERT_EQ(bits.GetBit(i), rank.Access(i));
+      ASSERT_EQ(ones, rank.Rank1(i));
+    }
+  }
+}
+
+TEST(RankBitArray, Save) {
+  size_t N = (size_t) rand()%100000 + 1;
+  BitArray<uint> bits = RandomBits(N, 30);
+  RankBitArray rank(bits);
+
+  std::ofstream out;
+  out.open("rank_bitarray_test", std::ofstream::out);
+  rank.Save(&out);
+  out.close();
+
+  std::ifstream in;
+  in.open("rank_bitarray_test", std::ifstream::in);
+  RankBitArray rank2(&in);
+  in.close();
+  remove("rank_bitarray_test");
+
+  ASSERT_EQ(rank.GetLength(), rank2.GetLength());
+  for (size_t i = 0; i < N; ++i) {
+    ASSERT_EQ(rank.Access(i), rank2.Access(i));
+    ASSERT_EQ(rank.Rank1(i), rank2.Rank1(i));
+  }
+}
+
+TEST(RankBitArray, Writer) {
+  size_t lengths[] = {0, 1, 63, 64, 65, 447, 448, 449, 896, 100000};
+  for (size_t N : lengths) {
+    BitArray<uint> bits = RandomBits(N, 30);
+    std::ofstream out("rank_bitarray_test", std::ofstream::binary);
+    RankBitArray::Writer writer(&out, N);
+    for (size_t pos = 0; pos < N;) {
+      uint len = (uint) std::min<size_t>((size_t) rand()%64 + 1, N - pos);
+      writer.Append(bits.GetBits(pos, len), len);
+      pos += len;
+    }
+    writer.Finish();
+    out.close();
+
+    std::ifstream in("rank_bitarray_test", std::ifstream::binary);
+    RankBitArray rank(&in);
+    in.close();
+    remove("rank_bitarray_test");
+
+    ASSERT_EQ(N, rank.GetLength());
+    size_t ones = 0;
+    for (size_t i = 0; i < N; ++i) {
+      ones += bits.GetBit(i);
+      ASSERT_EQ(bits.GetBit(i), rank.Access(i));
+      ASSERT_EQ(ones, rank.Rank1(i));
+    }
+  }
+}
@@ -0,0 +1,50 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#include <utils/thread_pool.h>
+#include <gtest/gtest.h>
+#include <atomic>
+#include <vector>
+
+using ::libk2tree::utils::ThreadPool;
+
+TEST(ThreadPool, ParallelFor) {
+  ThreadPool pool(4);
+  ASSERT_EQ(4u, pool.threads());
+
+  std::vector<int> calls(1000, 0);
+  pool.ParallelFor(calls.size(), [&] (size_t i) {
+    ++calls[i];
+  });
+  for (int c : calls)
+    ASSERT_EQ(1, c);
+
+  pool.ParallelFor(0, [] (size_t) {});
+}
+
+TEST(ThreadPool, Nested) {
+  ThreadPool pool(2);
+  std::atomic<size_t> sum(0);
+  pool.ParallelFor(8, [&] (size_t i) {
+    pool.ParallelFor(8, [&] (size_t j) {
+      sum += i*8 + j;
+    });
+  });
+  ASSERT_EQ(63u*64/2, sum);
+}
+
+TEST(ThreadPool, Submit) {
+  std::atomic<size_t> cnt(0);
+  {
+    ThreadPool pool(3);
+    for (uint i = 0; i < 100; ++i)
+      pool.Submit([&] () { ++cnt; });
+  }
+  ASSERT_EQ(100u, cnt);
+}
@@ -8,6 +8,9 @@
  */
 
 #include <utils/utils.h>
+#include <utils/bits.h>
+#include <utils/crc32c.h>
+#include <cstring>
 #include <gtest/gtest.h>
 
 
@@ -66,3 +69,58 @@ TEST(Pow, 6) {
   ASSERT_EQ(17179869184, Pow<size_t>(4, 17));
 }
 
+
+TEST(ExtractBits, Random) {
+  srand((uint) time(NULL));
+  for (uint i = 0; i < 10000; ++i) {
+    uint64_t word = ((uint64_t) rand() << 33) ^ ((uint64_t) rand() << 11) ^
+                    (uint64_t) rand();
+    uint64_t mask = ((uint64_t) rand() << 33) ^ ((uint64_t) rand() << 11) ^
+                    (uint64_t) rand();
+    uint64_t expected = 0;
+    uint j = 0;
+    for (uint b = 0; b < 64; ++b) {
+      if ((mask >> b) & 1)
+        expected |= ((word >> b) & 1) << j++;
+    }
+    ASSERT_EQ(expected, ::libk2tree::utils::ExtractBits(word, mask));
+  }
+}
+
+TEST(ExtractColumn, AllArities) {
+  srand((uint) time(NULL));
+  for (uint kL = 1; kL <= ::libk2tree::utils::kMaxWordArity; ++kL) {
+    for (uint i = 0; i < 1000; ++i) {
+      uint64_t word = ((uint64_t) rand() << 33) ^ ((uint64_t) rand() << 11) ^
+                      (uint64_t) rand();
+      if (kL < 8)
+        word &= (1ULL << (kL*kL)) - 1;
+      for (uint col = 0; col < kL; ++col) {
+        uint64_t expected = 0;
+        for (uint row = 0; row < kL; ++row)
+          expected |= ((word >> (row*kL + col)) & 1) << row;
+        ASSERT_EQ(expected, ::libk2tree::utils::ExtractColumn(word, col, kL));
+      }
+    }
+  }
+}
+
+TEST(Crc32c, KnownValues) {
+  using ::libk2tree::utils::Crc32c;
+  ASSERT_EQ(0u, Crc32c("", 0));
+  ASSERT_EQ(0xE3069283u, Crc32c("123456789", 9));
+
+  char zeros[32] = {0};
+  ASSERT_EQ(0x8A9136AAu, Crc32c(zeros, sizeof(zeros)));
+}
+
+TEST(Crc32c, Chaining) {
+  using ::libk2tree::utils::Crc32c;
+  char data[1000];
+  for (uint i = 0; i < sizeof(data); ++i)
+    data[i] = (char) rand();
+  uint32_t crc = Crc32c(data, sizeof(data));
+  for (uint split = 0; split <= sizeof(data); split += 37)
+    ASSERT_EQ(crc, Crc32c(data + split, sizeof(data) - split,
+                          Crc32c(data, split)));
+}
@@ -0,0 +1,131 @@
+/*
+ * ----------------------------------------------------------------------------
+ * "THE BEER-WARE LICENSE" (Revision 42):
+ * <nlehmann@dcc.uchile.cl> wrote this file. As long as you retain this notice you
+ * can do whatever you want with this stuff. If we meet some day, and you think
+ * this stuff is worth it, you can buy me a beer in return Nicolás Lehmann
+ * ----------------------------------------------------------------------------
+ */
+
+#include <gtest/gtest.h>
+#include <compression/hash.h>
+#include <compression/vocabulary.h>
+#include <set>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using ::libk2tree::compression::HashTable;
+using ::libk2tree::compression::Vocabulary;
+using ::libk2tree::compression::SortByWord;
+
+void TestSort(size_t cnt, uint size, uint values) {
+  Vocabulary voc(cnt, size);
+  std::vector<std::string> expected;
+  std::vector<uchar> word(size);
+  for (size_t i = 0; i < cnt; ++i) {
+    // Few different bytes, so there are repeated words.
+    for (uint b = 0; b < size; ++b)
+      word[b] = (uchar) ((uint) rand()%values*(256/values));
+    voc.assign(i, word.data());
+    expected.emplace_back(word.begin(), word.end());
+  }
+  std::sort(expected.begin(), expected.end());
+  size_t unique = (size_t) (std::unique(expected.begin(), expected.end()) -
+                            expected.begin());
+  std::vector<std::string> sorted;
+  for (size_t i = 0; i < cnt; ++i)
+    sorted.emplace_back(voc[i], voc[i] + size);
+  std::sort(sorted.begin(), sorted.end());
+
+  ASSERT_EQ(unique, voc.sort());
+  for (size_t i = 0; i < cnt; ++i)
+    ASSERT_EQ(sorted[i], std::string(voc[i], voc[i] + size));
+}
+
+TEST(Vocabulary, Sort) {
+  uint sizes[] = {1, 2, 3, 7, 8, 9, 16, 17};
+  for (uint size : sizes) {
+    TestSort((size_t) rand()%10000 + 1, size, 2);
+    TestSort((size_t) rand()%10000 + 1, size, 256);
+  }
+}
+
+TEST(Vocabulary, SortEqual) {
+  // All words equal, every pass is skipped.
+  uchar word[9] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+  for (uint size = 1; size <= 9; ++size) {
+    Vocabulary voc(1000, size);
+    for (size_t i = 0; i < 1000; ++i)
+      voc.assign(i, word);
+    ASSERT_EQ(1u, voc.sort());
+    for (size_t i = 0; i < 1000; ++i)
+      ASSERT_TRUE(std::equal(word, word + size, voc[i]));
+  }
+  Vocabulary empty(0, 8);
+  ASSERT_EQ(0u, empty.sort());
+}
+
+TEST(Vocabulary, SortByWord) {
+  uint sizes[] = {1, 8, 9, 16};
+  for (uint size : sizes) {
+    size_t cnt = (size_t) rand()%10000 + 1;
+    Vocabulary voc(cnt, size);
+    std::vector<uchar> word(size);
+    for (size_t i = 0; i < cnt; ++i) {
+      for (uint b = 0; b < size; ++b)
+        word[b] = (uchar) ((uint) rand()%2);
+      voc.assign(i, word.data());
+    }
+    std::vector<size_t> positions(cnt);
+    for (size_t i = 0; i < cnt; ++i)
+      positions[i] = i;
+    SortByWord(voc, positions.data(), positions.data() + cnt);
+
+    // Equal words keep the order of their positions.
+    for (size_t i = 1; i < cnt; ++i) {
+      int cmp = memcmp(voc[positions[i - 1]], voc[positions[i]], size);
+      ASSERT_TRUE(cmp < 0 || (cmp == 0 && positions[i - 1] < positions[i]));
+    }
+  }
+}
+
+TEST(HashTable, Search) {
+  // Sizes stored as integers, with one or two keys, and as bytes.
+  uint sizes[] = {1, 4, 8, 9, 16, 17};
+  for (uint size : sizes) {
+    for (uint word_size : {0u, size}) {
+      size_t cnt = (size_t) rand()%2000 + 1;
+      std::set<std::string> distinct;
+      while (distinct.size() < cnt) {
+        std::string word(size, 0);
+        for (uint b = 0; b < size; ++b)
+          word[b] = (char) (rand()%(size == 1 ? 256 : 16));
+        distinct.insert(word);
+        if (size == 1 && distinct.size() == 256)
+          break;
+      }
+      std::vector<std::string> words(distinct.begin(), distinct.end());
+      std::random_shuffle(words.begin(), words.end());
+      size_t half = words.size()/2;
+
+      HashTable table(half, 1.5, word_size);
+      for (size_t i = 0; i < half; ++i) {
+        const uchar *w = reinterpret_cast<const uchar *>(words[i].data());
+        size_t addr;
+        ASSERT_FALSE(table.search(w, size, &addr));
+        table.add(w, size, addr);
+        table[addr].codeword = (uint) i;
+      }
+      for (size_t i = 0; i < words.size(); ++i) {
+        const uchar *w = reinterpret_cast<const uchar *>(words[i].data());
+        size_t addr;
+        ASSERT_EQ(i < half, table.search(w, size, &addr));
+        if (i < half) {
+          ASSERT_EQ(i, table[addr].codeword);
+        }
+      }
+    }
+  }
+}